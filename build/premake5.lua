@@ -6,7 +6,7 @@ workspace "Solution"
     justmycode "Off"
     pchheader "pch.h"
     pchsource "source/pch.cpp"
-    platforms { "Win64" }
+    platforms { "Win64", "Linux64" }
     targetdir "bin/%{cfg.buildcfg}"
     objdir "bin/obj/%{cfg.buildcfg}"
     files { "source/**.h", "source/Stl/**", "source/pch.cpp" }
@@ -19,6 +19,11 @@ workspace "Solution"
         defines { "PLATFORM_WIN64", "VK_USE_PLATFORM_WIN32_KHR" }
         links { "Kernel32", "Shell32", "User32", "Gdi32", "vulkan-1.lib" }
 
+    filter "platforms:Linux64"
+        system "linux"
+        architecture "x86_64"
+        links { "pthread", "dl" }
+
     filter "configurations:Development"
         defines { "_DEVEL", "_DEBUG" }
         symbols "On"
@@ -37,6 +42,7 @@ project "Engine"
     kind "StaticLib"
 
 project "Editor"
+    removeplatforms { "Linux64" }
     dependson { "Engine", "RhiVulkan" }
     files { "source/Editor/Private/*.cpp" }
     pchheader "pch.h"
@@ -47,4 +53,51 @@ project "Game"
     links { "Engine" }
     files { "source/Game/Private/*.cpp" }
     pchheader "pch.h"
-    kind "ConsoleApp"
\ No newline at end of file
+    kind "ConsoleApp"
+
+project "PackTool"
+    dependson { "Engine" }
+    links { "Engine" }
+    files { "source/Tools/*.cpp" }
+    pchheader "pch.h"
+    kind "ConsoleApp"
+
+-- Benchmarks and stress tests; each exits non-zero if one of its checks fails.
+project "HeapBench"
+    dependson { "Engine" }
+    links { "Engine" }
+    files { "source/Bench/HeapBench.cpp" }
+    pchheader "pch.h"
+    kind "ConsoleApp"
+
+project "StlBench"
+    dependson { "Engine" }
+    links { "Engine" }
+    files { "source/Bench/StlBench.cpp" }
+    pchheader "pch.h"
+    kind "ConsoleApp"
+
+project "JobBench"
+    dependson { "Engine" }
+    links { "Engine" }
+    files { "source/Bench/JobBench.cpp" }
+    pchheader "pch.h"
+    kind "ConsoleApp"
+
+project "ArchiveBench"
+    dependson { "Engine" }
+    links { "Engine" }
+    files { "source/Bench/ArchiveBench.cpp" }
+    pchheader "pch.h"
+    kind "ConsoleApp"
+
+-- Headless: point VK_ICD_FILENAMES at a software ICD such as lavapipe to run it without a GPU.
+project "RhiBench"
+    dependson { "Engine" }
+    links { "Engine" }
+    files { "source/Bench/RhiBench.cpp", "source/Engine/RHI/RhiVulkan.cpp", "source/Engine/RHI/RhiPipelines.cpp", "source/vendor/volk.c" }
+    pchheader "pch.h"
+    kind "ConsoleApp"
+
+    filter "files:source/vendor/volk.c"
+        flags { "NoPCH" }
@@ -0,0 +1,229 @@
+#include <pch.h>
+#include <Engine/Archive.h>
+#include <Engine/FileIO.h>
+#include <Engine/JobSystem.h>
+#include "Bench.h"
+
+#if !defined(PLATFORM_WIN64)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ArchiveBench [dir] [files]
+// Writes a synthetic asset set into 'dir' (default bench_data) as loose files and as a stored and a compressed
+// archive, then loads everything back each way and checks the bytes. Sizes are spread from 512 bytes to 256KB;
+// three quarters of the files are text-like and compress, the rest are noise.
+// Cold runs drop the files from the page cache first (posix_fadvise, Linux only), warm runs are best of three.
+
+#define ARCHIVE_BENCH_WARM_RUNS 3
+
+struct benchFile_t
+{
+	char name[32];
+	uint64_t checksum;
+	uint32_t size;
+};
+
+static TArray<benchFile_t> gFiles;
+static char gDir[256] = "bench_data";
+
+// TCHAR is wide unless MBCS; names are plain ASCII so a widening copy does.
+static void ToPath(const char *pName, TCHAR *pOut, size_t Cap)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", gDir, pName);
+	size_t i = 0;
+	for (; path[i] && i < Cap - 1; ++i)
+		pOut[i] = (TCHAR)path[i];
+	pOut[i] = 0;
+}
+
+static uint64_t Checksum(const void *pData, size_t Size)
+{
+	auto p = (const uint8 *)pData;
+	uint64_t sum = Size;
+	size_t i = 0;
+	for (; i + 8 <= Size; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		sum = (sum ^ word) * 0x100000001B3ull;
+	}
+	for (; i != Size; ++i)
+		sum = (sum ^ p[i]) * 0x100000001B3ull;
+	return sum;
+}
+
+static void FillFile(benchRng_t *pRng, uint8 *pData, uint32_t Size, bool bText)
+{
+	static const char *s_words[] = { "vertex", "shader", "texture", "material", "mesh", "bone", "anim", "light",
+		"sampler", "uniform", "buffer", "index", "normal", "tangent", "color", "layer", " ", " ", "\n", "0.5", "1.0" };
+
+	if (!bText) {
+		for (uint32_t i = 0; i != Size; ++i)
+			pData[i] = (uint8)pRng->Next();
+		return;
+	}
+
+	uint32_t i = 0;
+	while (i != Size) {
+		auto pWord = s_words[pRng->Range(0, (uint32_t)(sizeof(s_words) / sizeof(s_words[0])) - 1)];
+		for (; *pWord && i != Size; ++pWord)
+			pData[i++] = (uint8)*pWord;
+	}
+}
+
+// Clean pages only, so everything has been synced by the time this runs.
+static void DropFromCache(const char *pName)
+{
+#if !defined(PLATFORM_WIN64)
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", gDir, pName);
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)pName;
+#endif
+}
+
+static void DropAllFromCache()
+{
+	for (auto &file : gFiles)
+		DropFromCache(file.name);
+	DropFromCache("stored.pak");
+	DropFromCache("compressed.pak");
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void WriteDataSet(uint NumFiles)
+{
+	benchRng_t rng = { 0xBE5466CF34E90C6Cull };
+	TArray<uint8> data;
+	TCHAR path[512];
+
+	archiveBuilder_t stored = {};
+	archiveBuilder_t compressed = {};
+
+	double begin = BenchNowMs();
+	size_t totalBytes = 0;
+	for (uint i = 0; i != NumFiles; ++i) {
+		auto &file = gFiles.Push({});
+		snprintf(file.name, sizeof(file.name), "asset%05u.bin", i);
+
+		// Log-uniform between 512B and 256KB.
+		file.size = (uint32_t)(512.0 * (double)(1u << rng.Range(0, 8)) * (1.0 + rng.Unit()));
+		data.Resize(file.size);
+		FillFile(&rng, data.GetPtr(), file.size, (i & 3) != 3);
+		file.checksum = Checksum(data.GetPtr(), file.size);
+		totalBytes += file.size;
+
+		ToPath(file.name, path, 512);
+		BENCH_CHECK(WriteEntireFile(path, data.GetPtr(), file.size));
+		BENCH_CHECK(stored.Add(file.name, data.GetPtr(), file.size, 16, false));
+		BENCH_CHECK(compressed.Add(file.name, data.GetPtr(), file.size, 16, true));
+	}
+
+	ToPath("stored.pak", path, 512);
+	BENCH_CHECK(stored.Write(path));
+	ToPath("compressed.pak", path, 512);
+	BENCH_CHECK(compressed.Write(path));
+	stored.Release();
+	compressed.Release();
+
+#if !defined(PLATFORM_WIN64)
+	sync();
+#endif
+
+	uint64 storedSize = 0, compressedSize = 0;
+	ToPath("stored.pak", path, 512);
+	QueryFileSize(path, &storedSize);
+	ToPath("compressed.pak", path, 512);
+	QueryFileSize(path, &compressedSize);
+
+	printf("%u files, %.1f MB loose, %.1f MB stored, %.1f MB compressed (written in %.0f ms)\n", NumFiles,
+		(double)totalBytes / (1024.0 * 1024.0), (double)storedSize / (1024.0 * 1024.0), (double)compressedSize / (1024.0 * 1024.0),
+		BenchNowMs() - begin);
+}
+
+static double LoadLoose()
+{
+	TCHAR path[512];
+	double begin = BenchNowMs();
+	for (auto &file : gFiles) {
+		fileBlob_t blob;
+		ToPath(file.name, path, 512);
+		BENCH_CHECK(ReadEntireFile(path, &blob));
+		BENCH_CHECK(blob.Size == file.size && Checksum(blob.pBuffer, blob.Size) == file.checksum);
+		blob.Release();
+	}
+	return BenchNowMs() - begin;
+}
+
+static double LoadArchive(const char *pArchive)
+{
+	TCHAR path[512];
+	ToPath(pArchive, path, 512);
+
+	double begin = BenchNowMs();
+	archive_t archive = {};
+	BENCH_CHECK(archive.Open(path));
+	BENCH_CHECK(archive.GetNumEntries() == gFiles.Getcount());
+
+	for (auto &file : gFiles) {
+		auto pEntry = archive.Find(file.name);
+		BENCH_CHECK(pEntry != nullptr);
+
+		archiveData_t data;
+		BENCH_CHECK(archive.Load(pEntry, &data));
+		BENCH_CHECK(data.Size == file.size && Checksum(data.pData, data.Size) == file.checksum);
+		data.Release();
+	}
+
+	archive.Close();
+	return BenchNowMs() - begin;
+}
+
+static void Run(const char *pName, double (*pLoad)(const char *), const char *pArg)
+{
+	DropAllFromCache();
+	double cold = pLoad(pArg);
+
+	double warm = 1e30;
+	for (uint i = 0; i != ARCHIVE_BENCH_WARM_RUNS; ++i) {
+		double ms = pLoad(pArg);
+		if (ms < warm)
+			warm = ms;
+	}
+
+	printf("%-20s cold %9.2f ms   warm %9.2f ms\n", pName, cold, warm);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		snprintf(gDir, sizeof(gDir), "%s", argv[1]);
+	uint numFiles = (argc > 2) ? (uint)atoi(argv[2]) : 1000;
+	if (numFiles == 0)
+		numFiles = 1;
+
+	char command[300];
+	snprintf(command, sizeof(command), "mkdir \"%s\"", gDir);
+	system(command); // Fine if it already exists.
+
+	Jobs::Initialize();
+	WriteDataSet(numFiles);
+
+#if defined(PLATFORM_WIN64)
+	printf("(No page cache control on this platform; cold runs are warm.)\n");
+#endif
+	Run("loose files", [](const char *) { return LoadLoose(); }, nullptr);
+	Run("archive (stored)", LoadArchive, "stored.pak");
+	Run("archive (compressed)", LoadArchive, "compressed.pak");
+
+	Jobs::Release();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,37 @@
+#if !defined(_BENCH_BENCH_H_)
+#define _BENCH_BENCH_H_
+
+#include <pch.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Shared by the programs in Bench/. Each one prints a line per case and exits non-zero as soon as a check
+// fails, so they double as stress tests. Inputs come from a fixed seed so runs are comparable.
+
+inline double BenchNowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// xorshift64*; plenty for generating traces.
+struct benchRng_t
+{
+	uint64_t state;
+
+	inline uint64_t Next()
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1Dull;
+	}
+
+	inline uint32_t Range(uint32_t Lo, uint32_t Hi) { return Lo + (uint32_t)(Next() % (uint64_t)(Hi - Lo + 1)); } // Inclusive.
+	inline float Unit() { return (float)(Next() >> 40) / (float)(1 << 24); }
+};
+
+#define BENCH_CHECK(x) do { if (!(x)) { printf("FAILED: %s (%s:%d)\n", #x, __FILE__, __LINE__); exit(1); } } while (0)
+
+#endif // _BENCH_BENCH_H_
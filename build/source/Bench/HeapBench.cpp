@@ -0,0 +1,291 @@
+#include <pch.h>
+#include <Engine/Memory.h>
+#include "Bench.h"
+
+#include <thread>
+#include <vector>
+
+// HeapBench [ops] [threads]
+// Replays the same mixed alloc/realloc/free trace through dmHeap_t and malloc. Sizes are mostly small with a
+// long tail, and reallocs grow or shrink by up to 2x the way dynamic arrays do. A verification pass runs first:
+// every block is filled with a tag that has to survive reallocs and must not be overwritten by its neighbours.
+
+#define HEAP_BENCH_SLOTS 4096
+
+enum EHeapOp : uint8
+{
+	eHeapOpAlloc,
+	eHeapOpRealloc,
+	eHeapOpFree,
+};
+
+struct heapOp_t
+{
+	uint32_t slot;
+	uint32_t size;
+	EHeapOp op;
+};
+
+struct mallocBackend_t
+{
+	inline void *Alloc(size_t Size) { return malloc(Size); }
+	inline void *Realloc(void *Ptr, size_t Size) { return realloc(Ptr, Size); }
+	inline void Free(void *Ptr) { free(Ptr); }
+};
+
+struct heapBackend_t
+{
+	dmHeap_t *pHeap;
+
+	inline void *Alloc(size_t Size) { return pHeap->Alloc(Size); }
+	inline void *Realloc(void *Ptr, size_t Size) { return pHeap->Realloc(Ptr, Size); }
+	inline void Free(void *Ptr) { pHeap->Free(Ptr); }
+};
+
+static uint32_t RandomSize(benchRng_t *pRng)
+{
+	float r = pRng->Unit();
+	if (r < 0.60f)
+		return pRng->Range(8, 128);
+	if (r < 0.90f)
+		return pRng->Range(129, 2048);
+	if (r < 0.99f)
+		return pRng->Range(2049, 32 * 1024);
+	return pRng->Range(32 * 1024 + 1, 512 * 1024);
+}
+
+static void MakeTrace(uint64_t Seed, uint NumSlots, uint NumOps, std::vector<heapOp_t> *pOut)
+{
+	benchRng_t rng = { Seed };
+	std::vector<uint32_t> sizes(NumSlots, 0);
+
+	pOut->clear();
+	pOut->reserve(NumOps + NumSlots);
+	for (uint i = 0; i != NumOps; ++i) {
+		uint32_t slot = rng.Range(0, NumSlots - 1);
+		if (!sizes[slot]) {
+			sizes[slot] = RandomSize(&rng);
+			pOut->push_back({ slot, sizes[slot], eHeapOpAlloc });
+		} else if (rng.Unit() < 0.3f) {
+			uint32_t size = (uint32_t)((float)sizes[slot] * (0.5f + rng.Unit() * 1.5f));
+			sizes[slot] = (size < 8) ? 8 : size;
+			pOut->push_back({ slot, sizes[slot], eHeapOpRealloc });
+		} else {
+			sizes[slot] = 0;
+			pOut->push_back({ slot, 0, eHeapOpFree });
+		}
+	}
+
+	// Drain so every run ends with nothing live.
+	for (uint32_t slot = 0; slot != NumSlots; ++slot) {
+		if (sizes[slot])
+			pOut->push_back({ slot, 0, eHeapOpFree });
+	}
+}
+
+template <typename B>
+static double Replay(B *pBackend, const std::vector<heapOp_t> &Trace, uint NumSlots)
+{
+	std::vector<void *> ptrs(NumSlots, nullptr);
+
+	double begin = BenchNowMs();
+	for (auto &op : Trace) {
+		switch (op.op) {
+		case eHeapOpAlloc: ptrs[op.slot] = pBackend->Alloc(op.size); break;
+		case eHeapOpRealloc: ptrs[op.slot] = pBackend->Realloc(ptrs[op.slot], op.size); break;
+		case eHeapOpFree: pBackend->Free(ptrs[op.slot]); ptrs[op.slot] = nullptr; break;
+		}
+		// Touch the block like a caller would.
+		if (ptrs[op.slot])
+			*(volatile uint8 *)ptrs[op.slot] = (uint8)op.slot;
+	}
+	return BenchNowMs() - begin;
+}
+
+static bool CheckFill(const uint8 *p, size_t Size, uint8 Tag)
+{
+	for (size_t i = 0; i != Size; ++i) {
+		if (p[i] != Tag)
+			return false;
+	}
+	return true;
+}
+
+// Slow; fills and checks every byte.
+static void Verify(dmHeap_t *pHeap, const std::vector<heapOp_t> &Trace, uint NumSlots)
+{
+	std::vector<uint8 *> ptrs(NumSlots, nullptr);
+	std::vector<uint32_t> sizes(NumSlots, 0);
+	std::vector<uint8> tags(NumSlots, 0);
+
+	for (size_t i = 0; i != Trace.size(); ++i) {
+		auto &op = Trace[i];
+		uint8 *&p = ptrs[op.slot];
+
+		if (op.op == eHeapOpFree) {
+			BENCH_CHECK(CheckFill(p, sizes[op.slot], tags[op.slot]));
+			pHeap->Free(p);
+			p = nullptr;
+			sizes[op.slot] = 0;
+			continue;
+		}
+
+		if (op.op == eHeapOpAlloc) {
+			p = (uint8 *)pHeap->Alloc(op.size);
+		} else {
+			BENCH_CHECK(CheckFill(p, sizes[op.slot], tags[op.slot]));
+			p = (uint8 *)pHeap->Realloc(p, op.size);
+			BENCH_CHECK(p != nullptr);
+			BENCH_CHECK(CheckFill(p, (sizes[op.slot] < op.size) ? sizes[op.slot] : op.size, tags[op.slot]));
+		}
+
+		BENCH_CHECK(p != nullptr);
+		BENCH_CHECK(((uintptr_t)p & (DM_HEAP_ALIGN - 1)) == 0);
+		BENCH_CHECK(dmHeap_t::GetAllocSize(p) >= op.size);
+		sizes[op.slot] = op.size;
+		tags[op.slot] = (uint8)(i * 31 + 1);
+		memset(p, tags[op.slot], op.size);
+	}
+
+	dmHeapStats_t stats;
+	pHeap->GetStats(&stats);
+	BENCH_CHECK(stats.liveBytes == 0);
+	BENCH_CHECK(stats.numFreeBlocks == 1); // Everything merged back.
+	BENCH_CHECK(stats.freeBytes == stats.capacity);
+
+	// Aligned allocations.
+	for (size_t align = 16; align <= 4096; align *= 2) {
+		auto p = pHeap->AllocAligned(100, align);
+		BENCH_CHECK(p && ((uintptr_t)p & (align - 1)) == 0);
+		pHeap->Free(p);
+	}
+	pHeap->GetStats(&stats);
+	BENCH_CHECK(stats.liveBytes == 0 && stats.numFreeBlocks == 1);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void RunSingleThreaded(uint NumOps)
+{
+	std::vector<heapOp_t> trace;
+	MakeTrace(0x9E3779B97F4A7C15ull, HEAP_BENCH_SLOTS, NumOps, &trace);
+
+	dmHeap_t heap;
+	BENCH_CHECK(heap.Initialize(MEGABYTES(256ull)));
+	Verify(&heap, trace, HEAP_BENCH_SLOTS);
+	heap.Reset();
+
+	heapBackend_t heapBackend = { &heap };
+	mallocBackend_t mallocBackend;
+
+	// Warm both once so page faults don't land on whichever runs first.
+	Replay(&heapBackend, trace, HEAP_BENCH_SLOTS);
+	Replay(&mallocBackend, trace, HEAP_BENCH_SLOTS);
+
+	double heapMs = Replay(&heapBackend, trace, HEAP_BENCH_SLOTS);
+	double mallocMs = Replay(&mallocBackend, trace, HEAP_BENCH_SLOTS);
+
+	dmHeapStats_t stats;
+	heap.GetStats(&stats);
+	BENCH_CHECK(stats.liveBytes == 0);
+
+	printf("1 thread,  %zu ops:  dmHeap_t %8.2f ms (%6.1f ns/op)   malloc %8.2f ms (%6.1f ns/op)   peak %.1f MB\n",
+		trace.size(), heapMs, heapMs * 1e6 / (double)trace.size(), mallocMs, mallocMs * 1e6 / (double)trace.size(),
+		(double)stats.peakBytes / (1024.0 * 1024.0));
+
+	// Fragmentation half way through a trace, when it's at its worst.
+	std::vector<heapOp_t> half(trace.begin(), trace.begin() + (trace.size() - HEAP_BENCH_SLOTS) / 2);
+	std::vector<void *> ptrs(HEAP_BENCH_SLOTS, nullptr);
+	for (auto &op : half) {
+		switch (op.op) {
+		case eHeapOpAlloc: ptrs[op.slot] = heap.Alloc(op.size); break;
+		case eHeapOpRealloc: ptrs[op.slot] = heap.Realloc(ptrs[op.slot], op.size); break;
+		case eHeapOpFree: heap.Free(ptrs[op.slot]); ptrs[op.slot] = nullptr; break;
+		}
+	}
+	heap.GetStats(&stats);
+	printf("           mid-trace: %.1f MB live in %u allocations, %u free blocks, largest %.1f MB, fragmentation %.3f\n",
+		(double)stats.liveBytes / (1024.0 * 1024.0), stats.numAllocs, stats.numFreeBlocks,
+		(double)stats.largestFreeBlock / (1024.0 * 1024.0), stats.fragmentation);
+
+	heap.Release();
+}
+
+template <typename B>
+static double RunThreads(B *pBackend, const std::vector<std::vector<heapOp_t>> &Traces, uint NumSlots, void (*pThreadExit)(B *))
+{
+	std::vector<std::thread> threads;
+	std::vector<double> times(Traces.size());
+
+	for (size_t t = 0; t != Traces.size(); ++t) {
+		threads.emplace_back([&, t]() {
+			times[t] = Replay(pBackend, Traces[t], NumSlots);
+			if (pThreadExit)
+				pThreadExit(pBackend);
+		});
+	}
+	for (auto &thread : threads)
+		thread.join();
+
+	double slowest = 0.0;
+	for (double ms : times) {
+		if (ms > slowest)
+			slowest = ms;
+	}
+	return slowest;
+}
+
+static void RunMultiThreaded(uint NumOps, uint NumThreads)
+{
+	const uint numSlots = HEAP_BENCH_SLOTS / 2;
+
+	std::vector<std::vector<heapOp_t>> traces(NumThreads);
+	size_t totalOps = 0;
+	for (uint t = 0; t != NumThreads; ++t) {
+		MakeTrace(0xD1B54A32D192ED03ull * (t + 1), numSlots, NumOps / NumThreads, &traces[t]);
+		totalOps += traces[t].size();
+	}
+
+	for (uint flags : { (uint)DM_HEAP_THREADSAFE, (uint)DM_HEAP_THREAD_CACHE }) {
+		dmHeap_t heap;
+		BENCH_CHECK(heap.Initialize(MEGABYTES(512ull), flags));
+
+		heapBackend_t heapBackend = { &heap };
+		auto flush = [](heapBackend_t *pBackend) { pBackend->pHeap->FlushThreadCache(); };
+
+		RunThreads(&heapBackend, traces, numSlots, +flush);
+		double heapMs = RunThreads(&heapBackend, traces, numSlots, +flush);
+
+		dmHeapStats_t stats;
+		heap.GetStats(&stats);
+		BENCH_CHECK(stats.liveBytes == 0);
+		BENCH_CHECK(stats.numFreeBlocks == 1);
+
+		printf("%u threads, %zu ops:  dmHeap_t %8.2f ms (%6.1f ns/op)  %s\n", NumThreads, totalOps, heapMs,
+			heapMs * 1e6 * NumThreads / (double)totalOps, (flags & DM_HEAP_THREAD_CACHE) ? "thread cache" : "locked");
+		heap.Release();
+	}
+
+	mallocBackend_t mallocBackend;
+	RunThreads<mallocBackend_t>(&mallocBackend, traces, numSlots, nullptr);
+	double mallocMs = RunThreads<mallocBackend_t>(&mallocBackend, traces, numSlots, nullptr);
+	printf("%u threads, %zu ops:  malloc   %8.2f ms (%6.1f ns/op)\n", NumThreads, totalOps, mallocMs,
+		mallocMs * 1e6 * NumThreads / (double)totalOps);
+}
+
+int main(int argc, char **argv)
+{
+	uint numOps = (argc > 1) ? (uint)atoi(argv[1]) : 2000000;
+	uint numThreads = (argc > 2) ? (uint)atoi(argv[2]) : std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+	if (numThreads > 16)
+		numThreads = 16;
+
+	RunSingleThreaded(numOps);
+	if (numThreads > 1)
+		RunMultiThreaded(numOps, numThreads);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,243 @@
+#include <pch.h>
+#include <Engine/JobSystem.h>
+#include "Bench.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// JobBench [max threads] [repeats]
+// Runs the same workloads with 1..N workers and prints the time and speedup over one worker for each:
+// - parallel-for: a ParallelFor over a large array, i.e. one fork and one join.
+// - fork/join: batches of short independent jobs submitted from the main thread and waited on.
+// - recursive: jobs that split their range, submit both halves and wait on them from inside a job.
+// - graph: layers of tiny jobs, each layer started by RunAfter() on the previous layer's counter.
+// Every workload checks its result (each job ran exactly once, never before its dependencies), so running
+// this under -fsanitize=thread is the job system's stress test.
+
+static std::atomic<uint64_t> gSink;
+
+// A few hundred nanoseconds of work that the compiler can't drop.
+static inline uint64_t Spin(uint64_t x, uint Iterations)
+{
+	for (uint i = 0; i != Iterations; ++i)
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+	return x;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static TArray<uint64_t> gValues;
+
+static void RunParallelFor()
+{
+	std::atomic<uint64_t> sum(0);
+	Jobs::ParallelFor(gValues, 1024, [&](uint64_t &Value, uint Index) {
+		Value = Spin(Index, 64);
+	});
+	Jobs::ParallelFor(gValues.Getcount(), 4096, [](uint Begin, uint End, void *pData) {
+		uint64_t local = 0;
+		for (uint i = Begin; i != End; ++i)
+			local += gValues[i];
+		((std::atomic<uint64_t> *)pData)->fetch_add(local);
+	}, &sum);
+
+	uint64_t expected = 0;
+	for (uint i = 0; i < gValues.Getcount(); i += 997)
+		BENCH_CHECK(gValues[i] == Spin(i, 64));
+	for (uint i = 0; i != gValues.Getcount(); ++i)
+		expected += gValues[i];
+	BENCH_CHECK(sum.load() == expected);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define FORK_JOBS 1024
+#define FORK_BATCHES 64
+
+static std::atomic<uint> gForkRuns[FORK_JOBS];
+
+static void RunForkJoin()
+{
+	jobDecl_t decls[FORK_JOBS];
+	for (uint i = 0; i != FORK_JOBS; ++i) {
+		gForkRuns[i].store(0);
+		decls[i].pFunc = [](void *pData) {
+			auto pRuns = (std::atomic<uint> *)pData;
+			gSink.store(Spin((uintptr_t)pData, 256), std::memory_order_relaxed);
+			pRuns->fetch_add(1, std::memory_order_relaxed);
+		};
+		decls[i].pData = &gForkRuns[i];
+	}
+
+	for (uint batch = 0; batch != FORK_BATCHES; ++batch) {
+		jobCounter_t counter;
+		Jobs::Run(decls, FORK_JOBS, &counter);
+		Jobs::Wait(&counter);
+	}
+
+	for (uint i = 0; i != FORK_JOBS; ++i)
+		BENCH_CHECK(gForkRuns[i].load() == FORK_BATCHES);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+struct splitRange_t
+{
+	uint begin;
+	uint end;
+	uint64_t sum;
+};
+
+static void SplitJob(void *pData)
+{
+	auto pRange = (splitRange_t *)pData;
+	if ((pRange->end - pRange->begin) <= 256) {
+		uint64_t sum = 0;
+		for (uint i = pRange->begin; i != pRange->end; ++i)
+			sum += Spin(i, 16) & 0xFFFF;
+		pRange->sum = sum;
+		return;
+	}
+
+	uint mid = pRange->begin + (pRange->end - pRange->begin) / 2;
+	splitRange_t halves[2] = { { pRange->begin, mid, 0 }, { mid, pRange->end, 0 } };
+	jobDecl_t decls[2] = { { SplitJob, &halves[0] }, { SplitJob, &halves[1] } };
+
+	jobCounter_t counter;
+	Jobs::Run(decls, 2, &counter);
+	Jobs::Wait(&counter);
+	pRange->sum = halves[0].sum + halves[1].sum;
+}
+
+static void RunRecursive()
+{
+	const uint count = 1 << 20;
+	splitRange_t root = { 0, count, 0 };
+	jobCounter_t counter;
+	Jobs::Run(SplitJob, &root, &counter);
+	Jobs::Wait(&counter);
+
+	static uint64_t s_expected = 0;
+	if (!s_expected) {
+		for (uint i = 0; i != count; ++i)
+			s_expected += Spin(i, 16) & 0xFFFF;
+	}
+	BENCH_CHECK(root.sum == s_expected);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define GRAPH_LAYERS 64
+#define GRAPH_WIDTH 128
+
+struct graphNode_t
+{
+	std::atomic<uint> *pLayerDone; // Finished jobs per layer.
+	uint layer;
+	std::atomic<uint> runs;
+	bool bEarly;
+};
+
+static void GraphJob(void *pData)
+{
+	auto pNode = (graphNode_t *)pData;
+	if (pNode->layer && pNode->pLayerDone[pNode->layer - 1].load(std::memory_order_acquire) != GRAPH_WIDTH)
+		pNode->bEarly = true;
+	gSink.store(Spin(pNode->layer, 32), std::memory_order_relaxed);
+	pNode->runs.fetch_add(1, std::memory_order_relaxed);
+	pNode->pLayerDone[pNode->layer].fetch_add(1, std::memory_order_release);
+}
+
+static void RunGraph()
+{
+	static graphNode_t s_nodes[GRAPH_LAYERS][GRAPH_WIDTH];
+	static std::atomic<uint> s_layerDone[GRAPH_LAYERS];
+	static jobDecl_t s_decls[GRAPH_LAYERS][GRAPH_WIDTH];
+
+	for (uint l = 0; l != GRAPH_LAYERS; ++l) {
+		s_layerDone[l].store(0);
+		for (uint w = 0; w != GRAPH_WIDTH; ++w) {
+			auto &node = s_nodes[l][w];
+			node.pLayerDone = s_layerDone;
+			node.layer = l;
+			node.runs.store(0);
+			node.bEarly = false;
+			s_decls[l][w] = { GraphJob, &node };
+		}
+	}
+
+	// The whole graph is queued up front; only the first layer is runnable straight away.
+	jobCounter_t counters[GRAPH_LAYERS];
+	Jobs::Run(s_decls[0], GRAPH_WIDTH, &counters[0]);
+	for (uint l = 1; l != GRAPH_LAYERS; ++l)
+		Jobs::RunAfter(&counters[l - 1], s_decls[l], GRAPH_WIDTH, &counters[l]);
+	for (uint l = 0; l != GRAPH_LAYERS; ++l)
+		Jobs::Wait(&counters[l]);
+
+	for (uint l = 0; l != GRAPH_LAYERS; ++l) {
+		for (uint w = 0; w != GRAPH_WIDTH; ++w) {
+			BENCH_CHECK(s_nodes[l][w].runs.load() == 1);
+			BENCH_CHECK(!s_nodes[l][w].bEarly);
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+struct jobBenchCase_t
+{
+	const char *pName;
+	void (*pRun)();
+	double baseMs;
+};
+
+int main(int argc, char **argv)
+{
+	uint maxThreads = (argc > 1) ? (uint)atoi(argv[1]) : std::thread::hardware_concurrency();
+	uint repeats = (argc > 2) ? (uint)atoi(argv[2]) : 5;
+	if (maxThreads == 0)
+		maxThreads = 1;
+	if (repeats == 0)
+		repeats = 1;
+
+	gValues.Resize(1 << 20);
+
+	jobBenchCase_t cases[] = {
+		{ "parallel-for", RunParallelFor, 0.0 },
+		{ "fork/join", RunForkJoin, 0.0 },
+		{ "recursive", RunRecursive, 0.0 },
+		{ "graph", RunGraph, 0.0 },
+	};
+
+	printf("%-8s", "threads");
+	for (auto &c : cases)
+		printf(" %22s", c.pName);
+	printf("\n");
+
+	for (uint numThreads = 1; numThreads <= maxThreads; ++numThreads) {
+		BENCH_CHECK(Jobs::Initialize(numThreads));
+		BENCH_CHECK(Jobs::GetNumThreads() == numThreads);
+
+		printf("%-8u", numThreads);
+		for (auto &c : cases) {
+			c.pRun(); // Warm up.
+
+			// Best of 'repeats' so a preempted run doesn't skew the table.
+			double best = 1e30;
+			for (uint r = 0; r != repeats; ++r) {
+				double begin = BenchNowMs();
+				c.pRun();
+				double ms = BenchNowMs() - begin;
+				if (ms < best)
+					best = ms;
+			}
+			if (numThreads == 1)
+				c.baseMs = best;
+			printf(" %10.2f ms (%5.2fx)", best, c.baseMs / best);
+		}
+		printf("\n");
+
+		Jobs::Release();
+	}
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,289 @@
+#include <pch.h>
+#include <Engine/FileIO.h>
+#include <Engine/JobSystem.h>
+#include <Engine/RHI/RhiVulkan.h>
+#include "Bench.h"
+
+#include <algorithm>
+#include <vector>
+
+// RhiBench [frames] [cpu ms] [gpu clears]
+// Headless run of the Vulkan RHI's frame pacing, meant for CI on a software ICD (VK_ICD_FILENAMES pointing at
+// lavapipe). Renders into an offscreen target with 1..RHI_MAX_FRAMES_IN_FLIGHT frames in flight and prints
+// frame times. Each frame spins the CPU for a while and clears the target a number of times on the GPU, so
+// with more than one frame in flight the frame time should drop from cpu + gpu towards the larger of the two.
+// Checks along the way:
+// - BeginFrame() only returns once the slot's previous frame is done, and never waits on later ones.
+// - Every slot's readback holds the colour of the last frame recorded into it, i.e. frames retire in order.
+// - Frame arena pushes of the frames still in flight survive every BeginFrame().
+// - Objects handed to DeferRelease() every frame are all gone by Release() (run with validation to see leaks).
+
+#define RHI_BENCH_WIDTH 1280
+#define RHI_BENCH_HEIGHT 720
+
+struct offscreenTarget_t
+{
+	VkImage image;
+	VkDeviceMemory imageMemory;
+	VkImageView view;
+	VkFramebuffer framebuffer;
+	VkBuffer readback;
+	VkDeviceMemory readbackMemory;
+	uint8 *pReadback; // One pixel per frame slot.
+};
+
+static uint FindMemoryType(uint32_t TypeBits, VkMemoryPropertyFlags Flags)
+{
+	auto pVk = RHI::gRhi;
+	VkPhysicalDeviceMemoryProperties props;
+	vkGetPhysicalDeviceMemoryProperties(pVk->Adapter, &props);
+	for (uint i = 0; i != props.memoryTypeCount; ++i) {
+		if ((TypeBits & (1u << i)) && (props.memoryTypes[i].propertyFlags & Flags) == Flags)
+			return i;
+	}
+	return (uint)-1;
+}
+
+static VkDeviceMemory AllocateFor(VkMemoryRequirements Requirements, VkMemoryPropertyFlags Flags)
+{
+	VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocInfo.allocationSize = Requirements.size;
+	allocInfo.memoryTypeIndex = FindMemoryType(Requirements.memoryTypeBits, Flags);
+	BENCH_CHECK(allocInfo.memoryTypeIndex != (uint)-1);
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	BENCH_CHECK(vkAllocateMemory(RHI::gRhi->Device, &allocInfo, nullptr, &memory) == VK_SUCCESS);
+	return memory;
+}
+
+static void CreateTarget(offscreenTarget_t *pTarget)
+{
+	auto device = RHI::gRhi->Device;
+
+	VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = { RHI_BENCH_WIDTH, RHI_BENCH_HEIGHT, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	BENCH_CHECK(vkCreateImage(device, &imageInfo, nullptr, &pTarget->image) == VK_SUCCESS);
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, pTarget->image, &requirements);
+	pTarget->imageMemory = AllocateFor(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	vkBindImageMemory(device, pTarget->image, pTarget->imageMemory, 0);
+
+	VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+	viewInfo.image = pTarget->image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+	BENCH_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &pTarget->view) == VK_SUCCESS);
+
+	VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+	framebufferInfo.renderPass = RHI::gRhi->RenderPass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.pAttachments = &pTarget->view;
+	framebufferInfo.width = RHI_BENCH_WIDTH;
+	framebufferInfo.height = RHI_BENCH_HEIGHT;
+	framebufferInfo.layers = 1;
+	BENCH_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &pTarget->framebuffer) == VK_SUCCESS);
+
+	VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.size = RHI_MAX_FRAMES_IN_FLIGHT * 4;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	BENCH_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &pTarget->readback) == VK_SUCCESS);
+
+	vkGetBufferMemoryRequirements(device, pTarget->readback, &requirements);
+	pTarget->readbackMemory = AllocateFor(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	vkBindBufferMemory(device, pTarget->readback, pTarget->readbackMemory, 0);
+	BENCH_CHECK(vkMapMemory(device, pTarget->readbackMemory, 0, VK_WHOLE_SIZE, 0, (void **)&pTarget->pReadback) == VK_SUCCESS);
+}
+
+static void ReleaseTarget(offscreenTarget_t *pTarget)
+{
+	auto device = RHI::gRhi->Device;
+	vkUnmapMemory(device, pTarget->readbackMemory);
+	vkDestroyBuffer(device, pTarget->readback, nullptr);
+	vkFreeMemory(device, pTarget->readbackMemory, nullptr);
+	vkDestroyFramebuffer(device, pTarget->framebuffer, nullptr);
+	vkDestroyImageView(device, pTarget->view, nullptr);
+	vkDestroyImage(device, pTarget->image, nullptr);
+	vkFreeMemory(device, pTarget->imageMemory, nullptr);
+	ZeroThat(pTarget);
+}
+
+// Distinct per frame so the readback says which frame wrote it.
+static void FrameColour(uint64_t Frame, uint8 *pOut)
+{
+	pOut[0] = (uint8)(Frame * 37);
+	pOut[1] = (uint8)(Frame * 101 + 7);
+	pOut[2] = (uint8)(Frame >> 8);
+	pOut[3] = 255;
+}
+
+static void SpinFor(double Ms)
+{
+	double end = BenchNowMs() + Ms;
+	while (BenchNowMs() < end) {
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void RecordFrame(VkCommandBuffer Cmd, offscreenTarget_t *pTarget, uint64_t Frame, uint NumClears)
+{
+	auto pVk = RHI::gRhi;
+	uint8 colour[4];
+	FrameColour(Frame, colour);
+
+	VkClearValue clear = {};
+	VkRenderPassBeginInfo passInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+	passInfo.renderPass = pVk->RenderPass;
+	passInfo.framebuffer = pTarget->framebuffer;
+	passInfo.renderArea.extent = { RHI_BENCH_WIDTH, RHI_BENCH_HEIGHT };
+	passInfo.clearValueCount = 1;
+	passInfo.pClearValues = &clear;
+
+	// GPU load: the pass clears on load, so each repeat is a full-target fill. The last one is the real colour.
+	RHI_GPU_ZONE(Cmd, "Clears");
+	for (uint i = 0; i != NumClears; ++i) {
+		bool bLast = (i + 1 == NumClears);
+		for (uint c = 0; c != 4; ++c)
+			clear.color.float32[c] = bLast ? (float)colour[c] / 255.0f : (float)((i + c) & 1);
+		vkCmdBeginRenderPass(Cmd, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdEndRenderPass(Cmd);
+	}
+
+	// The pass leaves the target in TRANSFER_SRC_OPTIMAL when the RHI is headless.
+	VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	VkBufferImageCopy copy = {};
+	copy.bufferOffset = (Frame % pVk->NumFramesInFlight) * 4;
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent = { 1, 1, 1 };
+	vkCmdCopyImageToBuffer(Cmd, pTarget->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pTarget->readback, 1, &copy);
+
+	// Readable on the host once the frame retires, and the next frame's clears wait for the copy.
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+static void RunFramesInFlight(uint NumFramesInFlight, uint NumFrames, double CpuMs, uint NumClears)
+{
+	BENCH_CHECK(RHI::Initialize(false, NumFramesInFlight, true));
+	auto pVk = RHI::gRhi;
+	BENCH_CHECK(pVk->NumFramesInFlight == NumFramesInFlight);
+
+	offscreenTarget_t target = {};
+	CreateTarget(&target);
+
+	std::vector<double> frameMs;
+	frameMs.reserve(NumFrames);
+	uint64_t lastInSlot[RHI_MAX_FRAMES_IN_FLIGHT] = {};
+	uint64_t *pArenaData[RHI_MAX_FRAMES_IN_FLIGHT] = {}; // By slot, filled with its frame number.
+
+	VkBufferCreateInfo scratchInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	scratchInfo.size = 256;
+	scratchInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	// A few frames to warm up, not timed.
+	const uint numWarmup = NumFramesInFlight * 2;
+	double last = BenchNowMs();
+	for (uint i = 0; i != NumFrames + numWarmup; ++i) {
+		uint64_t frame = RHI::GetFrameNumber();
+		auto cmd = RHI::BeginFrame();
+		BENCH_CHECK(cmd != VK_NULL_HANDLE);
+
+		// The slot's last use is done; nothing says anything about the frames after it.
+		if (frame > NumFramesInFlight)
+			BENCH_CHECK(RHI::GetCompletedFrame() >= frame - NumFramesInFlight);
+		BENCH_CHECK(RHI::GetCompletedFrame() < frame);
+
+		auto pArena = RHI::GetFrameArena();
+		BENCH_CHECK(pArena->GetFrame() == frame);
+		for (uint slot = 0; slot != NumFramesInFlight; ++slot) {
+			if (slot == frame % NumFramesInFlight || !pArenaData[slot])
+				continue;
+			for (uint j = 0; j != 64; ++j)
+				BENCH_CHECK(pArenaData[slot][j] == lastInSlot[slot]);
+		}
+		auto pData = (uint64_t *)pArena->Push(64 * sizeof(uint64_t));
+		BENCH_CHECK(pData != nullptr);
+		for (uint j = 0; j != 64; ++j)
+			pData[j] = frame;
+		pArenaData[frame % NumFramesInFlight] = pData;
+
+		// Something to retire with the frame.
+		VkBuffer scratch = VK_NULL_HANDLE;
+		BENCH_CHECK(vkCreateBuffer(pVk->Device, &scratchInfo, nullptr, &scratch) == VK_SUCCESS);
+		RHI::DeferRelease(VK_OBJECT_TYPE_BUFFER, scratch);
+
+		SpinFor(CpuMs); // Game/scene work.
+		RecordFrame(cmd, &target, frame, NumClears);
+		RHI::SubmitFrame(nullptr, 0);
+		lastInSlot[frame % NumFramesInFlight] = frame;
+
+		double now = BenchNowMs();
+		if (i >= numWarmup)
+			frameMs.push_back(now - last);
+		last = now;
+	}
+
+	RHI::WaitForRendering();
+	BENCH_CHECK(RHI::GetCompletedFrame() == RHI::GetFrameNumber() - 1);
+	for (uint slot = 0; slot != NumFramesInFlight; ++slot) {
+		uint8 expected[4];
+		FrameColour(lastInSlot[slot], expected);
+		auto pPixel = target.pReadback + slot * 4;
+		// UNORM round trip; allow a step either way.
+		for (uint c = 0; c != 4; ++c)
+			BENCH_CHECK(abs((int)pPixel[c] - (int)expected[c]) <= 1);
+	}
+
+	std::vector<double> sorted = frameMs;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double ms : frameMs)
+		total += ms;
+
+	printf("%u in flight: avg %7.2f ms   p50 %7.2f ms   p99 %7.2f ms   max %7.2f ms\n", NumFramesInFlight,
+		total / (double)frameMs.size(), sorted[sorted.size() / 2], sorted[(sorted.size() * 99) / 100], sorted.back());
+
+	ReleaseTarget(&target);
+	RHI::Release();
+}
+
+int main(int argc, char **argv)
+{
+	uint numFrames = (argc > 1) ? (uint)atoi(argv[1]) : 200;
+	double cpuMs = (argc > 2) ? atof(argv[2]) : 4.0;
+	uint numClears = (argc > 3) ? (uint)atoi(argv[3]) : 8;
+	if (numFrames < 2)
+		numFrames = 2;
+	if (numClears == 0)
+		numClears = 1;
+
+	BENCH_CHECK(Jobs::Initialize()); // Pipeline compiles run on jobs.
+	BENCH_CHECK(IO::Initialize());   // Loose shaders are read through it.
+
+	printf("%u frames, %.1f ms CPU and %u clears of %ux%u per frame\n", numFrames, cpuMs, numClears, RHI_BENCH_WIDTH, RHI_BENCH_HEIGHT);
+	for (uint numInFlight = 1; numInFlight <= RHI_MAX_FRAMES_IN_FLIGHT; ++numInFlight)
+		RunFramesInFlight(numInFlight, numFrames, cpuMs, numClears);
+
+	IO::Release();
+	Jobs::Release();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,381 @@
+#include <pch.h>
+#include <Engine/Memory.h>
+#include <Stl/Container.h>
+#include <Stl/Map.h>
+#include "Bench.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// StlBench [scale]
+// Randomized checks of TArray/TMap/TSet against std::vector/std::unordered_map/std::unordered_set first, then
+// timings of the common operations side by side. 'scale' multiplies the element counts (default 1).
+
+// Counts live instances so the checks can catch a missing or doubled destructor.
+struct tracked_t
+{
+	static int s_live;
+
+	tracked_t() : value(0) { ++s_live; }
+	tracked_t(uint32_t v) : value(v) { ++s_live; }
+	tracked_t(const tracked_t &Other) : value(Other.value) { ++s_live; }
+	tracked_t(tracked_t &&Other) : value(Other.value) { Other.value = 0xDEADu; ++s_live; }
+	~tracked_t() { --s_live; }
+	tracked_t &operator =(const tracked_t &Other) { value = Other.value; return *this; }
+	tracked_t &operator =(tracked_t &&Other) { value = Other.value; Other.value = 0xDEADu; return *this; }
+
+	uint32_t value;
+};
+int tracked_t::s_live = 0;
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+template <typename A>
+static void CheckArray(TArray<tracked_t, A> &Array, std::vector<uint32_t> &Model)
+{
+	BENCH_CHECK(Array.Getcount() == Model.size());
+	BENCH_CHECK(Array.GetCapacity() >= Array.Getcount());
+	for (uint i = 0; i != Array.Getcount(); ++i)
+		BENCH_CHECK(Array[i].value == Model[i]);
+}
+
+template <typename A>
+static void CheckArrayOps(const A &Allocator, uint NumOps)
+{
+	benchRng_t rng = { 0x243F6A8885A308D3ull };
+	{
+		TArray<tracked_t, A> array(Allocator);
+		std::vector<uint32_t> model;
+
+		for (uint i = 0; i != NumOps; ++i) {
+			uint32_t value = (uint32_t)rng.Next();
+			switch (rng.Range(0, 9)) {
+			case 0: case 1: case 2:
+				array.Push(tracked_t(value));
+				model.push_back(value);
+				break;
+			case 3:
+				if (model.size()) {
+					uint index = rng.Range(0, (uint32_t)model.size() - 1);
+					array.Push(array[index]); // Aliases the array; must survive a grow.
+					model.push_back(model[index]);
+				}
+				break;
+			case 4:
+				if (model.size()) {
+					array.Pop();
+					model.pop_back();
+				}
+				break;
+			case 5:
+				if (model.size()) {
+					uint index = rng.Range(0, (uint32_t)model.size() - 1);
+					array.RemoveSwap(index);
+					model[index] = model.back();
+					model.pop_back();
+				}
+				break;
+			case 6: {
+				uint count = rng.Range(0, (uint32_t)model.size() + 16);
+				array.Resize(count);
+				model.resize(count, 0);
+			} break;
+			case 7:
+				if (model.size() && model.size() < 4096) {
+					uint first = rng.Range(0, (uint32_t)model.size() - 1);
+					uint count = rng.Range(1, (uint32_t)model.size() - first);
+					array.Append(count, &array[first]); // Aliases as well.
+					std::vector<uint32_t> copy(model.begin() + first, model.begin() + first + count);
+					model.insert(model.end(), copy.begin(), copy.end());
+				}
+				break;
+			case 8: {
+				TArray<tracked_t, A> copy(array);
+				TArray<tracked_t, A> moved(std::move(copy));
+				BENCH_CHECK(copy.Getcount() == 0);
+				array = std::move(moved);
+			} break;
+			case 9:
+				if (rng.Range(0, 63) == 0) {
+					array.Clear();
+					model.clear();
+				}
+				break;
+			}
+
+			if ((i & 255) == 0)
+				CheckArray(array, model);
+		}
+		CheckArray(array, model);
+		BENCH_CHECK(tracked_t::s_live == (int)model.size());
+	}
+	BENCH_CHECK(tracked_t::s_live == 0);
+}
+
+template <typename K>
+static void CheckMapOps(uint NumOps, uint32_t KeyRange)
+{
+	benchRng_t rng = { 0x13198A2E03707344ull };
+	{
+		TMap<K, tracked_t> map;
+		std::unordered_map<K, uint32_t> model;
+
+		for (uint i = 0; i != NumOps; ++i) {
+			K key = (K)rng.Range(0, KeyRange);
+			uint32_t value = (uint32_t)rng.Next();
+			switch (rng.Range(0, 4)) {
+			case 0: case 1:
+				map.Insert(key, tracked_t(value));
+				model[key] = value;
+				break;
+			case 2:
+				map[key].value = value;
+				model[key] = value;
+				break;
+			case 3:
+				BENCH_CHECK(map.Remove(key) == (model.erase(key) != 0));
+				break;
+			case 4: {
+				auto pValue = map.Find(key);
+				auto it = model.find(key);
+				BENCH_CHECK((pValue != nullptr) == (it != model.end()));
+				if (pValue)
+					BENCH_CHECK(pValue->value == it->second);
+			} break;
+			}
+
+			if ((i & 1023) == 0 || i == NumOps - 1) {
+				BENCH_CHECK(map.Getcount() == model.size());
+				uint visited = 0;
+				for (auto &entry : map) {
+					auto it = model.find(entry.Key);
+					BENCH_CHECK(it != model.end() && it->second == entry.Value.value);
+					++visited;
+				}
+				BENCH_CHECK(visited == model.size());
+			}
+		}
+		BENCH_CHECK(tracked_t::s_live == (int)model.size());
+
+		map.Clear();
+		BENCH_CHECK(map.Getcount() == 0 && map.Find((K)1) == nullptr);
+	}
+	BENCH_CHECK(tracked_t::s_live == 0);
+}
+
+static void CheckSetOps(uint NumOps)
+{
+	benchRng_t rng = { 0xA4093822299F31D0ull };
+	TSet<uint32_t> set;
+	std::unordered_set<uint32_t> model;
+
+	for (uint i = 0; i != NumOps; ++i) {
+		uint32_t key = rng.Range(0, 4096);
+		if (rng.Range(0, 2)) {
+			BENCH_CHECK(set.Insert(key) == model.insert(key).second);
+		} else {
+			BENCH_CHECK(set.Remove(key) == (model.erase(key) != 0));
+		}
+		BENCH_CHECK(set.Contains(key) == (model.count(key) != 0));
+	}
+	BENCH_CHECK(set.Getcount() == model.size());
+	for (auto key : model)
+		BENCH_CHECK(set.Contains(key));
+}
+
+static void RunChecks(uint Scale)
+{
+	dmRingArena_t arena;
+	BENCH_CHECK(arena.Initialize(MEGABYTES(64)));
+
+	CheckArrayOps(TMallocAllocator(), 100000 * Scale);
+	CheckArrayOps(dmArenaAllocator_t{ &arena }, 20000 * Scale);
+	CheckMapOps<uint32_t>(200000 * Scale, 2048);  // Dense: long clusters, lots of backward shifts.
+	CheckMapOps<uint64_t>(200000 * Scale, 1u << 30); // Sparse.
+	CheckSetOps(200000 * Scale);
+
+	arena.Release();
+	printf("Randomized checks passed.\n");
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static volatile uint64_t gSink;
+
+static void Report(const char *pCase, double OursMs, double StdMs)
+{
+	printf("%-34s %9.2f ms %9.2f ms   %5.2fx\n", pCase, OursMs, StdMs, StdMs / OursMs);
+}
+
+static void BenchArrays(uint Scale)
+{
+	const uint count = 4000000 * Scale;
+	double begin;
+
+	// -- Push ints, no reserve.
+	begin = BenchNowMs();
+	{
+		TArray<uint32_t> array;
+		for (uint i = 0; i != count; ++i)
+			array.Push(i);
+		gSink = array[count / 2];
+	}
+	double ours = BenchNowMs() - begin;
+
+	begin = BenchNowMs();
+	{
+		std::vector<uint32_t> vector;
+		for (uint i = 0; i != count; ++i)
+			vector.push_back(i);
+		gSink = vector[count / 2];
+	}
+	Report("Push uint32 x4M", ours, BenchNowMs() - begin);
+
+	// -- Push into a frame arena; growth extends the last push in place.
+	dmRingArena_t arena;
+	BENCH_CHECK(arena.Initialize(MEGABYTES(64)));
+	begin = BenchNowMs();
+	{
+		TArray<uint32_t, dmArenaAllocator_t> array(dmArenaAllocator_t{ &arena });
+		for (uint i = 0; i != count; ++i)
+			array.Push(i);
+		gSink = array[count / 2];
+	}
+	ours = BenchNowMs() - begin;
+	arena.Release();
+
+	begin = BenchNowMs();
+	{
+		std::vector<uint32_t> vector;
+		vector.reserve(count);
+		for (uint i = 0; i != count; ++i)
+			vector.push_back(i);
+		gSink = vector[count / 2];
+	}
+	Report("Push uint32 x4M (arena/reserved)", ours, BenchNowMs() - begin);
+
+	// -- Non-trivial elements: growth has to move them.
+	const uint numStrings = count / 8;
+	begin = BenchNowMs();
+	{
+		TArray<std::string> array;
+		for (uint i = 0; i != numStrings; ++i)
+			array.Push(std::string(32, (char)('a' + (i & 15))));
+		gSink = array[numStrings / 2].size();
+	}
+	ours = BenchNowMs() - begin;
+
+	begin = BenchNowMs();
+	{
+		std::vector<std::string> vector;
+		for (uint i = 0; i != numStrings; ++i)
+			vector.push_back(std::string(32, (char)('a' + (i & 15))));
+		gSink = vector[numStrings / 2].size();
+	}
+	Report("Push std::string x500K", ours, BenchNowMs() - begin);
+
+	// -- Iterate.
+	TArray<uint32_t> array;
+	std::vector<uint32_t> vector;
+	array.Resize(count);
+	vector.resize(count);
+	uint64_t sum = 0;
+
+	begin = BenchNowMs();
+	for (uint pass = 0; pass != 8; ++pass) {
+		for (auto &value : array)
+			sum += value + pass;
+	}
+	ours = BenchNowMs() - begin;
+
+	begin = BenchNowMs();
+	for (uint pass = 0; pass != 8; ++pass) {
+		for (auto &value : vector)
+			sum += value + pass;
+	}
+	Report("Iterate uint32 x4M x8", ours, BenchNowMs() - begin);
+	gSink = sum;
+}
+
+template <typename M>
+static double TimeMapInsert(M *pMap, const std::vector<uint64_t> &Keys)
+{
+	double begin = BenchNowMs();
+	for (size_t i = 0; i != Keys.size(); ++i)
+		(*pMap)[Keys[i]] = (uint32_t)i;
+	return BenchNowMs() - begin;
+}
+
+static void BenchMaps(uint Scale)
+{
+	const uint count = 1000000 * Scale;
+	benchRng_t rng = { 0x082EFA98EC4E6C89ull };
+
+	std::vector<uint64_t> keys(count), misses(count);
+	for (uint i = 0; i != count; ++i) {
+		keys[i] = rng.Next() | 1;  // Odd keys are present,
+		misses[i] = rng.Next() & ~1ull; // even ones never are.
+	}
+
+	TMap<uint64_t, uint32_t> map;
+	std::unordered_map<uint64_t, uint32_t> stdMap;
+	Report("Insert uint64 x1M", TimeMapInsert(&map, keys), TimeMapInsert(&stdMap, keys));
+
+	uint64_t sum = 0;
+	double begin = BenchNowMs();
+	for (auto key : keys)
+		sum += *map.Find(key);
+	double ours = BenchNowMs() - begin;
+	begin = BenchNowMs();
+	for (auto key : keys)
+		sum += stdMap.find(key)->second;
+	Report("Find (hit) x1M", ours, BenchNowMs() - begin);
+
+	begin = BenchNowMs();
+	for (auto key : misses)
+		sum += map.Find(key) != nullptr;
+	ours = BenchNowMs() - begin;
+	begin = BenchNowMs();
+	for (auto key : misses)
+		sum += stdMap.find(key) != stdMap.end();
+	Report("Find (miss) x1M", ours, BenchNowMs() - begin);
+
+	begin = BenchNowMs();
+	for (uint i = 0; i < count; i += 2)
+		map.Remove(keys[i]);
+	ours = BenchNowMs() - begin;
+	begin = BenchNowMs();
+	for (uint i = 0; i < count; i += 2)
+		stdMap.erase(keys[i]);
+	Report("Remove x500K", ours, BenchNowMs() - begin);
+
+	begin = BenchNowMs();
+	for (auto &entry : map)
+		sum += entry.Value;
+	ours = BenchNowMs() - begin;
+	begin = BenchNowMs();
+	for (auto &entry : stdMap)
+		sum += entry.second;
+	Report("Iterate x500K", ours, BenchNowMs() - begin);
+
+	BENCH_CHECK(map.Getcount() == stdMap.size());
+	gSink = sum;
+}
+
+int main(int argc, char **argv)
+{
+	uint scale = (argc > 1) ? (uint)atoi(argv[1]) : 1;
+	if (scale == 0)
+		scale = 1;
+
+	RunChecks(scale);
+
+	printf("%-34s %12s %12s %8s\n", "", "Stl", "std", "speedup");
+	BenchArrays(scale);
+	BenchMaps(scale);
+
+	printf("OK\n");
+	return 0;
+}
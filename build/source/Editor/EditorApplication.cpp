@@ -2,12 +2,75 @@
 #include "Engine/DebugLog.h"
 #include "EditorApplication.h"
 #include "Engine/InputKey.inl"
-#include "Engine/Rhi/RhiVulkan.h"
+#include "Engine/FileIO.h"
+#include "Engine/JobSystem.h"
+#include "Engine/Profiler.h"
+#include "Engine/RHI/RhiVulkan.h"
+
+#include <imgui/imgui.h>
+#include <imgui/imgui_impl_win32.h>
+
+#include <chrono>
+#include <stdio.h>
+
+// imgui_impl_win32.h keeps this behind '#if 0' so it needn't include <Windows.h>.
+extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 CEditorApplication *gEditor = nullptr;
 
+struct SPassRecording
+{
+	VkFramebuffer Framebuffer;
+	VkExtent2D Extent;
+	VkPipeline Pipeline;
+	ImDrawData *pDrawData;
+	VkCommandBuffer Cmd; // Out.
+};
+
+static void RecordScenePass(void *pData)
+{
+	PROFILE_ZONE("RecordScenePass");
+	auto pPass = (SPassRecording *)pData;
+	auto cmd = RHI::BeginSecondary(RHI::gRhi->RenderPass, pPass->Framebuffer);
+	if (!cmd)
+		return;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pPass->Pipeline);
+
+	VkViewport viewport = {};
+	viewport.width = (float)pPass->Extent.width;
+	viewport.height = (float)pPass->Extent.height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.extent = pPass->Extent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	vkCmdDraw(cmd, 3, 1, 0, 0);
+	PROFILE_COUNTER_ADD("Draws", 1);
+
+	vkEndCommandBuffer(cmd);
+	pPass->Cmd = cmd;
+}
+
+static void RecordUiPass(void *pData)
+{
+	PROFILE_ZONE("RecordUiPass");
+	auto pPass = (SPassRecording *)pData;
+	auto cmd = RHI::BeginSecondary(RHI::gRhi->RenderPass, pPass->Framebuffer);
+	if (!cmd)
+		return;
+
+	RHI::RenderImGui(cmd, pPass->pDrawData);
+
+	vkEndCommandBuffer(cmd);
+	pPass->Cmd = cmd;
+}
+
 void CEditorApplication::Tick()
 {
+	PROFILE_ZONE("Tick");
 	m_iHwndState &= ~EDITOR_WND_RESIZED; // Clear the resized flag.
 
 	MSG msg;
@@ -19,19 +82,28 @@ void CEditorApplication::Tick()
 	if (m_Input.Kbd[eKey_Escape])
 		m_iHwndState |= EDITOR_WND_QUIT;
 
+	if (m_Input.Kbd[eKey_F1] && !m_bProfilerKeyHeld)
+		m_bShowProfiler = !m_bShowProfiler;
+	m_bProfilerKeyHeld = m_Input.Kbd[eKey_F1];
+
 	if (m_iHwndState & EDITOR_WND_RESIZED) {
-		RHI::ResizeWindowContext(&m_MainWndContext, 0, 0);
+		m_MainWndContext.bOutOfDate = true; // Rebuilt by the next acquire, without stalling on the GPU.
 	}
 
-	// -- Rendering
-	RHI::WaitForRendering();
+	// -- UI
+	ImGui_ImplWin32_NewFrame();
+	ImGui::NewFrame();
+	if (m_bShowProfiler)
+		DrawProfilerOverlay(&m_bShowProfiler);
+	ImGui::Render();
 
-	uint32_t imageIndex;
-	vkAcquireNextImageKHR(RHI::gRhi->Device, m_MainWndContext.Swapchain, 0, m_MainWndContext.ImageSemaphore, VK_NULL_HANDLE, &imageIndex);
+	// -- Rendering
+	RHI::UpdatePipelines();
+	auto cmd = RHI::BeginFrame();
 
-	VkCommandBufferBeginInfo cmdBegin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-	vkResetCommandBuffer(RHI::gRhi->Cmd, 0);
-	vkBeginCommandBuffer(RHI::gRhi->Cmd, &cmdBegin);
+	uint imageIndex;
+	if (!RHI::AcquireImage(&m_MainWndContext, &imageIndex))
+		return;
 
 	// RenderPass
 	VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
@@ -43,50 +115,40 @@ void CEditorApplication::Tick()
 	renderPass.pClearValues = &clearColor;
 	renderPass.clearValueCount = 1;
 	
-	vkCmdBeginRenderPass(RHI::gRhi->Cmd, &renderPass, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(RHI::gRhi->Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, RHI::gRhi->Pipeline);
-
-	VkViewport viewport = {};
-	viewport.width = (float)m_uHwndSize[0];
-	viewport.height = (float)m_uHwndSize[1];
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(RHI::gRhi->Cmd, 0, 1, &viewport);
+	// The scene and the UI are recorded on job threads into secondary command buffers, then run in order.
+	SPassRecording passes[2];
+	for (auto &pass : passes) {
+		pass.Framebuffer = renderPass.framebuffer;
+		pass.Extent = renderPass.renderArea.extent;
+		pass.Cmd = VK_NULL_HANDLE;
+	}
+	passes[0].Pipeline = RHI::GetPipeline(RHI::gRhi->DefaultPipeline); // Resolved here; the UI job resolves its own.
+	passes[1].pDrawData = ImGui::GetDrawData();
+
+	jobDecl_t recordJobs[2] = { { RecordScenePass, &passes[0] }, { RecordUiPass, &passes[1] } };
+	jobCounter_t recorded;
+	Jobs::Run(recordJobs, 2, &recorded);
+	Jobs::Wait(&recorded);
+
+	{
+		RHI_GPU_ZONE(cmd, "Main pass");
+		vkCmdBeginRenderPass(cmd, &renderPass, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		for (auto &pass : passes) {
+			if (pass.Cmd)
+				vkCmdExecuteCommands(cmd, 1, &pass.Cmd);
+		}
+		vkCmdEndRenderPass(cmd);
+	}
 
-	VkRect2D scissor = {};
-	scissor.extent = m_MainWndContext.SwapchainInfo.imageExtent;
-	vkCmdSetScissor(RHI::gRhi->Cmd, 0, 1, &scissor);
-
-	vkCmdDraw(RHI::gRhi->Cmd, 3, 1, 0, 0);
-
-	vkCmdEndRenderPass(RHI::gRhi->Cmd);
-	vkEndCommandBuffer(RHI::gRhi->Cmd);
-
-	// Submit
-	VkPipelineStageFlags stagesToWait[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &m_MainWndContext.ImageSemaphore;
-	submitInfo.pWaitDstStageMask = stagesToWait;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &RHI::gRhi->Cmd;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &RHI::gRhi->RenderSemaphore;
-
-	vkQueueSubmit(RHI::gRhi->MainQueue, 1, &submitInfo, RHI::gRhi->QueueFence);
-
-	// Present
-	VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &RHI::gRhi->RenderSemaphore;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &m_MainWndContext.Swapchain;
-	presentInfo.pImageIndices = &imageIndex;
-	
-	vkQueuePresentKHR(RHI::gRhi->MainQueue, &presentInfo);
+	// Submit + Present
+	RHI::SubmitFrame(&m_MainWndContext, imageIndex);
 }
 
 LRESULT CALLBACK CEditorApplication::WndProc(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lparam)
 {
+	if (ImGui_ImplWin32_WndProcHandler(hwnd, umsg, wparam, lparam))
+		return true;
+
 	if (gEditor->m_bMainThreadInitialized) {
 		switch (umsg) {
 
@@ -132,7 +194,10 @@ LRESULT CALLBACK CEditorApplication::WndProc(HWND hwnd, UINT umsg, WPARAM wparam
 
 bool CEditorApplication::Initialize(const SEditorCreateInfo &Info)
 {
+	auto startupBegin = std::chrono::steady_clock::now();
+
 	m_hInstance = ::GetModuleHandleA(nullptr);
+	PROFILE_THREAD("Main");
 
 	// -- Create Window
 	WNDCLASSEXA WndClass = {};
@@ -173,17 +238,43 @@ bool CEditorApplication::Initialize(const SEditorCreateInfo &Info)
 
 	::RegisterRawInputDevices(&Rid, 1, sizeof(Rid));
 
+	// -- Spin up the job system (one worker per core, this thread is worker 0).
+	Jobs::Initialize();
+	IO::Initialize();
+
 	// -- Initialize RHI Driver.
 	RHI::Initialize(true); // @TODO: Make this actually care about whether or not we want to debug.
 	RHI::CreateWindowContext(m_Hwnd, &m_MainWndContext);
 
+	// -- UI. Keyboard goes through raw input (no legacy messages), so ImGui only gets the mouse.
+	ImGui::CreateContext();
+	ImGui::GetIO().IniFilename = nullptr;
+	ImGui_ImplWin32_Init(m_Hwnd);
+	RHI::InitializeImGui();
+	m_bShowProfiler = true;
+	m_bProfilerKeyHeld = false;
+
+	// -- Start-up is done once the first frame's pipeline is; compare runs with and without data\pipeline.cache.
+	RHI::GetPipeline(RHI::gRhi->DefaultPipeline);
+	auto &pipelineStats = RHI::GetPipelineStats();
+	printf("[Startup] %.2f ms, %s pipeline cache (%zu bytes, loaded in %.2f ms), %u pipelines compiled in %.2f ms.\n",
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count(),
+		pipelineStats.bWarmCache ? "warm" : "cold", pipelineStats.CacheSize, pipelineStats.CacheLoadMs,
+		pipelineStats.NumCompiled, pipelineStats.CompileMs);
+
 	return true;
 }
 
 void CEditorApplication::Release()
 {
+	RHI::ReleaseImGui();
+	ImGui_ImplWin32_Shutdown();
+	ImGui::DestroyContext();
+
 	RHI::ReleaseWindowContext(&m_MainWndContext);
 	RHI::Release();
+	IO::Release();
+	Jobs::Release();
 	::DestroyWindow(m_Hwnd);
 	ZeroThat(gEditor);
 }
\ No newline at end of file
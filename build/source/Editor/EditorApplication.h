@@ -1,6 +1,6 @@
 #pragma once
 #include <pch.h>
-#include <Engine/Rhi/RhiVulkan.h>
+#include <Engine/RHI/RhiVulkan.h>
 
 #include <Windows.h>
 
@@ -45,5 +45,10 @@ private:
 	} m_Input;
 
 	bool m_bMainThreadInitialized;
+	bool m_bShowProfiler; // F1.
+	bool m_bProfilerKeyHeld;
 };
-extern CEditorApplication *gEditor;
\ No newline at end of file
+extern CEditorApplication *gEditor;
+
+// ProfilerOverlay.cpp; empty when the profiler is compiled out.
+void DrawProfilerOverlay(bool *pOpen);
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include <pch.h>
+#include "EditorApplication.h"
+#include "Engine/Profiler.h"
+
+#include <imgui/imgui.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if PROFILE_ENABLED
+
+struct SZoneTotal
+{
+	const char *pName;
+	uint32_t Thread;
+	uint32_t Depth;
+	uint Calls;
+	uint64_t Total;
+	uint64_t Max;
+};
+
+static int CompareZoneTotals(const void *pA, const void *pB)
+{
+	auto a = ((const SZoneTotal *)pA)->Total;
+	auto b = ((const SZoneTotal *)pB)->Total;
+	return (a < b) ? 1 : (a > b) ? -1 : 0;
+}
+
+static float FrameTimeGetter(void *, int Index)
+{
+	uint64_t frame = Profiler::GetFrameNumber();
+	uint64_t first = (frame > PROFILE_HISTORY) ? frame - PROFILE_HISTORY : 0;
+	return Profiler::GetFrameTime(first + (uint64_t)Index);
+}
+
+static void FormatCounter(const profCounter_t &Counter, int64_t Value, char *pOut, size_t Size)
+{
+	if (Counter.type != eProfCounterBytes) {
+		snprintf(pOut, Size, "%lld", (long long)Value);
+		return;
+	}
+
+	if (Value >= 1024ll * 1024 * 1024)
+		snprintf(pOut, Size, "%.2f GB", (double)Value / (1024.0 * 1024.0 * 1024.0));
+	else if (Value >= 1024ll * 1024)
+		snprintf(pOut, Size, "%.2f MB", (double)Value / (1024.0 * 1024.0));
+	else if (Value >= 1024)
+		snprintf(pOut, Size, "%.2f KB", (double)Value / 1024.0);
+	else
+		snprintf(pOut, Size, "%lld B", (long long)Value);
+}
+
+// Zones of the same name on the same thread are summed, so a job that ran a hundred times is one row.
+static void DrawCpuZones()
+{
+	static TArray<SZoneTotal> totals;
+	totals.Clear();
+
+	auto &zones = Profiler::GetFrameZones();
+	for (uint i = 0; i != zones.Getcount(); ++i) {
+		auto &zone = zones[i];
+		uint64_t time = zone.end - zone.begin;
+
+		SZoneTotal *pTotal = nullptr;
+		for (uint j = 0; j != totals.Getcount(); ++j) {
+			if (totals[j].Thread == zone.thread && (totals[j].pName == zone.pName || !strcmp(totals[j].pName, zone.pName))) {
+				pTotal = &totals[j];
+				break;
+			}
+		}
+		if (!pTotal) {
+			pTotal = &totals.Push({ zone.pName, zone.thread, zone.depth, 0, 0, 0 });
+		}
+
+		pTotal->Calls++;
+		pTotal->Total += time;
+		if (time > pTotal->Max)
+			pTotal->Max = time;
+		if (zone.depth < pTotal->Depth)
+			pTotal->Depth = zone.depth;
+	}
+
+	if (totals.Getcount())
+		qsort(totals.GetPtr(), totals.Getcount(), sizeof(SZoneTotal), CompareZoneTotals);
+
+	if (!ImGui::BeginTable("CpuZones", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY, ImVec2(0.0f, 240.0f)))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Zone");
+	ImGui::TableSetupColumn("Thread");
+	ImGui::TableSetupColumn("Calls");
+	ImGui::TableSetupColumn("Total ms");
+	ImGui::TableSetupColumn("Max ms");
+	ImGui::TableHeadersRow();
+
+	for (uint i = 0; i != totals.Getcount(); ++i) {
+		auto &total = totals[i];
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("%*s%s", (int)total.Depth * 2, "", total.pName);
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(Profiler::GetThreadName(total.Thread));
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", total.Calls);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", (double)total.Total / 1000000.0);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", (double)total.Max / 1000000.0);
+	}
+
+	ImGui::EndTable();
+}
+
+static void DrawGpuZones()
+{
+	auto &zones = Profiler::GetGpuZones();
+	if (zones.Getcount() == 0) {
+		ImGui::TextDisabled("No GPU timings (timestamps unsupported, or no frame resolved yet).");
+		return;
+	}
+
+	if (!ImGui::BeginTable("GpuZones", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+		return;
+
+	ImGui::TableSetupColumn("Zone");
+	ImGui::TableSetupColumn("ms");
+	ImGui::TableHeadersRow();
+
+	for (uint i = 0; i != zones.Getcount(); ++i) {
+		auto &zone = zones[i];
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("%*s%s", (int)zone.depth * 2, "", zone.pName);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", (double)(zone.end - zone.begin) / 1000000.0);
+	}
+
+	ImGui::EndTable();
+}
+
+static void DrawCounters(uint64_t LastFrame)
+{
+	if (!ImGui::BeginTable("Counters", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+		return;
+
+	ImGui::TableSetupColumn("Counter");
+	ImGui::TableSetupColumn("Value");
+	ImGui::TableHeadersRow();
+
+	char value[64];
+	for (uint i = 0; i != Profiler::GetNumCounters(); ++i) {
+		auto &counter = Profiler::GetCounter(i);
+		FormatCounter(counter, counter.history[LastFrame % PROFILE_HISTORY], value, sizeof(value));
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(counter.pName);
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(value);
+	}
+
+	ImGui::EndTable();
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void DrawProfilerOverlay(bool *pOpen)
+{
+	PROFILE_ZONE("DrawProfilerOverlay");
+
+	ImGui::SetNextWindowSize(ImVec2(520.0f, 640.0f), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", pOpen)) {
+		ImGui::End();
+		return;
+	}
+
+	uint64_t frame = Profiler::GetFrameNumber();
+	uint64_t lastFrame = frame ? frame - 1 : 0;
+
+	// -- Frame times.
+	char overlay[64];
+	snprintf(overlay, sizeof(overlay), "%.2f ms", Profiler::GetFrameTime(lastFrame));
+	ImGui::PlotLines("##FrameTimes", FrameTimeGetter, nullptr, PROFILE_HISTORY, 0, overlay, 0.0f, 33.3f, ImVec2(-1.0f, 80.0f));
+
+	// -- Capture.
+	if (Profiler::IsCapturing()) {
+		if (ImGui::Button("Stop capture"))
+			Profiler::StopCapture(STR("profile.json"));
+		ImGui::SameLine();
+		ImGui::TextUnformatted("Recording...");
+	} else if (ImGui::Button("Start capture")) {
+		Profiler::StartCapture();
+	}
+
+	if (uint dropped = Profiler::GetNumDroppedZones()) {
+		ImGui::SameLine();
+		ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "%u zones dropped", dropped);
+	}
+
+	if (ImGui::CollapsingHeader("CPU", ImGuiTreeNodeFlags_DefaultOpen))
+		DrawCpuZones();
+	if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen))
+		DrawGpuZones();
+	if (ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen))
+		DrawCounters(lastFrame);
+
+	ImGui::End();
+}
+
+#else
+
+void DrawProfilerOverlay(bool *)
+{
+}
+
+#endif // PROFILE_ENABLED
@@ -1,5 +1,6 @@
 #include <pch.h>
 #include <Editor/EditorApplication.h>
+#include <Engine/Profiler.h>
 
 #if defined(_DEBUG)
 int main(int argc, char **argv)
@@ -62,6 +63,7 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nC
 
 		while (!EditorApp.ShouldClose()) {
 			EditorApp.Tick();
+			PROFILE_END_FRAME(); // After Tick() so its zone closes inside the frame it belongs to.
 		}
 
 		EditorApp.HideWindow();
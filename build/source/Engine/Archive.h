@@ -0,0 +1,111 @@
+#if !defined(_ENGINE_ARCHIVE_H_)
+#define _ENGINE_ARCHIVE_H_
+
+#include <pch.h>
+#include <Engine/FileIO.h>
+#include <Stl/Container.h>
+#include <Stl/Name.h>
+
+// Packed asset archive.
+// - Layout: header, then entry data (each entry at its own alignment), then the TOC.
+// - The TOC is sorted by a 64-bit hash of the entry's normalised path (lower case, '/' separators), so a
+//   lookup is a binary search over fixed-size records and never touches a string.
+// - Entries are either stored as-is or split into ARCHIVE_BLOCK_SIZE blocks that are LZ compressed one by one.
+//   A block table (one uint32_t per block, top bit = stored raw) sits in front of compressed data.
+// - At runtime the whole file is mapped read-only: stored entries are zero-copy views into the mapping,
+//   compressed ones are decompressed a block per job.
+// All on-disk fields are fixed-width little-endian.
+#define ARCHIVE_MAGIC 0x4B415044 // 'DPAK'
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_SIZE KILOBYTES(64)
+#define ARCHIVE_BLOCK_RAW 0x80000000u
+
+#define ARCHIVE_ENTRY_COMPRESSED 0x01
+
+struct archiveHeader_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numEntries;
+	uint32_t flags;
+	uint64_t tocOffset;
+	uint64_t fileSize;
+};
+
+struct archiveEntry_t
+{
+	uint64_t hash;
+	uint64_t offset;     // Of the block table for compressed entries, of the data otherwise.
+	uint64_t storedSize; // Bytes in the archive, block table included.
+	uint64_t rawSize;
+	uint32_t numBlocks;
+	uint32_t flags;
+};
+
+uint64_t ArchiveHashPath(const char *Path, uint Length);
+uint64_t ArchiveHashPath(const wchar_t *Path, uint Length);
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Either a view into the archive or a buffer that was decompressed into; Release() frees only the latter.
+struct archiveData_t
+{
+	const void *pData;
+	size_t Size;
+	void *pOwned;
+	struct dmHeap_t *pOwner; // Heap 'pOwned' came from, or null for malloc.
+
+	void Release();
+};
+
+struct archive_t
+{
+	bool Open(const TCHAR *Path);
+	void Close();
+
+	const archiveEntry_t *Find(uint64_t Hash) const;
+	inline const archiveEntry_t *Find(const char *Path) const { return Find(ArchiveHashPath(Path, TStrlen(Path))); }
+	inline const archiveEntry_t *Find(const wchar_t *Path) const { return Find(ArchiveHashPath(Path, TStrlen(Path))); }
+	inline const archiveEntry_t *Find(SName Name) const { return Find(ArchiveHashPath(Name.GetString(), Name.GetLength())); }
+
+	// Null for compressed entries.
+	const void *GetView(const archiveEntry_t *pEntry) const;
+
+	// 'pDst' must hold pEntry->rawSize bytes. Blocks are spread over the job system when it's running.
+	bool Decompress(const archiveEntry_t *pEntry, void *pDst) const;
+
+	// A view for stored entries, otherwise a buffer from 'pHeap' (or malloc) with the entry decompressed into it.
+	bool Load(const archiveEntry_t *pEntry, archiveData_t *pOut, struct dmHeap_t *pHeap = nullptr) const;
+
+	inline uint GetNumEntries() const { return m_pHeader ? m_pHeader->numEntries : 0; }
+	inline bool IsOpen() const { return m_pHeader != nullptr; }
+
+	/* ----- Members ----- */
+	mappedFile_t m_File;
+	const archiveHeader_t *m_pHeader;
+	const archiveEntry_t *m_pEntries;
+};
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Collects entries in memory and lays the archive out in one go on Write(). Compression happens in Add(),
+// block-parallel across the job system when it's running. Entries that don't shrink are stored raw.
+struct archiveBuilder_t
+{
+	// 'Align' must be a power of two; use the page size for data that will be handed straight to an API.
+	bool Add(const char *Path, const void *pData, size_t Size, uint Align = 16, bool bCompress = false);
+	bool Write(const TCHAR *OutPath);
+	void Release();
+
+	struct pending_t
+	{
+		archiveEntry_t entry;
+		uint align;
+		void *pData; // Block table + blocks for compressed entries.
+	};
+
+	/* ----- Members ----- */
+	TArray<pending_t> m_Pending;
+};
+
+#endif // _ENGINE_ARCHIVE_H_
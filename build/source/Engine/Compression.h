@@ -0,0 +1,19 @@
+#if !defined(_ENGINE_COMPRESSION_H_)
+#define _ENGINE_COMPRESSION_H_
+
+#include <pch.h>
+
+// LZ4 block format (no frame header, no checksum), so blocks can be inspected with stock lz4 tools.
+// The compressor is the simple greedy single-probe kind: fast, not the best ratio. Decompression
+// checks every length and offset against both buffers, so a corrupt block fails rather than overruns.
+
+// Worst-case output size for 'Size' input bytes.
+inline size_t LzCompressBound(size_t Size) { return Size + (Size / 255) + 16; }
+
+// Returns the compressed size, or 0 if it didn't fit in 'DstCapacity'.
+size_t LzCompress(const void *pSrc, size_t SrcSize, void *pDst, size_t DstCapacity);
+
+// 'DstSize' must be the exact decompressed size.
+bool LzDecompress(const void *pSrc, size_t SrcSize, void *pDst, size_t DstSize);
+
+#endif // _ENGINE_COMPRESSION_H_
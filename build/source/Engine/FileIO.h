@@ -11,22 +11,89 @@ struct fileBlob_t
 {
 	size_t Size;
 	void *pBuffer;
+	struct dmHeap_t *pOwner; // Heap the buffer came from, or null for malloc.
+
+	inline void Release();
 };
 bool ReadEntireFile(const TCHAR *Path, fileBlob_t *pBlob);
 void ReleaseFileBlob(fileBlob_t *pBlob);
+inline void fileBlob_t::Release() { ReleaseFileBlob(this); }
+
+// Positional read into caller memory. 'pRead' receives the bytes actually read (less than 'Size' at EOF).
+bool ReadFileRange(const TCHAR *Path, uint64 Offset, size_t Size, void *pDst, size_t *pRead);
+bool QueryFileSize(const TCHAR *Path, uint64 *pSize);
+bool QueryFileWriteTime(const TCHAR *Path, uint64 *pTime); // Opaque and only good for comparing against itself.
+bool WriteEntireFile(const TCHAR *Path, const void *pData, size_t Size); // Creates or truncates.
 
 // ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Read-only, zero-copy view of a whole file.
 struct mappedFile_t
 {
 	void *Handle;
+	void *Mapping;
 	size_t Size;
 	void *pView;
 
-	void Release();
+	inline void Release();
 };
 bool MapFile(const TCHAR *Path, mappedFile_t *pOut);
 void UnmapFile(mappedFile_t *pFile);
+inline void mappedFile_t::Release() { UnmapFile(this); }
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Asynchronous reads.
+// - Requests are queued by priority and serviced by io_uring on Linux when the kernel allows it, otherwise by a
+//   small pool of threads doing positional reads. Each pool thread drains several small requests per wake-up.
+// - Reads go straight into 'pDst' if given, otherwise into a buffer from the I/O heap (release it with ReleaseFileBlob).
+// - Completion is either a callback (run on an I/O thread; it owns the blob and the request is gone once it returns)
+//   or IO::Wait(). Reads that have a callback get a 0 handle. Callbacks may submit more reads but mustn't Wait() on
+//   one, and never wait for a slot: when all are taken, what they submit fails straight away.
+enum EIoPriority
+{
+	eIoPriorityLow,
+	eIoPriorityNormal,
+	eIoPriorityHigh,
+	eIoPriorityCount,
+};
+
+struct ioResult_t
+{
+	bool bSuccess;
+	fileBlob_t Blob;
+	void *pUser;
+};
+typedef void (*ioCallback_t)(const ioResult_t *pResult);
+
+struct ioReadDesc_t
+{
+	const TCHAR *Path;   // Copied; doesn't need to outlive the call.
+	uint64 Offset;
+	size_t Size;         // 0 = to the end of the file. Reads past the end come back short.
+	void *pDst;          // Optional; must hold 'Size' bytes. Rejected (handle 0, failed callback) with a 0 'Size'.
+	EIoPriority Priority;
+	ioCallback_t pCallback;
+	void *pUser;
+};
+
+typedef uint32 ioHandle_t; // 0 is never a valid handle.
+
+namespace IO {
+	bool Initialize(uint NumThreads = 2, size_t BufferHeapSize = MEGABYTES(64));
+	void Release();
+
+	ioHandle_t Read(const ioReadDesc_t &Desc);
+	// Waits for a free slot while reads are in flight. If every slot holds a result nobody has collected with
+	// Wait(), or the caller is a completion callback, the rest of the batch fails instead (handle 0, failed
+	// callback); collect and resubmit.
+	void ReadBatch(const ioReadDesc_t *pDescs, uint Num, ioHandle_t *pOutHandles);
+
+	bool IsDone(ioHandle_t Handle);
+	bool Wait(ioHandle_t Handle, fileBlob_t *pOut); // Returns false if the read failed.
+
+	bool IsUsingIoUring();
+}
 
 // ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -42,4 +109,4 @@ void ReleaseSharedLib(sharedLib_t *pLib);
 bool IsSharedLibDirty(sharedLib_t *pLib);
 void *LoadProc(sharedLib_t pLib, const char *procName);
 
-#endif // _ENGINE_FILESYSTEM_H_
\ No newline at end of file
+#endif // _ENGINE_FILESYSTEM_H_
@@ -5,6 +5,7 @@
 #include "InputKey.inl"
 #include <Stl/String.h>
 #include <Stl/Container.h>
+#include <Stl/Name.h>
 
 #include <functional>
 
@@ -109,7 +110,7 @@ struct SInputBindingGroup
 
 struct SInputAction
 {
-	String Name;
+	SName Name;
 	EInputPrimitive PrimitiveType;
 	TArray<SInputBindingGroup> Groups;
 	TArray<std::function> RegisteredCallbacks;
@@ -117,16 +118,49 @@ struct SInputAction
 
 struct SInputMap
 {
-	String Name;
+	SName Name;
 	TArray<SInputAction> Actions;
+	TMap<SName, uint> ActionIndices; // Name -> index into 'Actions'. Only touch 'Actions' through AddAction().
+
+	inline SInputAction *FindAction(SName ActionName) {
+		auto pIndex = ActionIndices.Find(ActionName);
+		return (pIndex) ? &Actions[*pIndex] : nullptr;
+	}
+
+	// Returns the existing action if there is one. The pointer is good until the next AddAction().
+	SInputAction *AddAction(SName ActionName, EInputPrimitive PrimitiveType) {
+		if (auto pAction = FindAction(ActionName))
+			return pAction;
+
+		ActionIndices.Insert(ActionName, Actions.Getcount());
+		auto &action = Actions.Push({});
+		action.Name = ActionName;
+		action.PrimitiveType = PrimitiveType;
+		return &action;
+	}
 };
 
 struct CInputManager
 {
-
+	inline SInputMap *FindMap(SName MapName) {
+		auto pIndex = m_MapIndices.Find(MapName);
+		return (pIndex) ? &m_Maps[*pIndex] : nullptr;
+	}
+
+	// Returns the existing map if there is one. The pointer is good until the next AddMap().
+	SInputMap *AddMap(SName MapName) {
+		if (auto pMap = FindMap(MapName))
+			return pMap;
+
+		m_MapIndices.Insert(MapName, m_Maps.Getcount());
+		auto &map = m_Maps.Push({});
+		map.Name = MapName;
+		return &map;
+	}
 
 protected:
 	TArray<SInputMap> m_Maps;
+	TMap<SName, uint> m_MapIndices; // Name -> index into 'm_Maps'.
 };
 
 #endif // _ENGINE_INPUT_MAP_H_
\ No newline at end of file
@@ -0,0 +1,74 @@
+#if !defined(_ENGINE_JOB_SYSTEM_H_)
+#define _ENGINE_JOB_SYSTEM_H_
+
+#include <pch.h>
+#include <Stl/Container.h>
+
+#include <atomic>
+
+// - One worker thread per core (the thread that calls Jobs::Initialize is worker 0 and only runs jobs while it's waiting).
+// - Each worker owns a Chase-Lev deque: it pushes/pops at the bottom, idle workers steal from the top.
+// - Threads that aren't workers (or whose deque is full) submit through a small locked queue.
+// - A jobCounter_t is incremented by every job submitted against it and decremented as each one finishes,
+//   so it doubles as a join point (Jobs::Wait) and a dependency (Jobs::RunAfter).
+// - Workers with nothing to do park on a condition variable instead of spinning.
+//
+// Workers also take the matching dmFrameArena_t thread index, so PushThread() is safe from inside a job.
+
+typedef void (*jobFunc_t)(void *pData);
+
+struct jobDecl_t
+{
+	jobFunc_t pFunc;
+	void *pData;
+};
+
+struct jobWaiter_t;
+struct jobCounter_t
+{
+	jobCounter_t() : count(0), busy(0), pWaiters(nullptr) {}
+	jobCounter_t(const jobCounter_t &) = delete;
+
+	inline bool IsDone() { return count.load(std::memory_order_acquire) == 0 && busy.load(std::memory_order_acquire) == 0; }
+
+	std::atomic<int32_t> count;
+	std::atomic<int32_t> busy; // Jobs still finishing up; the counter must outlive them.
+	std::atomic<jobWaiter_t *> pWaiters; // Jobs to submit once 'count' reaches zero.
+};
+
+namespace Jobs {
+	bool Initialize(uint NumThreads = 0); // 0 = one per core.
+	void Release();
+
+	uint GetNumThreads();
+	uint GetThreadIndex(); // (uint)-1 on threads the job system doesn't own.
+
+	void Run(const jobDecl_t *pJobs, uint Num, jobCounter_t *pCounter);
+	void RunAfter(jobCounter_t *pDependency, const jobDecl_t *pJobs, uint Num, jobCounter_t *pCounter);
+	inline void Run(jobFunc_t pFunc, void *pData, jobCounter_t *pCounter) { jobDecl_t decl = { pFunc, pData }; Run(&decl, 1, pCounter); }
+
+	// Runs other jobs on the calling thread until 'pCounter' reaches zero.
+	void Wait(jobCounter_t *pCounter);
+
+	// Splits [0, Count) into chunks of at least 'Grain' and calls pFunc(begin, end, pData) for each, then waits.
+	typedef void (*rangeFunc_t)(uint Begin, uint End, void *pData);
+	void ParallelFor(uint Count, uint Grain, rangeFunc_t pFunc, void *pData);
+
+	// Func(T &Element, uint Index) for every element of 'Array'.
+	template <typename T, typename A, typename F>
+	void ParallelFor(TArray<T, A> &Array, uint Grain, F &&Func)
+	{
+		struct range_t {
+			T *pElements;
+			F *pFunc;
+		} range = { Array.GetPtr(), &Func };
+
+		ParallelFor(Array.Getcount(), Grain, [](uint Begin, uint End, void *pData) {
+			auto pRange = (range_t *)pData;
+			for (uint i = Begin; i != End; ++i)
+				(*pRange->pFunc)(pRange->pElements[i], i);
+		}, &range);
+	}
+}
+
+#endif // _ENGINE_JOB_SYSTEM_H_
@@ -3,50 +3,237 @@
 
 #include <pch.h>
 
+#include <atomic>
+
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Bump allocator. Push never wraps; it returns nullptr and counts the overflow once the arena is full.
+// Memory is only zeroed when the arena is initialized with DM_ARENA_ZERO, and then only the bytes
+// that are actually pushed.
+#define DM_ARENA_ZERO 0x01
+
 struct dmRingArena_t 
 {
 	dmRingArena_t() = default;
-	dmRingArena_t(const size_t inSize);
+	dmRingArena_t(const size_t inSize, const uint inFlags = 0);
 
-	bool Initialize(const size_t inSize);
+	bool Initialize(const size_t inSize, const uint inFlags = 0);
 	void Release();
 	void Reset();
-	void *Push(const size_t inSize);
-	void Pop(const size_t inSize);
+	void *Push(const size_t inSize, const size_t inAlign = 8);
+	void Pop(const size_t inSize); // Only valid for the most recent Push.
+
+	inline uintptr_t GetMarker() { return m_next; }
+	inline void Rewind(const uintptr_t inMarker) { m_next = inMarker; }
+	inline size_t GetUsed() { return (size_t)(m_next - m_floor); }
+	inline size_t GetSize() { return (size_t)(m_ceiling - m_floor); }
 
 	/* ----- Members ----- */
 	uintptr_t m_floor;
 	uintptr_t m_ceiling;
 	uintptr_t m_next;
+	size_t m_highWater; // Most bytes in use at once since Initialize.
+	uint m_flags;
+	uint m_numOverflows;
+};
+
+// Rolls the arena back to where it was when the scope was opened.
+struct dmArenaScope_t
+{
+	dmArenaScope_t(dmRingArena_t *pArena) : m_pArena(pArena), m_marker(pArena->GetMarker()) {}
+	~dmArenaScope_t() { m_pArena->Rewind(m_marker); }
+
+	dmArenaScope_t(const dmArenaScope_t &) = delete;
+	dmArenaScope_t &operator =(const dmArenaScope_t &) = delete;
+
+	dmRingArena_t *m_pArena;
+	uintptr_t m_marker;
+};
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// One set of arenas per frame in flight. Each set has an arena for every thread so pushes from
+// worker threads never contend; a thread's slot comes from GetThreadIndex(). A frame's arenas are
+// only reset once RetireFrame() has been called with that frame number (i.e. its fence signalled),
+// so BeginFrame() fails rather than stomping memory the GPU may still be reading.
+#define DM_FRAME_ARENA_MAX_FRAMES 4
+
+struct dmFrameArena_t
+{
+	dmFrameArena_t() = default;
+
+	bool   Initialize(const uint inNumFrames, const size_t inFrameSize, const uint inNumThreads, const size_t inThreadSize, const uint inFlags = 0);
+	void   Release();
+	bool   BeginFrame();
+	void   RetireFrame(const uint64_t inFrame);
+	void  *Push(const size_t inSize, const size_t inAlign = 8);
+	void  *PushThread(const size_t inSize, const size_t inAlign = 8);
+	size_t GetHighWater();
+	size_t GetThreadHighWater();
+	uint   GetNumOverflows();
+
+	inline uint64_t GetFrame() { return m_frame; }
+	inline dmRingArena_t *GetArena() { return &m_pFrames[m_slot].arena; }
+	dmRingArena_t *GetThreadArena(); // Null if the calling thread's index is out of range.
+
+	// Indices are handed out on first use unless a thread sets its own. ReserveThreadIndices() keeps [0, inCount)
+	// for threads that will call SetThreadIndex(), so it has to run before any other thread asks for an index.
+	static uint GetThreadIndex();
+	static void SetThreadIndex(const uint inIndex);
+	static void ReserveThreadIndices(const uint inCount);
+
+	/* ----- Members ----- */
+	struct alignas(64) slot_t {
+		dmRingArena_t arena; // Padded to a cache line so neighbouring threads don't false share.
+	};
+
+	slot_t *m_pFrames;  // [numFrames]
+	slot_t *m_pThreads; // [numFrames * numThreads]
+	uint64_t m_frameInSlot[DM_FRAME_ARENA_MAX_FRAMES];
+	std::atomic<uint64_t> m_retired;
+	uint64_t m_frame;
+	uint m_slot;
+	uint m_numFrames;
+	uint m_numThreads;
 };
 
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Two-level segregated fit (TLSF) heap. Alloc/Free are O(1): the first level splits sizes by
+// power of two, the second level splits each power of two into DM_HEAP_SL_COUNT linear classes,
+// and a pair of bitmaps finds the first non-empty class with two bit scans. Every block carries a
+// boundary tag (its physical predecessor) so neighbouring free blocks merge as soon as they're freed.
+//
+// The heap is single threaded unless it's initialized with DM_HEAP_THREADSAFE. DM_HEAP_THREAD_CACHE
+// additionally keeps a small per-thread cache of recently freed small blocks in front of the lock.
+// A thread can only cache blocks for one heap at a time; call FlushThreadCache() on a thread before
+// it moves on to another cached heap. A cache bound to a heap that has since been Reset() or Released()
+// is dropped by the thread's next Free() into a cached heap. At most DM_HEAP_MAX_CACHED cached heaps
+// can be alive at once; any more run without the cache.
+
+#define DM_HEAP_ALIGN_LOG2 4
+#define DM_HEAP_ALIGN (1 << DM_HEAP_ALIGN_LOG2)
+#define DM_HEAP_SL_LOG2 5
+#define DM_HEAP_SL_COUNT (1 << DM_HEAP_SL_LOG2)
+#define DM_HEAP_FL_SHIFT (DM_HEAP_SL_LOG2 + DM_HEAP_ALIGN_LOG2)
+#define DM_HEAP_FL_MAX 38 // Largest block class is 256GB.
+#define DM_HEAP_FL_COUNT (DM_HEAP_FL_MAX - DM_HEAP_FL_SHIFT + 1)
+#define DM_HEAP_SMALL_SIZE (1 << DM_HEAP_FL_SHIFT)
+
+#define DM_HEAP_THREADSAFE 0x01
+#define DM_HEAP_THREAD_CACHE 0x02 // Implies DM_HEAP_THREADSAFE.
+#define DM_HEAP_MAX_CACHED 64
+
+struct dmHeapStats_t
+{
+	size_t capacity;         // Usable bytes in the pool.
+	size_t liveBytes;        // Bytes currently handed out (thread-cached blocks count as live).
+	size_t peakBytes;        // High-water mark of liveBytes.
+	size_t freeBytes;
+	size_t largestFreeBlock;
+	uint   numAllocs;
+	uint   numFreeBlocks;
+	float  fragmentation;    // 0 = all free memory is one block, approaching 1 = shattered.
+};
+
 struct dmHeap_t
 {
 	dmHeap_t() = default;
-	dmHeap_t(const size_t inSize) { this->Initialize(inSize); }
+	dmHeap_t(const size_t inSize, const uint inFlags = 0) { this->Initialize(inSize, inFlags); }
 
-	bool  Initialize(const size_t inSize);
+	bool  Initialize(const size_t inSize, const uint inFlags = 0);
 	void  Release();
 	void  Reset();
 	void *Alloc(const size_t inSize);
+	void *AllocAligned(const size_t inSize, const size_t inAlign);
 	void *Realloc(const void *inPtr, const size_t inSize);
 	void  Free(const void *inPtr);
-	uint  DefragAll();
+	void  FlushThreadCache();
+	void  GetStats(dmHeapStats_t *pOut);
+
+	static size_t GetAllocSize(const void *inPtr);
 
 	/* ----- Members ----- */
 	struct header_t {
-		header_t *pNext;
-		size_t size;
+		header_t *pPrevPhys; // Boundary tag. Null for the first block in the pool.
+		size_t size;         // Payload size. The low bit is set while the block is free.
+		
+		// Only valid while the block is free; these live in the payload.
+		header_t *pNextFree;
+		header_t *pPrevFree;
 	};
-	uint  DefragOne(header_t *pHeader);
+
+private:
+	void *AllocLocked(const size_t inSize, const size_t inAlign);
+	void *ReallocLocked(const void *inPtr, const size_t inSize);
+	void  FreeLocked(const void *inPtr);
+	void  InsertFree(header_t *pBlock);
+	void  RemoveFree(header_t *pBlock);
+	header_t *FindFree(size_t inSize);
+	header_t *Split(header_t *pBlock, size_t inSize);
+	header_t *Merge(header_t *pBlock);
+	void  Lock();
+	void  Unlock();
 
 	void *m_baseAddr;
-	header_t *m_pFirst;
 	size_t m_allocatedSize;
+	uint m_flags;
+	uint m_id; // Changes on every Initialize/Reset so stale thread caches can be dropped.
+	struct dmHeapLock_t *m_pLock;
+
+	uint32_t m_flBitmap;
+	uint32_t m_slBitmap[DM_HEAP_FL_COUNT];
+	header_t *m_pFreeHeads[DM_HEAP_FL_COUNT][DM_HEAP_SL_COUNT];
+
+	size_t m_liveBytes;
+	size_t m_peakBytes;
+	size_t m_freeBytes;
+	uint m_numAllocs;
+	uint m_numFreeBlocks;
+};
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Allocator adapters for the Stl containers, e.g. TArray<int, dmHeapAllocator_t> arr(dmHeapAllocator_t{ &heap }).
+struct dmHeapAllocator_t
+{
+	dmHeap_t *pHeap;
+
+	inline void *Alloc(size_t inSize) { return pHeap->Alloc(inSize); }
+	inline void *Realloc(void *inPtr, size_t, size_t inNewSize) { return pHeap->Realloc(inPtr, inNewSize); }
+	inline void Free(void *inPtr, size_t) { pHeap->Free(inPtr); }
+};
+
+// Arena memory is only given back when the arena is reset, except for the most recent push which can
+// grow or be popped in place.
+struct dmArenaAllocator_t
+{
+	dmRingArena_t *pArena;
+
+	inline void *Alloc(size_t inSize) { return pArena->Push(inSize, 16); }
+	
+	void *Realloc(void *inPtr, size_t inOldSize, size_t inNewSize) 
+	{
+		if (inPtr && ((uintptr_t)inPtr + inOldSize) == pArena->m_next && ((uintptr_t)inPtr + inNewSize) <= pArena->m_ceiling) {
+			pArena->m_next = (uintptr_t)inPtr + inNewSize;
+			if ((pArena->m_next - pArena->m_floor) > pArena->m_highWater)
+				pArena->m_highWater = (pArena->m_next - pArena->m_floor);
+			if ((pArena->m_flags & DM_ARENA_ZERO) && inNewSize > inOldSize)
+				memset((uint8 *)inPtr + inOldSize, 0, inNewSize - inOldSize); // As Push() would have.
+			return inPtr;
+		}
+
+		auto pDst = pArena->Push(inNewSize, 16);
+		if (pDst && inPtr)
+			memcpy(pDst, inPtr, (inOldSize < inNewSize) ? inOldSize : inNewSize);
+		return pDst;
+	}
+
+	inline void Free(void *inPtr, size_t inSize) 
+	{
+		if (((uintptr_t)inPtr + inSize) == pArena->m_next)
+			pArena->m_next = (uintptr_t)inPtr;
+	}
 };
 
 #endif // _ENGINE_MEMORY_ARENA_H_
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include <pch.h>
+#include <Engine/Archive.h>
+#include <Engine/Compression.h>
+#include <Engine/JobSystem.h>
+#include <Engine/Memory.h>
+
+#include <algorithm>
+#include <atomic>
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FNV-1a over the normalised path. Has to stay stable across runs and builds, so it can't be an SName id.
+uint64_t ArchiveHashPath(const char *Path, uint Length)
+{
+	uint i = 0;
+	while (i != Length && (Path[i] == '/' || Path[i] == '\\' || (Path[i] == '.' && (i + 1) != Length && (Path[i + 1] == '/' || Path[i + 1] == '\\'))))
+		++i;
+
+	uint64_t hash = 14695981039346656037ull;
+	for (; i != Length; ++i) {
+		uint8 c = (uint8)Path[i];
+		if (c == '\\')
+			c = '/';
+		else if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		hash = (hash ^ c) * 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t ArchiveHashPath(const wchar_t *Path, uint Length)
+{
+	TString<char> utf8;
+	TWideToUtf8(Path, Length, &utf8);
+	return ArchiveHashPath(utf8, utf8.Length());
+}
+
+void archiveData_t::Release()
+{
+	if (pOwned) {
+		if (pOwner)
+			pOwner->Free(pOwned);
+		else
+			free(pOwned);
+	}
+	ZeroThis();
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool archive_t::Open(const TCHAR *Path)
+{
+	ZeroThis();
+
+	if (!MapFile(Path, &m_File))
+		return false;
+
+	auto pBase = (const uint8 *)m_File.pView;
+	auto pHeader = (const archiveHeader_t *)pBase;
+	uint64_t size = (uint64_t)m_File.Size;
+
+	bool bValid = size >= sizeof(archiveHeader_t) &&
+		pHeader->magic == ARCHIVE_MAGIC &&
+		pHeader->version == ARCHIVE_VERSION &&
+		pHeader->fileSize == size &&
+		(pHeader->tocOffset % alignof(archiveEntry_t)) == 0 &&
+		pHeader->tocOffset <= size &&
+		(size - pHeader->tocOffset) / sizeof(archiveEntry_t) >= pHeader->numEntries;
+
+	// Check every entry once here so lookups and loads can trust the TOC.
+	auto pEntries = (const archiveEntry_t *)(pBase + (bValid ? pHeader->tocOffset : 0));
+	for (uint32_t i = 0; bValid && i != pHeader->numEntries; ++i) {
+		auto &entry = pEntries[i];
+		bValid = entry.offset <= pHeader->tocOffset &&
+			entry.storedSize <= (pHeader->tocOffset - entry.offset) &&
+			(i == 0 || pEntries[i - 1].hash < entry.hash);
+
+		if (bValid && (entry.flags & ARCHIVE_ENTRY_COMPRESSED)) {
+			bValid = entry.numBlocks == (entry.rawSize + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE &&
+				(uint64_t)entry.numBlocks * sizeof(uint32_t) <= entry.storedSize &&
+				(entry.offset % alignof(uint32_t)) == 0;
+		} else if (bValid) {
+			bValid = entry.storedSize == entry.rawSize;
+		}
+	}
+
+	if (!bValid) {
+		UnmapFile(&m_File);
+		ZeroThis();
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	m_pEntries = pEntries;
+	return true;
+}
+
+void archive_t::Close()
+{
+	UnmapFile(&m_File);
+	ZeroThis();
+}
+
+const archiveEntry_t *archive_t::Find(uint64_t Hash) const
+{
+	if (!m_pHeader)
+		return nullptr;
+
+	uint32_t lo = 0;
+	uint32_t hi = m_pHeader->numEntries;
+	while (lo < hi) {
+		uint32_t mid = lo + ((hi - lo) >> 1);
+		if (m_pEntries[mid].hash < Hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo != m_pHeader->numEntries && m_pEntries[lo].hash == Hash) ? &m_pEntries[lo] : nullptr;
+}
+
+const void *archive_t::GetView(const archiveEntry_t *pEntry) const
+{
+	if (pEntry->flags & ARCHIVE_ENTRY_COMPRESSED)
+		return nullptr;
+	return (const uint8 *)m_File.pView + pEntry->offset;
+}
+
+bool archive_t::Decompress(const archiveEntry_t *pEntry, void *pDst) const
+{
+	auto pBase = (const uint8 *)m_File.pView + pEntry->offset;
+	if (!(pEntry->flags & ARCHIVE_ENTRY_COMPRESSED)) {
+		memcpy(pDst, pBase, (size_t)pEntry->rawSize);
+		return true;
+	}
+
+	// Block offsets come from a prefix sum over the table; the blocks themselves are independent.
+	auto pTable = (const uint32_t *)pBase;
+	TArray<uint64_t> starts;
+	starts.Resize(pEntry->numBlocks);
+
+	uint64_t at = (uint64_t)pEntry->numBlocks * sizeof(uint32_t);
+	for (uint32_t i = 0; i != pEntry->numBlocks; ++i) {
+		starts[i] = at;
+		at += pTable[i] & ~ARCHIVE_BLOCK_RAW;
+	}
+	if (at > pEntry->storedSize)
+		return false;
+
+	struct decompress_t {
+		const archiveEntry_t *pEntry;
+		const uint8 *pBase;
+		const uint32_t *pTable;
+		const uint64_t *pStarts;
+		uint8 *pDst;
+		std::atomic<bool> bFailed;
+	} work = { pEntry, pBase, pTable, starts.GetPtr(), (uint8 *)pDst, { false } };
+
+	Jobs::ParallelFor(pEntry->numBlocks, 1, [](uint Begin, uint End, void *pData) {
+		auto pWork = (decompress_t *)pData;
+		for (uint i = Begin; i != End; ++i) {
+			uint64_t rawOffset = (uint64_t)i * ARCHIVE_BLOCK_SIZE;
+			size_t rawSize = (size_t)std::min<uint64_t>(ARCHIVE_BLOCK_SIZE, pWork->pEntry->rawSize - rawOffset);
+			size_t srcSize = pWork->pTable[i] & ~ARCHIVE_BLOCK_RAW;
+			auto pSrc = pWork->pBase + pWork->pStarts[i];
+
+			if (pWork->pTable[i] & ARCHIVE_BLOCK_RAW) {
+				if (srcSize != rawSize) {
+					pWork->bFailed.store(true, std::memory_order_relaxed);
+					continue;
+				}
+				memcpy(pWork->pDst + rawOffset, pSrc, rawSize);
+			} else if (!LzDecompress(pSrc, srcSize, pWork->pDst + rawOffset, rawSize)) {
+				pWork->bFailed.store(true, std::memory_order_relaxed);
+			}
+		}
+	}, &work);
+
+	return !work.bFailed.load();
+}
+
+bool archive_t::Load(const archiveEntry_t *pEntry, archiveData_t *pOut, dmHeap_t *pHeap) const
+{
+	ZeroThat(pOut);
+	if (!pEntry)
+		return false;
+	pOut->Size = (size_t)pEntry->rawSize;
+
+	if (!(pEntry->flags & ARCHIVE_ENTRY_COMPRESSED)) {
+		pOut->pData = GetView(pEntry);
+		return true;
+	}
+
+	size_t allocSize = pOut->Size ? pOut->Size : 1;
+	pOut->pOwned = (pHeap) ? pHeap->Alloc(allocSize) : nullptr;
+	pOut->pOwner = (pOut->pOwned) ? pHeap : nullptr;
+	if (!pOut->pOwned)
+		pOut->pOwned = malloc(allocSize);
+	pOut->pData = pOut->pOwned;
+
+	if (!pOut->pOwned || !Decompress(pEntry, pOut->pOwned)) {
+		pOut->Release();
+		return false;
+	}
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool archiveBuilder_t::Add(const char *Path, const void *pData, size_t Size, uint Align, bool bCompress)
+{
+	if (Align == 0 || (Align & (Align - 1)))
+		return false;
+
+	pending_t pending = {};
+	pending.entry.hash = ArchiveHashPath(Path, TStrlen(Path));
+	pending.entry.rawSize = Size;
+	pending.align = (Align < alignof(uint32_t)) ? (uint)alignof(uint32_t) : Align;
+
+	uint32_t numBlocks = (uint32_t)((Size + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE);
+	if (bCompress && numBlocks) {
+		// Every block compresses into its own worst-case slot, then they're packed behind the table.
+		size_t slotSize = LzCompressBound(ARCHIVE_BLOCK_SIZE);
+		auto pScratch = (uint8 *)malloc(slotSize * numBlocks);
+		auto pSizes = (uint32_t *)malloc(sizeof(uint32_t) * numBlocks);
+
+		struct compress_t {
+			const uint8 *pSrc;
+			size_t size;
+			uint8 *pScratch;
+			size_t slotSize;
+			uint32_t *pSizes;
+		} work = { (const uint8 *)pData, Size, pScratch, slotSize, pSizes };
+
+		Jobs::ParallelFor(numBlocks, 1, [](uint Begin, uint End, void *p) {
+			auto pWork = (compress_t *)p;
+			for (uint i = Begin; i != End; ++i) {
+				size_t offset = (size_t)i * ARCHIVE_BLOCK_SIZE;
+				size_t rawSize = std::min<size_t>(ARCHIVE_BLOCK_SIZE, pWork->size - offset);
+				size_t packed = LzCompress(pWork->pSrc + offset, rawSize, pWork->pScratch + i * pWork->slotSize, pWork->slotSize);
+
+				// Blocks that don't shrink are kept raw so they decompress with a memcpy.
+				if (packed == 0 || packed >= rawSize) {
+					memcpy(pWork->pScratch + i * pWork->slotSize, pWork->pSrc + offset, rawSize);
+					pWork->pSizes[i] = (uint32_t)rawSize | ARCHIVE_BLOCK_RAW;
+				} else {
+					pWork->pSizes[i] = (uint32_t)packed;
+				}
+			}
+		}, &work);
+
+		size_t storedSize = sizeof(uint32_t) * numBlocks;
+		for (uint32_t i = 0; i != numBlocks; ++i)
+			storedSize += pSizes[i] & ~ARCHIVE_BLOCK_RAW;
+
+		if (storedSize < Size) {
+			auto pStored = (uint8 *)malloc(storedSize);
+			memcpy(pStored, pSizes, sizeof(uint32_t) * numBlocks);
+
+			size_t at = sizeof(uint32_t) * numBlocks;
+			for (uint32_t i = 0; i != numBlocks; ++i) {
+				size_t blockSize = pSizes[i] & ~ARCHIVE_BLOCK_RAW;
+				memcpy(pStored + at, pScratch + i * slotSize, blockSize);
+				at += blockSize;
+			}
+
+			pending.entry.storedSize = storedSize;
+			pending.entry.numBlocks = numBlocks;
+			pending.entry.flags = ARCHIVE_ENTRY_COMPRESSED;
+			pending.pData = pStored;
+		}
+
+		free(pSizes);
+		free(pScratch);
+	}
+
+	if (!pending.pData) {
+		pending.entry.storedSize = Size;
+		pending.pData = malloc(Size ? Size : 1);
+		memcpy(pending.pData, pData, Size);
+	}
+
+	m_Pending.Push(pending);
+	return true;
+}
+
+bool archiveBuilder_t::Write(const TCHAR *OutPath)
+{
+	std::sort(m_Pending.begin(), m_Pending.end(), [](const pending_t &Left, const pending_t &Right) {
+		return Left.entry.hash < Right.entry.hash;
+	});
+
+	uint numEntries = m_Pending.Getcount();
+	for (uint i = 1; i < numEntries; ++i) {
+		if (m_Pending[i - 1].entry.hash == m_Pending[i].entry.hash)
+			return false; // Same path added twice (or a 64-bit collision).
+	}
+
+	uint64_t offset = sizeof(archiveHeader_t);
+	for (auto &pending : m_Pending) {
+		offset = ALIGN(offset, (uint64_t)pending.align);
+		pending.entry.offset = offset;
+		offset += pending.entry.storedSize;
+	}
+
+	uint64_t tocOffset = ALIGN(offset, (uint64_t)alignof(archiveEntry_t));
+	uint64_t fileSize = tocOffset + (uint64_t)numEntries * sizeof(archiveEntry_t);
+
+	auto pFile = (uint8 *)calloc(1, (size_t)fileSize); // Zeroed so padding is deterministic.
+	if (!pFile)
+		return false;
+
+	auto pHeader = (archiveHeader_t *)pFile;
+	pHeader->magic = ARCHIVE_MAGIC;
+	pHeader->version = ARCHIVE_VERSION;
+	pHeader->numEntries = numEntries;
+	pHeader->tocOffset = tocOffset;
+	pHeader->fileSize = fileSize;
+
+	auto pToc = (archiveEntry_t *)(pFile + tocOffset);
+	for (uint i = 0; i != numEntries; ++i) {
+		auto &pending = m_Pending[i];
+		memcpy(pFile + pending.entry.offset, pending.pData, (size_t)pending.entry.storedSize);
+		pToc[i] = pending.entry;
+	}
+
+	bool bOk = WriteEntireFile(OutPath, pFile, (size_t)fileSize);
+	free(pFile);
+	return bOk;
+}
+
+void archiveBuilder_t::Release()
+{
+	for (auto &pending : m_Pending)
+		free(pending.pData);
+	m_Pending.Free();
+}
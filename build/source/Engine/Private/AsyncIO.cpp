@@ -0,0 +1,819 @@
+#include <pch.h>
+#include <Engine/FileIO.h>
+#include <Engine/Memory.h>
+#include <Engine/DebugLog.h>
+#include <Engine/Profiler.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(__linux__)
+#	define IO_HAS_URING
+#	include <linux/io_uring.h>
+#	include <sys/eventfd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <sys/uio.h>
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <poll.h>
+#	include <unistd.h>
+#endif
+
+#define IO_MAX_REQUESTS 4096 // Must be a power of two; the low bits of a handle are the slot index.
+#define IO_HANDLE_SLOT_BITS 12
+#define IO_MAX_THREADS 16
+#define IO_SMALL_READ KILOBYTES(64)
+#define IO_MAX_BATCH 16 // Small reads a pool thread takes per wake-up.
+#define IO_URING_DEPTH 256
+
+enum EIoState
+{
+	eIoStateFree,
+	eIoStateQueued,
+	eIoStateRunning,
+	eIoStateDone,
+};
+
+struct ioRequest_t
+{
+	TString<TCHAR> path;
+	uint64 offset;
+	size_t size;
+	void *pDst;
+	ioCallback_t pCallback;
+	void *pUser;
+	EIoPriority priority;
+
+	ioResult_t result;
+	std::atomic<uint32> handle; // 0 while the slot is free.
+	std::atomic<uint32> state;
+	ioRequest_t *pNext;
+
+#if defined(IO_HAS_URING)
+	int fd;
+	int numOpenOps;  // openat/statx still to complete before the read can go out.
+	bool bOpenFailed;
+	size_t done;
+	struct iovec iov;
+	struct statx stx;
+	TString<char> nativePath; // Read by the kernel until the open has completed.
+#endif
+};
+
+struct ioQueue_t
+{
+	ioRequest_t *pHead;
+	ioRequest_t *pTail;
+
+	inline bool IsEmpty() const { return pHead == nullptr; }
+
+	inline void Push(ioRequest_t *pReq)
+	{
+		pReq->pNext = nullptr;
+		if (pTail)
+			pTail->pNext = pReq;
+		else
+			pHead = pReq;
+		pTail = pReq;
+	}
+
+	inline ioRequest_t *Pop()
+	{
+		auto pReq = pHead;
+		if (pReq) {
+			pHead = pReq->pNext;
+			if (!pHead)
+				pTail = nullptr;
+		}
+		return pReq;
+	}
+};
+
+#if defined(IO_HAS_URING)
+struct ioRing_t
+{
+	int fd;
+	int wakeFd; // eventfd polled by the ring so new requests interrupt a blocking wait.
+
+	// The kernel's fields are 32-bit everywhere; 'uint32' is long-sized on some platforms.
+	uint32_t *pSqHead, *pSqTail, *pSqMask, *pSqArray;
+	uint32_t *pCqHead, *pCqTail, *pCqMask;
+	io_uring_sqe *pSqes;
+	io_uring_cqe *pCqes;
+
+	void *pSqRing, *pCqRing;
+	size_t sqRingSize, cqRingSize, sqesSize;
+	uint32_t numEntries;
+	uint32_t numPending; // SQEs written but not yet handed to the kernel.
+};
+#endif
+
+struct ioSystem_t
+{
+	ioRequest_t *pRequests;
+	ioRequest_t *pFreeList;
+	uint32 generation;
+
+	std::mutex lock;
+	std::condition_variable workCv;  // Pool threads / ring driver waiting for requests.
+	std::condition_variable doneCv;  // IO::Wait() callers and Read() waiting for a free slot.
+	ioQueue_t queues[eIoPriorityCount];
+	uint numQueued;
+	bool bQuit;
+
+	dmHeap_t bufferHeap;
+
+	std::thread *pThreads;
+	uint numThreads;
+
+#if defined(IO_HAS_URING)
+	bool bUring;
+	ioRing_t ring;
+#endif
+};
+
+static ioSystem_t *gIO = nullptr;
+static thread_local bool tIoThread = false; // Pool workers and the ring driver, where callbacks run.
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static ioRequest_t *PopHighest()
+{
+	for (int i = eIoPriorityCount - 1; i >= 0; --i) {
+		if (!gIO->queues[i].IsEmpty()) {
+			--gIO->numQueued;
+			return gIO->queues[i].Pop();
+		}
+	}
+	return nullptr;
+}
+
+static ioRequest_t *PeekHighest()
+{
+	for (int i = eIoPriorityCount - 1; i >= 0; --i) {
+		if (!gIO->queues[i].IsEmpty())
+			return gIO->queues[i].pHead;
+	}
+	return nullptr;
+}
+
+static inline bool IsSmall(const ioRequest_t *pReq)
+{
+	return pReq->size != 0 && pReq->size <= IO_SMALL_READ;
+}
+
+// Caller holds the lock.
+static void FreeSlot(ioRequest_t *pReq)
+{
+	pReq->path.Free();
+	pReq->handle.store(0, std::memory_order_relaxed);
+	pReq->state.store(eIoStateFree, std::memory_order_relaxed);
+	pReq->pNext = gIO->pFreeList;
+	gIO->pFreeList = pReq;
+}
+
+static ioRequest_t *LookUp(ioHandle_t Handle)
+{
+	if (!gIO || Handle == 0)
+		return nullptr;
+
+	auto pReq = &gIO->pRequests[Handle & (IO_MAX_REQUESTS - 1)];
+	return (pReq->handle.load(std::memory_order_acquire) == Handle) ? pReq : nullptr;
+}
+
+// Resolves a 0 size and finds somewhere to put the data. Returns false if there's nothing to read into.
+static bool PrepareBuffer(ioRequest_t *pReq, uint64 FileSize)
+{
+	if (pReq->offset > FileSize)
+		return false;
+	if (pReq->size == 0 || (pReq->offset + pReq->size) > FileSize)
+		pReq->size = (size_t)(FileSize - pReq->offset);
+
+	auto pBlob = &pReq->result.Blob;
+	if (pReq->pDst) {
+		pBlob->pBuffer = pReq->pDst;
+		pBlob->pOwner = nullptr;
+		return true;
+	}
+
+	// Zero-length reads still hand back a buffer so callers don't need to special-case them.
+	size_t allocSize = pReq->size ? pReq->size : 1;
+	pBlob->pBuffer = gIO->bufferHeap.Alloc(allocSize);
+	pBlob->pOwner = &gIO->bufferHeap;
+	if (!pBlob->pBuffer) {
+		pBlob->pBuffer = malloc(allocSize);
+		pBlob->pOwner = nullptr;
+	}
+	return pBlob->pBuffer != nullptr;
+}
+
+// Publishes the result. Callback requests are consumed here; the rest wait for IO::Wait().
+static void Complete(ioRequest_t *pReq, bool bSuccess)
+{
+	pReq->result.bSuccess = bSuccess;
+	pReq->result.pUser = pReq->pUser;
+	if (bSuccess)
+		PROFILE_COUNTER_ADD("IO bytes read", pReq->result.Blob.Size);
+	if (!bSuccess && pReq->result.Blob.pBuffer != pReq->pDst)
+		ReleaseFileBlob(&pReq->result.Blob);
+
+	if (pReq->pCallback) {
+		pReq->pCallback(&pReq->result);
+
+		std::lock_guard<std::mutex> lock(gIO->lock);
+		FreeSlot(pReq);
+	} else {
+		std::lock_guard<std::mutex> lock(gIO->lock);
+		pReq->state.store(eIoStateDone, std::memory_order_release);
+	}
+	gIO->doneCv.notify_all();
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Only whole-file reads need the size up front; a sized read that hits EOF just comes back short.
+static void ServiceBlocking(ioRequest_t *pReq)
+{
+	PROFILE_ZONE("IO::Read");
+
+	uint64 fileSize = (uint64)-1;
+	if ((pReq->size == 0 && !QueryFileSize(pReq->path, &fileSize)) || !PrepareBuffer(pReq, fileSize)) {
+		Complete(pReq, false);
+		return;
+	}
+
+	size_t read = 0;
+	bool bOk = ReadFileRange(pReq->path, pReq->offset, pReq->size, pReq->result.Blob.pBuffer, &read);
+	pReq->result.Blob.Size = read;
+	Complete(pReq, bOk);
+}
+
+// Takes the most urgent request, then as many small ones as fit in a batch so a burst of tiny reads
+// doesn't cost a wake-up each.
+static void PoolWorkerMain()
+{
+	ioRequest_t *batch[IO_MAX_BATCH];
+	PROFILE_THREAD("IO worker");
+	tIoThread = true;
+
+	for (;;) {
+		uint num = 0;
+		{
+			std::unique_lock<std::mutex> lock(gIO->lock);
+			gIO->workCv.wait(lock, [] { return gIO->numQueued != 0 || gIO->bQuit; });
+			if (gIO->numQueued == 0)
+				return;
+
+			batch[num++] = PopHighest();
+			if (IsSmall(batch[0])) {
+				for (auto pNext = PeekHighest(); pNext && IsSmall(pNext) && num != IO_MAX_BATCH; pNext = PeekHighest())
+					batch[num++] = PopHighest();
+			}
+			for (uint i = 0; i != num; ++i)
+				batch[i]->state.store(eIoStateRunning, std::memory_order_relaxed);
+		}
+
+		for (uint i = 0; i != num; ++i)
+			ServiceBlocking(batch[i]);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// io_uring without liburing: the rings are mapped by hand and driven by a single thread. Everything queued
+// since the last wake-up goes to the kernel in one io_uring_enter(), which also waits for the first completion.
+// A request is an openat (with a linked statx when the size has to come from the file), then reads until it's
+// all in. Nothing on the driver thread blocks on the file system except close().
+#if defined(IO_HAS_URING)
+#define IO_WAKE_USER_DATA 0ull
+#define IO_OP_READ 0 // Low bits of a request's user_data say which of its operations completed.
+#define IO_OP_OPEN 1
+#define IO_OP_STAT 2
+#define IO_OP_MASK 3ull
+
+static inline uint64 RingUserData(ioRequest_t *pReq, uint Op)
+{
+	return (uint64)(uintptr_t)pReq | Op;
+}
+
+// openat and statx need 5.6, which is also when the probe arrived; older kernels use the pool.
+static bool RingSupportsOps(int Fd)
+{
+	static const uint8 s_ops[] = { IORING_OP_READV, IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_POLL_ADD };
+	const uint numProbeOps = 256;
+
+	alignas(io_uring_probe) uint8 buffer[sizeof(io_uring_probe) + numProbeOps * sizeof(io_uring_probe_op)] = {};
+	auto pProbe = (io_uring_probe *)buffer;
+	if (syscall(__NR_io_uring_register, Fd, IORING_REGISTER_PROBE, pProbe, numProbeOps) < 0)
+		return false;
+
+	for (auto op : s_ops) {
+		if (op > pProbe->last_op || !(pProbe->ops[op].flags & IO_URING_OP_SUPPORTED))
+			return false;
+	}
+	return true;
+}
+
+static bool RingCreate(ioRing_t *pRing, uint32 Entries)
+{
+	memset(pRing, 0, sizeof(*pRing));
+	pRing->fd = -1;
+	pRing->wakeFd = -1;
+
+	io_uring_params params = {};
+	pRing->fd = (int)syscall(__NR_io_uring_setup, Entries, &params);
+	if (pRing->fd < 0 || !RingSupportsOps(pRing->fd))
+		return false;
+
+	pRing->numEntries = params.sq_entries;
+	pRing->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	pRing->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	pRing->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	pRing->pSqRing = mmap(nullptr, pRing->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQ_RING);
+	pRing->pCqRing = mmap(nullptr, pRing->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_CQ_RING);
+	pRing->pSqes = (io_uring_sqe *)mmap(nullptr, pRing->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQES);
+	if (pRing->pSqRing == MAP_FAILED || pRing->pCqRing == MAP_FAILED || (void *)pRing->pSqes == MAP_FAILED)
+		return false;
+
+	auto sq = (uint8 *)pRing->pSqRing;
+	pRing->pSqHead = (uint32_t *)(sq + params.sq_off.head);
+	pRing->pSqTail = (uint32_t *)(sq + params.sq_off.tail);
+	pRing->pSqMask = (uint32_t *)(sq + params.sq_off.ring_mask);
+	pRing->pSqArray = (uint32_t *)(sq + params.sq_off.array);
+
+	auto cq = (uint8 *)pRing->pCqRing;
+	pRing->pCqHead = (uint32_t *)(cq + params.cq_off.head);
+	pRing->pCqTail = (uint32_t *)(cq + params.cq_off.tail);
+	pRing->pCqMask = (uint32_t *)(cq + params.cq_off.ring_mask);
+	pRing->pCqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	pRing->wakeFd = eventfd(0, EFD_CLOEXEC);
+	return pRing->wakeFd >= 0;
+}
+
+static void RingDestroy(ioRing_t *pRing)
+{
+	if (pRing->pSqes && (void *)pRing->pSqes != MAP_FAILED)
+		munmap(pRing->pSqes, pRing->sqesSize);
+	if (pRing->pCqRing && pRing->pCqRing != MAP_FAILED)
+		munmap(pRing->pCqRing, pRing->cqRingSize);
+	if (pRing->pSqRing && pRing->pSqRing != MAP_FAILED)
+		munmap(pRing->pSqRing, pRing->sqRingSize);
+	if (pRing->wakeFd >= 0)
+		close(pRing->wakeFd);
+	if (pRing->fd >= 0)
+		close(pRing->fd);
+	memset(pRing, 0, sizeof(*pRing));
+}
+
+static io_uring_sqe *RingGetSqe(ioRing_t *pRing)
+{
+	auto tail = *pRing->pSqTail + pRing->numPending;
+	auto head = __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+	if ((tail - head) >= pRing->numEntries)
+		return nullptr;
+
+	auto index = tail & *pRing->pSqMask;
+	auto pSqe = &pRing->pSqes[index];
+	memset(pSqe, 0, sizeof(*pSqe));
+	pRing->pSqArray[index] = index;
+	++pRing->numPending;
+	return pSqe;
+}
+
+static int RingEnter(ioRing_t *pRing, uint32_t MinComplete)
+{
+	auto toSubmit = pRing->numPending;
+	__atomic_store_n(pRing->pSqTail, *pRing->pSqTail + toSubmit, __ATOMIC_RELEASE);
+	pRing->numPending = 0;
+
+	for (;;) {
+		int ret = (int)syscall(__NR_io_uring_enter, pRing->fd, toSubmit, MinComplete, MinComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+		if (ret >= 0 || errno != EINTR)
+			return ret;
+		toSubmit = 0; // Anything consumed before the signal has already been taken.
+	}
+}
+
+static void RingArmWake(ioRing_t *pRing)
+{
+	auto pSqe = RingGetSqe(pRing);
+	pSqe->opcode = IORING_OP_POLL_ADD;
+	pSqe->fd = pRing->wakeFd;
+	pSqe->poll_events = POLLIN;
+	pSqe->user_data = IO_WAKE_USER_DATA;
+}
+
+static void RingPrepRead(ioRing_t *pRing, ioRequest_t *pReq)
+{
+	pReq->iov.iov_base = (uint8 *)pReq->result.Blob.pBuffer + pReq->done;
+	pReq->iov.iov_len = pReq->size - pReq->done;
+
+	auto pSqe = RingGetSqe(pRing);
+	pSqe->opcode = IORING_OP_READV;
+	pSqe->fd = pReq->fd;
+	pSqe->off = pReq->offset + pReq->done;
+	pSqe->addr = (uint64)(uintptr_t)&pReq->iov;
+	pSqe->len = 1;
+	pSqe->user_data = RingUserData(pReq, IO_OP_READ);
+}
+
+static void RingFinish(ioRequest_t *pReq, bool bSuccess)
+{
+	if (pReq->fd >= 0)
+		close(pReq->fd);
+	pReq->fd = -1;
+	pReq->result.Blob.Size = pReq->done;
+	Complete(pReq, bSuccess);
+}
+
+// Queues the openat, and the statx of a whole-file read behind it. Linked, so a failed open cancels the statx.
+static void RingPrepOpen(ioRing_t *pRing, ioRequest_t *pReq)
+{
+#if defined(MBCS)
+	pReq->nativePath.Set(pReq->path);
+#else
+	pReq->nativePath.Resize(0); // Kept from the slot's last request; the conversion appends.
+	TWideToUtf8(pReq->path, pReq->path.Length(), &pReq->nativePath);
+#endif
+	for (uint i = 0; i != pReq->nativePath.Length(); ++i) {
+		if (pReq->nativePath[i] == '\\')
+			pReq->nativePath[i] = '/';
+	}
+
+	pReq->fd = -1;
+	pReq->done = 0;
+	pReq->bOpenFailed = false;
+	pReq->numOpenOps = (pReq->size == 0) ? 2 : 1;
+
+	auto pSqe = RingGetSqe(pRing);
+	pSqe->opcode = IORING_OP_OPENAT;
+	pSqe->fd = AT_FDCWD;
+	pSqe->addr = (uint64)(uintptr_t)(const char *)pReq->nativePath;
+	pSqe->open_flags = O_RDONLY | O_CLOEXEC;
+	pSqe->user_data = RingUserData(pReq, IO_OP_OPEN);
+	if (pReq->numOpenOps == 1)
+		return;
+
+	pSqe->flags |= IOSQE_IO_LINK;
+	pSqe = RingGetSqe(pRing);
+	pSqe->opcode = IORING_OP_STATX;
+	pSqe->fd = AT_FDCWD;
+	pSqe->addr = (uint64)(uintptr_t)(const char *)pReq->nativePath;
+	pSqe->len = STATX_SIZE;
+	pSqe->off = (uint64)(uintptr_t)&pReq->stx;
+	pSqe->user_data = RingUserData(pReq, IO_OP_STAT);
+}
+
+// Once the open (and statx) are in, sizes the read and queues it. Returns true if it did; empty and failed
+// requests are completed here instead.
+static bool RingOpened(ioRing_t *pRing, ioRequest_t *pReq, uint Op, int Res)
+{
+	if (Res < 0)
+		pReq->bOpenFailed = true;
+	else if (Op == IO_OP_OPEN)
+		pReq->fd = Res;
+	if (--pReq->numOpenOps != 0)
+		return false;
+
+	// As in ServiceBlocking(), only whole-file reads need the size.
+	uint64 fileSize = (pReq->size == 0) ? (uint64)pReq->stx.stx_size : (uint64)-1;
+	if (pReq->bOpenFailed || !PrepareBuffer(pReq, fileSize)) {
+		RingFinish(pReq, false);
+		return false;
+	}
+	if (pReq->size == 0) {
+		RingFinish(pReq, true);
+		return false;
+	}
+
+	RingPrepRead(pRing, pReq);
+	return true;
+}
+
+static void RingDriverMain()
+{
+	auto pRing = &gIO->ring;
+	uint32_t inFlight = 0; // Operations, not requests.
+	const uint32_t maxInFlight = pRing->numEntries - 1; // One entry stays reserved for the wake-up poll.
+	PROFILE_THREAD("IO ring");
+	tIoThread = true;
+
+	RingArmWake(pRing);
+
+	for (;;) {
+		bool bQuit;
+		{
+			// A request takes at most two operations at a time: openat + statx, then one read.
+			std::lock_guard<std::mutex> lock(gIO->lock);
+			while (inFlight + 2 <= maxInFlight) {
+				auto pReq = PopHighest();
+				if (!pReq)
+					break;
+				pReq->state.store(eIoStateRunning, std::memory_order_relaxed);
+				RingPrepOpen(pRing, pReq);
+				inFlight += pReq->numOpenOps;
+			}
+			bQuit = gIO->bQuit && gIO->numQueued == 0;
+		}
+
+		if (bQuit && inFlight == 0)
+			break;
+
+		if (RingEnter(pRing, 1) < 0) {
+			continue;
+		}
+
+		auto head = *pRing->pCqHead;
+		auto tail = __atomic_load_n(pRing->pCqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			auto pCqe = &pRing->pCqes[head & *pRing->pCqMask];
+			if (pCqe->user_data == IO_WAKE_USER_DATA) {
+				uint64 value;
+				while (read(pRing->wakeFd, &value, sizeof(value)) < 0 && errno == EINTR) {}
+				RingArmWake(pRing);
+				continue;
+			}
+
+			auto pReq = (ioRequest_t *)(uintptr_t)(pCqe->user_data & ~IO_OP_MASK);
+			auto op = (uint)(pCqe->user_data & IO_OP_MASK);
+			--inFlight;
+
+			if (op != IO_OP_READ) {
+				if (RingOpened(pRing, pReq, op, pCqe->res))
+					++inFlight;
+			} else if (pCqe->res == -EINTR || pCqe->res == -EAGAIN) {
+				RingPrepRead(pRing, pReq);
+				++inFlight;
+			} else if (pCqe->res < 0) {
+				RingFinish(pReq, false);
+			} else {
+				pReq->done += (size_t)pCqe->res;
+				if (pCqe->res != 0 && pReq->done < pReq->size) {
+					RingPrepRead(pRing, pReq); // Short read; go again for the rest.
+					++inFlight;
+				} else {
+					RingFinish(pReq, true); // res == 0 is EOF; the blob just comes back short.
+				}
+			}
+		}
+		__atomic_store_n(pRing->pCqHead, head, __ATOMIC_RELEASE);
+	}
+}
+
+static void RingWake()
+{
+	uint64 one = 1;
+	while (write(gIO->ring.wakeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool IO::Initialize(uint NumThreads, size_t BufferHeapSize)
+{
+	if (gIO)
+		return true;
+
+	if (NumThreads == 0)
+		NumThreads = 1;
+	if (NumThreads > IO_MAX_THREADS)
+		NumThreads = IO_MAX_THREADS;
+
+	gIO = new ioSystem_t;
+	gIO->pRequests = new ioRequest_t[IO_MAX_REQUESTS];
+	gIO->pFreeList = nullptr;
+	for (int i = IO_MAX_REQUESTS - 1; i >= 0; --i) {
+		auto pReq = &gIO->pRequests[i];
+		pReq->handle.store(0);
+		pReq->state.store(eIoStateFree);
+		pReq->pNext = gIO->pFreeList;
+		gIO->pFreeList = pReq;
+	}
+	gIO->generation = 0;
+	memset(gIO->queues, 0, sizeof(gIO->queues));
+	gIO->numQueued = 0;
+	gIO->bQuit = false;
+
+	if (!gIO->bufferHeap.Initialize(BufferHeapSize, DM_HEAP_THREADSAFE)) {
+		delete[] gIO->pRequests;
+		delete gIO;
+		gIO = nullptr;
+		return false;
+	}
+	PROFILE_WATCH_HEAP("IO heap", &gIO->bufferHeap);
+
+#if defined(IO_HAS_URING)
+	gIO->bUring = RingCreate(&gIO->ring, IO_URING_DEPTH);
+	if (gIO->bUring) {
+		gIO->numThreads = 1;
+		gIO->pThreads = new std::thread[1];
+		gIO->pThreads[0] = std::thread(RingDriverMain);
+		return true;
+	}
+	RingDestroy(&gIO->ring); // Kernel too old or io_uring blocked; use the pool.
+#endif
+
+	gIO->numThreads = NumThreads;
+	gIO->pThreads = new std::thread[NumThreads];
+	for (uint i = 0; i != NumThreads; ++i) {
+		gIO->pThreads[i] = std::thread(PoolWorkerMain);
+	}
+
+	return true;
+}
+
+// Everything already queued is still read (and its callback run) before this returns.
+void IO::Release()
+{
+	if (!gIO)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(gIO->lock);
+		gIO->bQuit = true;
+	}
+	gIO->workCv.notify_all();
+#if defined(IO_HAS_URING)
+	if (gIO->bUring)
+		RingWake();
+#endif
+
+	for (uint i = 0; i != gIO->numThreads; ++i) {
+		gIO->pThreads[i].join();
+	}
+
+#if defined(IO_HAS_URING)
+	if (gIO->bUring)
+		RingDestroy(&gIO->ring);
+#endif
+
+	// Completed reads nobody waited for still own heap memory.
+	for (uint i = 0; i != IO_MAX_REQUESTS; ++i) {
+		auto pReq = &gIO->pRequests[i];
+		if (pReq->state.load() == eIoStateDone)
+			ReleaseFileBlob(&pReq->result.Blob);
+	}
+
+	PROFILE_UNWATCH(&gIO->bufferHeap);
+	gIO->bufferHeap.Release();
+	delete[] gIO->pThreads;
+	delete[] gIO->pRequests;
+	delete gIO;
+	gIO = nullptr;
+}
+
+// Caller holds the lock. Whether some slot will free itself or become collectable without anyone submitting.
+static bool AnyInFlight()
+{
+	for (uint i = 0; i != IO_MAX_REQUESTS; ++i) {
+		auto state = gIO->pRequests[i].state.load(std::memory_order_relaxed);
+		if (state == eIoStateQueued || state == eIoStateRunning)
+			return true;
+	}
+	return false;
+}
+
+// A request that was never queued: no handle, and its callback (if any) hears about it straight away.
+static void Reject(const ioReadDesc_t &Desc)
+{
+	if (Desc.pCallback) {
+		ioResult_t result = {};
+		result.pUser = Desc.pUser;
+		Desc.pCallback(&result);
+	}
+}
+
+void IO::ReadBatch(const ioReadDesc_t *pDescs, uint Num, ioHandle_t *pOutHandles)
+{
+	VERIFY(gIO);
+
+	uint numRejected = 0;
+	uint numSubmitted = Num;
+	{
+		std::unique_lock<std::mutex> lock(gIO->lock);
+		for (uint i = 0; i != Num; ++i) {
+			auto &desc = pDescs[i];
+
+			// 'pDst' can't be sized from the file; a whole-file read into it would overrun.
+			if (desc.pDst && desc.Size == 0) {
+				if (pOutHandles)
+					pOutHandles[i] = 0;
+				++numRejected;
+				continue;
+			}
+
+			// Out of slots: wait for one while reads are still running. Once every slot holds a finished,
+			// uncollected result, only Wait() can free one and it may be this thread holding the handles, so
+			// fail the rest of the batch instead. A callback can't wait at all: the reads it would wait on are
+			// completed by this very thread.
+			if (!gIO->pFreeList) {
+				if (!tIoThread) {
+					gIO->workCv.notify_all();
+					gIO->doneCv.wait(lock, [] { return gIO->pFreeList != nullptr || !AnyInFlight(); });
+				}
+				if (!gIO->pFreeList) {
+					for (uint j = i; j != Num; ++j) {
+						if (pOutHandles)
+							pOutHandles[j] = 0;
+					}
+					numSubmitted = i;
+					break;
+				}
+			}
+
+			auto pReq = gIO->pFreeList;
+			gIO->pFreeList = pReq->pNext;
+
+			gIO->generation = (gIO->generation + 1) & ((1u << (32 - IO_HANDLE_SLOT_BITS)) - 1);
+			if (gIO->generation == 0)
+				gIO->generation = 1;
+			auto handle = (gIO->generation << IO_HANDLE_SLOT_BITS) | (uint32)(pReq - gIO->pRequests);
+
+			pReq->path.Set(desc.Path);
+			pReq->offset = desc.Offset;
+			pReq->size = desc.Size;
+			pReq->pDst = desc.pDst;
+			pReq->pCallback = desc.pCallback;
+			pReq->pUser = desc.pUser;
+			pReq->priority = (desc.Priority < eIoPriorityCount) ? desc.Priority : eIoPriorityNormal;
+			memset(&pReq->result, 0, sizeof(pReq->result));
+			pReq->state.store(eIoStateQueued, std::memory_order_relaxed);
+			pReq->handle.store(handle, std::memory_order_release);
+
+			gIO->queues[pReq->priority].Push(pReq);
+			++gIO->numQueued;
+
+			if (pOutHandles)
+				pOutHandles[i] = (desc.pCallback) ? 0 : handle;
+		}
+	}
+
+	// Outside the lock; callbacks may submit more reads.
+	for (uint i = 0; i != numSubmitted && numRejected; ++i) {
+		if (pDescs[i].pDst && pDescs[i].Size == 0) {
+			Reject(pDescs[i]);
+			--numRejected;
+		}
+	}
+	for (uint i = numSubmitted; i != Num; ++i)
+		Reject(pDescs[i]);
+
+#if defined(IO_HAS_URING)
+	if (gIO->bUring) {
+		RingWake();
+		return;
+	}
+#endif
+	if (Num > 1)
+		gIO->workCv.notify_all();
+	else
+		gIO->workCv.notify_one();
+}
+
+ioHandle_t IO::Read(const ioReadDesc_t &Desc)
+{
+	ioHandle_t handle = 0;
+	ReadBatch(&Desc, 1, &handle);
+	return handle;
+}
+
+bool IO::IsDone(ioHandle_t Handle)
+{
+	auto pReq = LookUp(Handle);
+	return !pReq || pReq->state.load(std::memory_order_acquire) == eIoStateDone;
+}
+
+bool IO::Wait(ioHandle_t Handle, fileBlob_t *pOut)
+{
+	ZeroThat(pOut);
+	if (!gIO || !Handle)
+		return false;
+
+	std::unique_lock<std::mutex> lock(gIO->lock);
+	auto pReq = LookUp(Handle);
+	if (!pReq || pReq->pCallback)
+		return false;
+
+	gIO->doneCv.wait(lock, [pReq] { return pReq->state.load(std::memory_order_relaxed) == eIoStateDone; });
+
+	*pOut = pReq->result.Blob;
+	bool bSuccess = pReq->result.bSuccess;
+	FreeSlot(pReq);
+	gIO->doneCv.notify_all(); // A ReadBatch() may be waiting on the slot.
+	return bSuccess;
+}
+
+bool IO::IsUsingIoUring()
+{
+#if defined(IO_HAS_URING)
+	return gIO && gIO->bUring;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,182 @@
+#include <pch.h>
+#include <Engine/Compression.h>
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5 // The format requires the last 5 bytes to be literals...
+#define LZ_MATCH_LIMIT 12  // ...and the last match to start at least 12 bytes from the end.
+#define LZ_MAX_OFFSET 65535
+
+static inline uint32_t Read32(const uint8 *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t HashSeq(uint32_t Seq)
+{
+	return (Seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Writes a length that didn't fit in its 4-bit token field as a run of 255s plus a remainder.
+static inline uint8 *PutLength(uint8 *op, const uint8 *oend, size_t Length)
+{
+	while (Length >= 255) {
+		if (op == oend)
+			return nullptr;
+		*op++ = 255;
+		Length -= 255;
+	}
+	if (op == oend)
+		return nullptr;
+	*op++ = (uint8)Length;
+	return op;
+}
+
+static uint8 *PutSequence(uint8 *op, const uint8 *oend, const uint8 *pLiterals, size_t NumLiterals, size_t Offset, size_t MatchLength)
+{
+	if (op == oend)
+		return nullptr;
+
+	uint8 *pToken = op++;
+	*pToken = (uint8)(((NumLiterals >= 15) ? 15 : NumLiterals) << 4);
+	if (NumLiterals >= 15 && !(op = PutLength(op, oend, NumLiterals - 15)))
+		return nullptr;
+
+	if ((size_t)(oend - op) < NumLiterals)
+		return nullptr;
+	memcpy(op, pLiterals, NumLiterals);
+	op += NumLiterals;
+
+	if (MatchLength == 0)
+		return op; // Last sequence: literals only.
+
+	if ((oend - op) < 2)
+		return nullptr;
+	*op++ = (uint8)(Offset & 0xFF);
+	*op++ = (uint8)(Offset >> 8);
+
+	size_t ml = MatchLength - LZ_MIN_MATCH;
+	*pToken |= (uint8)((ml >= 15) ? 15 : ml);
+	if (ml >= 15 && !(op = PutLength(op, oend, ml - 15)))
+		return nullptr;
+	return op;
+}
+
+size_t LzCompress(const void *pSrc, size_t SrcSize, void *pDst, size_t DstCapacity)
+{
+	auto src = (const uint8 *)pSrc;
+	auto ip = src;
+	auto anchor = src;
+	auto iend = src + SrcSize;
+	auto op = (uint8 *)pDst;
+	auto oend = op + DstCapacity;
+
+	if (SrcSize > LZ_MATCH_LIMIT) {
+		uint32_t table[1 << LZ_HASH_BITS] = {}; // Position of the last sequence with each hash.
+		auto mflimit = iend - LZ_MATCH_LIMIT;
+		auto matchlimit = iend - LZ_LAST_LITERALS;
+
+		while (ip < mflimit) {
+			auto seq = Read32(ip);
+			auto h = HashSeq(seq);
+			auto ref = src + table[h];
+			table[h] = (uint32_t)(ip - src);
+
+			if (ref >= ip || (size_t)(ip - ref) > LZ_MAX_OFFSET || Read32(ref) != seq) {
+				++ip;
+				continue;
+			}
+
+			while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+				--ip;
+				--ref;
+			}
+
+			auto mp = ip + LZ_MIN_MATCH;
+			auto rp = ref + LZ_MIN_MATCH;
+			while (mp < matchlimit && *mp == *rp) {
+				++mp;
+				++rp;
+			}
+
+			op = PutSequence(op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(mp - ip));
+			if (!op)
+				return 0;
+
+			ip = mp;
+			anchor = ip;
+			if (ip < mflimit)
+				table[HashSeq(Read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+		}
+	}
+
+	op = PutSequence(op, oend, anchor, (size_t)(iend - anchor), 0, 0);
+	return (op) ? (size_t)(op - (uint8 *)pDst) : 0;
+}
+
+bool LzDecompress(const void *pSrc, size_t SrcSize, void *pDst, size_t DstSize)
+{
+	auto ip = (const uint8 *)pSrc;
+	auto iend = ip + SrcSize;
+	auto dst = (uint8 *)pDst;
+	auto op = dst;
+	auto oend = dst + DstSize;
+
+	while (ip < iend) {
+		uint token = *ip++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15) {
+			uint8 b;
+			do {
+				if (ip == iend)
+					return false;
+				b = *ip++;
+				numLiterals += b;
+			} while (b == 255);
+		}
+		if ((size_t)(iend - ip) < numLiterals || (size_t)(oend - op) < numLiterals)
+			return false;
+		memcpy(op, ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+
+		if (ip == iend)
+			break; // The last sequence has no match.
+
+		if ((iend - ip) < 2)
+			return false;
+		size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15) {
+			uint8 b;
+			do {
+				if (ip == iend)
+					return false;
+				b = *ip++;
+				matchLength += b;
+			} while (b == 255);
+		}
+		matchLength += LZ_MIN_MATCH;
+		if ((size_t)(oend - op) < matchLength)
+			return false;
+
+		const uint8 *ref = op - offset;
+		if (offset >= matchLength) {
+			memcpy(op, ref, matchLength);
+			op += matchLength;
+		} else {
+			// Overlapping match: a short offset repeats the last 'offset' bytes, so it has to go forwards byte by byte.
+			for (size_t i = 0; i != matchLength; ++i)
+				*op++ = ref[i];
+		}
+	}
+
+	return op == oend;
+}
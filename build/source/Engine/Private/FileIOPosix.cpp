@@ -0,0 +1,262 @@
+#include <pch.h>
+#include <Engine/FileIO.h>
+#include <Engine/Memory.h>
+#include <Engine/Profiler.h>
+
+#if !defined(PLATFORM_WIN64)
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Engine paths are TCHAR and use '\\'; POSIX wants UTF-8 and '/'.
+static void ToNativePath(const TCHAR *Path, TString<char> *pOut)
+{
+#if defined(MBCS)
+	pOut->Set(Path);
+#else
+	TWideToUtf8(Path, TStrlen(Path), pOut);
+#endif
+	for (uint i = 0; i != pOut->Length(); ++i) {
+		if ((*pOut)[i] == '\\')
+			(*pOut)[i] = '/';
+	}
+}
+
+static int OpenForRead(const TCHAR *Path)
+{
+	TString<char> native;
+	ToNativePath(Path, &native);
+	return ::open(native, O_RDONLY | O_CLOEXEC);
+}
+
+// pread() may come back short; keep going until 'Size' bytes or EOF.
+static bool PreadAll(int Fd, uint64 Offset, size_t Size, void *pDst, size_t *pRead)
+{
+	*pRead = 0;
+	while (*pRead < Size) {
+		ssize_t n = ::pread(Fd, (uint8 *)pDst + *pRead, Size - *pRead, (off_t)(Offset + *pRead));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (n == 0)
+			break;
+		*pRead += (size_t)n;
+	}
+	return true;
+}
+
+bool ReadEntireFile(const TCHAR *Path, fileBlob_t *pBlob)
+{
+	PROFILE_ZONE("ReadEntireFile");
+	ZeroThat(pBlob);
+
+	int fd = OpenForRead(Path);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	pBlob->Size = (size_t)st.st_size;
+	pBlob->pBuffer = malloc(pBlob->Size ? pBlob->Size : 1);
+
+	size_t read = 0;
+	bool bOk = pBlob->pBuffer && PreadAll(fd, 0, pBlob->Size, pBlob->pBuffer, &read) && read == pBlob->Size;
+	::close(fd);
+
+	if (bOk)
+		PROFILE_COUNTER_ADD("IO bytes read", read);
+	else
+		ReleaseFileBlob(pBlob);
+	return bOk;
+}
+
+void ReleaseFileBlob(fileBlob_t *pBlob)
+{
+	if (pBlob->pBuffer) {
+		if (pBlob->pOwner)
+			pBlob->pOwner->Free(pBlob->pBuffer);
+		else
+			free(pBlob->pBuffer);
+	}
+	ZeroThat(pBlob);
+}
+
+bool ReadFileRange(const TCHAR *Path, uint64 Offset, size_t Size, void *pDst, size_t *pRead)
+{
+	*pRead = 0;
+
+	int fd = OpenForRead(Path);
+	if (fd < 0)
+		return false;
+
+	bool bOk = PreadAll(fd, Offset, Size, pDst, pRead);
+	::close(fd);
+	return bOk;
+}
+
+bool QueryFileSize(const TCHAR *Path, uint64 *pSize)
+{
+	TString<char> native;
+	ToNativePath(Path, &native);
+
+	struct stat st;
+	if (::stat(native, &st) != 0)
+		return false;
+	*pSize = (uint64)st.st_size;
+	return true;
+}
+
+bool QueryFileWriteTime(const TCHAR *Path, uint64 *pTime)
+{
+	TString<char> native;
+	ToNativePath(Path, &native);
+
+	struct stat st;
+	if (::stat(native, &st) != 0)
+		return false;
+	*pTime = (uint64)st.st_mtim.tv_sec * 1000000000ull + (uint64)st.st_mtim.tv_nsec;
+	return true;
+}
+
+bool WriteEntireFile(const TCHAR *Path, const void *pData, size_t Size)
+{
+	TString<char> native;
+	ToNativePath(Path, &native);
+
+	int fd = ::open(native, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+
+	size_t written = 0;
+	while (written < Size) {
+		ssize_t n = ::write(fd, (const uint8 *)pData + written, Size - written);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		written += (size_t)n;
+	}
+
+	::close(fd);
+	return written == Size;
+}
+
+bool MapFile(const TCHAR *Path, mappedFile_t *pFile)
+{
+	ZeroThat(pFile);
+
+	int fd = OpenForRead(Path);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *pView = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // The mapping keeps its own reference to the file.
+	if (pView == MAP_FAILED)
+		return false;
+
+	pFile->Size = (size_t)st.st_size;
+	pFile->pView = pView;
+	return true;
+}
+
+void UnmapFile(mappedFile_t *pFile)
+{
+	if (pFile->pView)
+		::munmap(pFile->pView, pFile->Size);
+	ZeroThat(pFile);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static size_t GetLastWrite(const TCHAR *Path)
+{
+	TString<char> native;
+	ToNativePath(Path, &native);
+
+	struct stat st;
+	if (::stat(native, &st) != 0)
+		return 0;
+	return (size_t)st.st_mtim.tv_sec * 1000000000ull + (size_t)st.st_mtim.tv_nsec;
+}
+
+static bool CopyWholeFile(const TCHAR *From, const TCHAR *To)
+{
+	fileBlob_t blob;
+	if (!ReadEntireFile(From, &blob))
+		return false;
+
+	bool bOk = WriteEntireFile(To, blob.pBuffer, blob.Size);
+	blob.Release();
+	return bOk;
+}
+
+static void *OpenLib(const TCHAR *Path)
+{
+	TString<char> native;
+	ToNativePath(Path, &native);
+	return ::dlopen(native, RTLD_NOW | RTLD_LOCAL);
+}
+
+bool LoadSharedLib(sharedLib_t *pLib, TString<TCHAR> Path, bool bCopyFile)
+{
+	*pLib = sharedLib_t(); // Not ZeroThat: the name may own a heap buffer.
+
+	if (!bCopyFile) {
+		pLib->handle = OpenLib(Path);
+		return pLib->handle != nullptr;
+	}
+
+	pLib->fileName = Path;
+
+	Path.Insert(STR("_LOCKED"), Path.GetFileExtension());
+	CopyWholeFile(pLib->fileName, Path);
+
+	pLib->handle = OpenLib(Path);
+	if (!pLib->handle)
+		return false;
+
+	pLib->lastWrite = GetLastWrite(pLib->fileName);
+	return true;
+}
+
+void ReleaseSharedLib(sharedLib_t *pLib)
+{
+	if (pLib->handle)
+		::dlclose(pLib->handle);
+	if (pLib->lastWrite != 0) {
+		pLib->fileName.Insert(STR("_LOCKED"), pLib->fileName.GetFileExtension());
+
+		TString<char> native;
+		ToNativePath(pLib->fileName, &native);
+		::unlink(native);
+	}
+	*pLib = sharedLib_t();
+}
+
+bool IsSharedLibDirty(sharedLib_t *pLib)
+{
+	return pLib->lastWrite != 0 && GetLastWrite(pLib->fileName) > pLib->lastWrite;
+}
+
+void *LoadProc(sharedLib_t pLib, const char *ProcName)
+{
+	return ::dlsym(pLib.handle, ProcName);
+}
+
+#endif // !PLATFORM_WIN64
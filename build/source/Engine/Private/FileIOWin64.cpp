@@ -1,25 +1,39 @@
 #include <pch.h>
 #include <Engine/FileIO.h>
+#include <Engine/Memory.h>
+#include <Engine/Profiler.h>
 
+#if defined(PLATFORM_WIN64)
 #include <Windows.h>
 
 bool ReadEntireFile(const TCHAR *Path, fileBlob_t *pBlob)
 {
+	PROFILE_ZONE("ReadEntireFile");
 	ZeroThat(pBlob);
 	
-	HANDLE File = ::CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 128, nullptr);
-	if (File != (HANDLE)-1) {
+	HANDLE File = ::CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File != INVALID_HANDLE_VALUE) {
 		LARGE_INTEGER Li;
 		::GetFileSizeEx(File, &Li);
-		pBlob->Size = Li.QuadPart;
-
+		pBlob->Size = (size_t)Li.QuadPart;
 		pBlob->pBuffer = malloc(pBlob->Size);
-		
-		BOOL hr = ::ReadFile(File, pBlob->pBuffer, Li.LowPart, nullptr, nullptr);
-		if (hr && Li.HighPart)
-			::ReadFile(File, (void *)(((intptr_t)pBlob->pBuffer) + Li.LowPart), Li.HighPart, nullptr, nullptr);
+
+		// ReadFile takes a DWORD length, so anything over 4GB goes in pieces.
+		size_t Total = 0;
+		while (pBlob->pBuffer && Total < pBlob->Size) {
+			DWORD Chunk = (DWORD)(((pBlob->Size - Total) > 0x80000000ull) ? 0x80000000ull : (pBlob->Size - Total));
+			DWORD Read = 0;
+			if (!::ReadFile(File, (void *)(((uintptr_t)pBlob->pBuffer) + Total), Chunk, &Read, nullptr) || Read == 0)
+				break;
+			Total += Read;
+		}
 
 		::CloseHandle(File);
+		if (Total != pBlob->Size) {
+			ReleaseFileBlob(pBlob);
+			return false;
+		}
+		PROFILE_COUNTER_ADD("IO bytes read", Total);
 		return true;
 	}
 
@@ -29,46 +43,128 @@ bool ReadEntireFile(const TCHAR *Path, fileBlob_t *pBlob)
 void ReleaseFileBlob(fileBlob_t *pBlob)
 {
 	if (pBlob->pBuffer) {
-		free(pBlob->pBuffer);
-		ZeroThat(pBlob);
+		if (pBlob->pOwner)
+			pBlob->pOwner->Free(pBlob->pBuffer);
+		else
+			free(pBlob->pBuffer);
 	}
+	ZeroThat(pBlob);
+}
+
+bool ReadFileRange(const TCHAR *Path, uint64 Offset, size_t Size, void *pDst, size_t *pRead)
+{
+	*pRead = 0;
+
+	HANDLE File = ::CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool bOk = true;
+	while (*pRead < Size) {
+		OVERLAPPED Ov = {};
+		uint64 Pos = Offset + *pRead;
+		Ov.Offset = (DWORD)Pos;
+		Ov.OffsetHigh = (DWORD)(Pos >> 32);
+
+		DWORD Chunk = (DWORD)(((Size - *pRead) > 0x80000000ull) ? 0x80000000ull : (Size - *pRead));
+		DWORD Read = 0;
+		if (!::ReadFile(File, (void *)(((uintptr_t)pDst) + *pRead), Chunk, &Read, &Ov)) {
+			bOk = (::GetLastError() == ERROR_HANDLE_EOF);
+			break;
+		}
+		if (Read == 0)
+			break;
+		*pRead += Read;
+	}
+
+	::CloseHandle(File);
+	return bOk;
+}
+
+bool QueryFileSize(const TCHAR *Path, uint64 *pSize)
+{
+	WIN32_FILE_ATTRIBUTE_DATA Fad = {};
+	if (!::GetFileAttributesEx(Path, GetFileExInfoStandard, &Fad))
+		return false;
+	*pSize = ((uint64)Fad.nFileSizeHigh << 32) | Fad.nFileSizeLow;
+	return true;
+}
+
+bool QueryFileWriteTime(const TCHAR *Path, uint64 *pTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA Fad = {};
+	if (!::GetFileAttributesEx(Path, GetFileExInfoStandard, &Fad))
+		return false;
+	*pTime = ((uint64)Fad.ftLastWriteTime.dwHighDateTime << 32) | Fad.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+bool WriteEntireFile(const TCHAR *Path, const void *pData, size_t Size)
+{
+	HANDLE File = ::CreateFile(Path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+
+	size_t Total = 0;
+	while (Total < Size) {
+		DWORD Chunk = (DWORD)(((Size - Total) > 0x80000000ull) ? 0x80000000ull : (Size - Total));
+		DWORD Written = 0;
+		if (!::WriteFile(File, (const void *)(((uintptr_t)pData) + Total), Chunk, &Written, nullptr) || Written == 0)
+			break;
+		Total += Written;
+	}
+
+	::CloseHandle(File);
+	return Total == Size;
 }
 
 bool MapFile(const TCHAR *Path, mappedFile_t *pFile)
 {
-	pFile->Handle = (void *)::CreateFile(Path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 128, nullptr);
-	if (pFile->Handle != (void *)(HANDLE)-1) {
-		LARGE_INTEGER Li;
-		::GetFileSizeEx((HANDLE)(pFile->Handle), &Li);
-		pFile->Size = Li.QuadPart;
+	ZeroThat(pFile);
 
-		HANDLE mapping = ::CreateFileMapping((HANDLE)pFile->Handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
-		pFile->pView = ::MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, pFile->Size);
+	HANDLE File = ::CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
 
-		return true;
+	LARGE_INTEGER Li;
+	::GetFileSizeEx(File, &Li);
+	pFile->Size = (size_t)Li.QuadPart;
+
+	HANDLE Mapping = ::CreateFileMapping(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!Mapping) {
+		::CloseHandle(File);
+		ZeroThat(pFile);
+		return false;
 	}
-	return false;
+
+	pFile->Handle = (void *)File;
+	pFile->Mapping = (void *)Mapping;
+	pFile->pView = ::MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pFile->pView) {
+		UnmapFile(pFile);
+		return false;
+	}
+	return true;
 }
 
 void UnmapFile(mappedFile_t *pFile)
 {
-	if (pFile->pView) {
+	if (pFile->pView)
 		::UnmapViewOfFile(pFile->pView);
-		HANDLE mapping = ::CreateFileMappingW((HANDLE)pFile->Handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
-		::CloseHandle(mapping);
+	if (pFile->Mapping)
+		::CloseHandle((HANDLE)pFile->Mapping);
+	if (pFile->Handle)
 		::CloseHandle((HANDLE)pFile->Handle);
-		ZeroThat(pFile);
-	}
+	ZeroThat(pFile);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool LoadSharedLib(sharedLib_t *pLib, TString<TCHAR> Path, bool bCopyFile)
 {
-	ZeroThat(pLib);
+	*pLib = sharedLib_t(); // Not ZeroThat: the name may own a heap buffer.
 
 	if (!bCopyFile) {
-		pLib->fileName = TString<TCHAR>();
 		pLib->handle = ::LoadLibrary(Path);
 		if (pLib->handle)
 			return true;
@@ -97,8 +193,7 @@ void ReleaseSharedLib(sharedLib_t *pLib)
 		pLib->fileName.Insert(STR("_LOCKED"), pLib->fileName.GetFileExtension());
 		::DeleteFile((TCHAR *)pLib->fileName);
 	}
-	ZeroThat(pLib);
-	pLib->fileName = TString<TCHAR>();
+	*pLib = sharedLib_t();
 }
 
 bool IsSharedLibDirty(sharedLib_t *pLib)
@@ -117,4 +212,6 @@ bool IsSharedLibDirty(sharedLib_t *pLib)
 void *LoadProc(sharedLib_t pLib, const char *ProcName)
 {
 	return ::GetProcAddress((HMODULE)pLib.handle, ProcName);
-}
\ No newline at end of file
+}
+
+#endif // PLATFORM_WIN64
@@ -0,0 +1,395 @@
+#include <pch.h>
+#include <Engine/JobSystem.h>
+#include <Engine/Memory.h>
+#include <Engine/Profiler.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define JOB_DEQUE_SIZE 4096 // Per worker. Must be a power of two.
+#define JOB_MAX_THREADS 64
+#define JOB_MAX_CHUNKS 256
+#define JOB_SPINS_BEFORE_PARK 64
+
+struct job_t
+{
+	jobFunc_t pFunc;
+	void *pData;
+	jobCounter_t *pCounter;
+};
+
+struct jobWaiter_t
+{
+	job_t job;
+	jobWaiter_t *pNext;
+};
+
+// Chase-Lev work-stealing deque with a fixed ring. The owner never lets it fill past the ring, so a slot
+// can't be overwritten while a thief is still reading it without the thief's CAS on 'top' failing.
+// Slot fields are relaxed atomics only so that read-then-discard is well defined; they're plain moves.
+struct jobSlot_t
+{
+	std::atomic<jobFunc_t> pFunc;
+	std::atomic<void *> pData;
+	std::atomic<jobCounter_t *> pCounter;
+
+	inline void Store(const job_t &Job) {
+		pFunc.store(Job.pFunc, std::memory_order_relaxed);
+		pData.store(Job.pData, std::memory_order_relaxed);
+		pCounter.store(Job.pCounter, std::memory_order_relaxed);
+	}
+
+	inline void Load(job_t *pOut) {
+		pOut->pFunc = pFunc.load(std::memory_order_relaxed);
+		pOut->pData = pData.load(std::memory_order_relaxed);
+		pOut->pCounter = pCounter.load(std::memory_order_relaxed);
+	}
+};
+
+struct jobDeque_t
+{
+	alignas(64) std::atomic<int64_t> top;
+	alignas(64) std::atomic<int64_t> bottom;
+	alignas(64) jobSlot_t jobs[JOB_DEQUE_SIZE];
+
+	bool Push(const job_t &Job)
+	{
+		auto b = bottom.load(std::memory_order_relaxed);
+		auto t = top.load(std::memory_order_acquire);
+		if ((b - t) >= JOB_DEQUE_SIZE)
+			return false;
+
+		jobs[b & (JOB_DEQUE_SIZE - 1)].Store(Job);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool Pop(job_t *pOut)
+	{
+		auto b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto t = top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		jobs[b & (JOB_DEQUE_SIZE - 1)].Load(pOut);
+		if (t == b) {
+			// Last job; race any thieves for it.
+			bool bWon = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return bWon;
+		}
+		return true;
+	}
+
+	bool Steal(job_t *pOut)
+	{
+		auto t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return false;
+
+		jobs[t & (JOB_DEQUE_SIZE - 1)].Load(pOut);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+};
+
+struct jobSystem_t
+{
+	jobDeque_t *pDeques; // [numThreads]
+	std::thread *pThreads; // [numThreads], slot 0 unused (that's the initializing thread).
+	uint numThreads;
+
+	std::atomic<bool> bQuit;
+	std::atomic<int32_t> numQueued;
+	std::atomic<int32_t> numSleeping;
+	std::mutex sleepLock;
+	std::condition_variable sleepCv;
+
+	std::atomic<int32_t> numInjected;
+	std::mutex injectLock;
+	TArray<job_t> injected;
+};
+
+static jobSystem_t *gJobs = nullptr;
+static thread_local uint tJobThread = (uint)-1;
+static thread_local uint32_t tStealSeed = 0x9E3779B9u;
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void Submit(const job_t &Job)
+{
+	auto idx = tJobThread;
+	bool bPushed = (idx < gJobs->numThreads) && gJobs->pDeques[idx].Push(Job);
+	if (!bPushed) {
+		std::lock_guard<std::mutex> lock(gJobs->injectLock);
+		gJobs->injected.Push(Job);
+		gJobs->numInjected.fetch_add(1);
+	}
+
+	gJobs->numQueued.fetch_add(1);
+	if (gJobs->numSleeping.load() > 0) {
+		{ std::lock_guard<std::mutex> lock(gJobs->sleepLock); }
+		gJobs->sleepCv.notify_one();
+	}
+}
+
+static bool TakeJob(uint Index, job_t *pOut)
+{
+	bool bFound = false;
+
+	if (Index < gJobs->numThreads)
+		bFound = gJobs->pDeques[Index].Pop(pOut);
+
+	if (!bFound) {
+		// Start stealing at a random victim so thieves don't all pile onto the same deque.
+		tStealSeed ^= tStealSeed << 13;
+		tStealSeed ^= tStealSeed >> 17;
+		tStealSeed ^= tStealSeed << 5;
+
+		uint start = tStealSeed % gJobs->numThreads;
+		for (uint i = 0; i != gJobs->numThreads && !bFound; ++i) {
+			uint victim = (start + i) % gJobs->numThreads;
+			if (victim != Index)
+				bFound = gJobs->pDeques[victim].Steal(pOut);
+		}
+	}
+
+	if (!bFound && gJobs->numInjected.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(gJobs->injectLock);
+		if (gJobs->injected.Getcount()) {
+			*pOut = gJobs->injected[gJobs->injected.Getcount() - 1];
+			gJobs->injected.Pop();
+			gJobs->numInjected.fetch_sub(1);
+			bFound = true;
+		}
+	}
+
+	if (bFound)
+		gJobs->numQueued.fetch_sub(1);
+	return bFound;
+}
+
+static void ReleaseWaiters(jobCounter_t *pCounter)
+{
+	auto pWaiter = pCounter->pWaiters.exchange(nullptr);
+	while (pWaiter) {
+		auto pNext = pWaiter->pNext;
+		Submit(pWaiter->job);
+		free(pWaiter);
+		pWaiter = pNext;
+	}
+}
+
+static void Execute(const job_t &Job)
+{
+	Job.pFunc(Job.pData);
+
+	auto pCounter = Job.pCounter;
+	if (pCounter) {
+		// 'count' can't be the last thing we touch: a thread in Wait() may free the counter the moment it
+		// hits zero, and we still need to kick its waiters. IsDone() also waits for 'busy' to drain.
+		pCounter->busy.fetch_add(1);
+		if (pCounter->count.fetch_sub(1) == 1)
+			ReleaseWaiters(pCounter);
+		pCounter->busy.fetch_sub(1);
+	}
+}
+
+static void WorkerMain(uint Index)
+{
+	tJobThread = Index;
+	tStealSeed += Index * 0x6D2B79F5u;
+	dmFrameArena_t::SetThreadIndex(Index);
+	PROFILE_THREAD("Job worker");
+
+	uint spins = 0;
+	while (!gJobs->bQuit.load(std::memory_order_relaxed)) {
+		job_t job;
+		if (TakeJob(Index, &job)) {
+			PROFILE_ZONE("Job");
+			Execute(job);
+			spins = 0;
+			continue;
+		}
+
+		if (++spins < JOB_SPINS_BEFORE_PARK) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		gJobs->numSleeping.fetch_add(1);
+		{
+			std::unique_lock<std::mutex> lock(gJobs->sleepLock);
+			gJobs->sleepCv.wait(lock, []() { return gJobs->numQueued.load() > 0 || gJobs->bQuit.load(); });
+		}
+		gJobs->numSleeping.fetch_sub(1);
+		spins = 0;
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Jobs::Initialize(uint NumThreads)
+{
+	if (gJobs)
+		return true;
+
+	if (NumThreads == 0)
+		NumThreads = std::thread::hardware_concurrency();
+	if (NumThreads == 0)
+		NumThreads = 1;
+	if (NumThreads > JOB_MAX_THREADS)
+		NumThreads = JOB_MAX_THREADS;
+
+	gJobs = new jobSystem_t;
+	gJobs->numThreads = NumThreads;
+	gJobs->bQuit.store(false);
+	gJobs->numQueued.store(0);
+	gJobs->numSleeping.store(0);
+	gJobs->numInjected.store(0);
+
+	gJobs->pDeques = new jobDeque_t[NumThreads];
+	for (uint i = 0; i != NumThreads; ++i) {
+		gJobs->pDeques[i].top.store(0);
+		gJobs->pDeques[i].bottom.store(0);
+	}
+
+	// Workers take the first arena indices; reserve them now so an IO thread that starts before a worker
+	// has run can't be handed the same one.
+	tJobThread = 0;
+	dmFrameArena_t::ReserveThreadIndices(NumThreads);
+	dmFrameArena_t::SetThreadIndex(0);
+
+	gJobs->pThreads = new std::thread[NumThreads];
+	for (uint i = 1; i != NumThreads; ++i) {
+		gJobs->pThreads[i] = std::thread(WorkerMain, i);
+	}
+
+	return true;
+}
+
+void Jobs::Release()
+{
+	if (!gJobs)
+		return;
+
+	gJobs->bQuit.store(true);
+	{ std::lock_guard<std::mutex> lock(gJobs->sleepLock); }
+	gJobs->sleepCv.notify_all();
+
+	for (uint i = 1; i != gJobs->numThreads; ++i) {
+		gJobs->pThreads[i].join();
+	}
+
+	delete[] gJobs->pThreads;
+	delete[] gJobs->pDeques;
+	delete gJobs;
+	gJobs = nullptr;
+	tJobThread = (uint)-1;
+}
+
+uint Jobs::GetNumThreads()
+{
+	return (gJobs) ? gJobs->numThreads : 1;
+}
+
+uint Jobs::GetThreadIndex()
+{
+	return tJobThread;
+}
+
+void Jobs::Run(const jobDecl_t *pJobs, uint Num, jobCounter_t *pCounter)
+{
+	if (pCounter)
+		pCounter->count.fetch_add((int32_t)Num);
+
+	for (uint i = 0; i != Num; ++i) {
+		job_t job = { pJobs[i].pFunc, pJobs[i].pData, pCounter };
+		if (gJobs)
+			Submit(job);
+		else
+			Execute(job); // No job system, run inline.
+	}
+}
+
+void Jobs::RunAfter(jobCounter_t *pDependency, const jobDecl_t *pJobs, uint Num, jobCounter_t *pCounter)
+{
+	if (!gJobs || !pDependency || pDependency->IsDone()) {
+		Run(pJobs, Num, pCounter);
+		return;
+	}
+
+	if (pCounter)
+		pCounter->count.fetch_add((int32_t)Num);
+
+	for (uint i = 0; i != Num; ++i) {
+		auto pWaiter = (jobWaiter_t *)malloc(sizeof(jobWaiter_t));
+		pWaiter->job = { pJobs[i].pFunc, pJobs[i].pData, pCounter };
+		pWaiter->pNext = pDependency->pWaiters.load();
+		while (!pDependency->pWaiters.compare_exchange_weak(pWaiter->pNext, pWaiter)) {}
+	}
+
+	// The dependency may have finished while we were queueing; if so nobody else will kick these.
+	if (pDependency->count.load() == 0)
+		ReleaseWaiters(pDependency);
+}
+
+void Jobs::Wait(jobCounter_t *pCounter)
+{
+	while (!pCounter->IsDone()) {
+		job_t job;
+		if (gJobs && TakeJob(tJobThread, &job))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void Jobs::ParallelFor(uint Count, uint Grain, rangeFunc_t pFunc, void *pData)
+{
+	if (!Count)
+		return;
+
+	if (Grain == 0)
+		Grain = 1;
+	if (((Count + Grain - 1) / Grain) > JOB_MAX_CHUNKS)
+		Grain = (Count + JOB_MAX_CHUNKS - 1) / JOB_MAX_CHUNKS;
+
+	uint numChunks = (Count + Grain - 1) / Grain;
+	if (numChunks == 1 || !gJobs) {
+		pFunc(0, Count, pData);
+		return;
+	}
+
+	struct chunk_t {
+		rangeFunc_t pFunc;
+		void *pData;
+		uint begin;
+		uint end;
+	} chunks[JOB_MAX_CHUNKS];
+	jobDecl_t decls[JOB_MAX_CHUNKS];
+
+	for (uint i = 0; i != numChunks; ++i) {
+		chunks[i].pFunc = pFunc;
+		chunks[i].pData = pData;
+		chunks[i].begin = i * Grain;
+		chunks[i].end = ((i + 1) * Grain < Count) ? (i + 1) * Grain : Count;
+		decls[i].pFunc = [](void *p) {
+			auto pChunk = (chunk_t *)p;
+			pChunk->pFunc(pChunk->begin, pChunk->end, pChunk->pData);
+		};
+		decls[i].pData = &chunks[i];
+	}
+
+	jobCounter_t counter;
+	Run(decls, numChunks, &counter);
+	Wait(&counter);
+}
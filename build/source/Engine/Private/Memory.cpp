@@ -1,18 +1,26 @@
 #include <pch.h>
 #include <Engine/Memory.h>
 
-dmRingArena_t::dmRingArena_t(const size_t inSize) 
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+dmRingArena_t::dmRingArena_t(const size_t inSize, const uint inFlags) 
 {
-	this->Initialize(inSize);
+	this->Initialize(inSize, inFlags);
 }
 
-bool dmRingArena_t::Initialize(const size_t inSize) 
+bool dmRingArena_t::Initialize(const size_t inSize, const uint inFlags) 
 {
+	ZeroThat(this);
 	m_floor = (uintptr_t)malloc(inSize);
 	if (m_floor) {
-		memset((void *)m_floor, 0, inSize);
 		m_ceiling = (m_floor + inSize);
 		m_next = m_floor;
+		m_flags = inFlags;
 	}
 	return (m_floor != 0);
 }
@@ -28,17 +36,22 @@ void dmRingArena_t::Release()
 void dmRingArena_t::Reset()
 {
 	m_next = m_floor;
-	memset((void *)m_floor, 0, (size_t)(m_ceiling - m_floor));
 }
 
-void *dmRingArena_t::Push(const size_t inSize) 
+void *dmRingArena_t::Push(const size_t inSize, const size_t inAlign) 
 {
-	auto dst = m_next;
-	m_next += inSize;
-	if (m_next > m_ceiling) {
-		m_next = (m_floor + inSize);
-		dst = m_floor;
+	auto dst = ALIGN(m_next, (uintptr_t)inAlign);
+	if ((dst + inSize) > m_ceiling || dst < m_next) {
+		++m_numOverflows;
+		return nullptr;
 	}
+
+	m_next = dst + inSize;
+	if ((m_next - m_floor) > m_highWater)
+		m_highWater = (m_next - m_floor);
+
+	if (m_flags & DM_ARENA_ZERO)
+		memset((void *)dst, 0, inSize);
 	return (void *)dst;
 }
 
@@ -52,151 +65,673 @@ void dmRingArena_t::Pop(const size_t inSize)
 
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-bool dmHeap_t::Initialize(size_t inSize) 
+static thread_local uint tThreadIndex = (uint)-1;
+static std::atomic<uint> gNextThreadIndex(0);
+
+bool dmFrameArena_t::Initialize(const uint inNumFrames, const size_t inFrameSize, const uint inNumThreads, const size_t inThreadSize, const uint inFlags)
+{
+	if (inNumFrames == 0 || inNumFrames > DM_FRAME_ARENA_MAX_FRAMES)
+		return false;
+
+	m_numFrames = inNumFrames;
+	m_numThreads = inNumThreads;
+	m_frame = 0;
+	m_slot = 0;
+	m_retired.store(0);
+	memset(m_frameInSlot, 0, sizeof(m_frameInSlot));
+
+	m_pFrames = new slot_t[m_numFrames];
+	m_pThreads = (m_numThreads) ? new slot_t[m_numFrames * m_numThreads] : nullptr;
+
+	bool bOk = true;
+	for (uint i = 0; i != m_numFrames; ++i) {
+		bOk &= m_pFrames[i].arena.Initialize(inFrameSize, inFlags);
+	}
+	for (uint i = 0; i != (m_numFrames * m_numThreads); ++i) {
+		bOk &= m_pThreads[i].arena.Initialize(inThreadSize, inFlags);
+	}
+
+	GetThreadIndex(); // Make sure the initializing thread gets the first index.
+
+	if (!bOk)
+		Release();
+	return bOk;
+}
+
+void dmFrameArena_t::Release()
+{
+	for (uint i = 0; m_pFrames && i != m_numFrames; ++i) {
+		m_pFrames[i].arena.Release();
+	}
+	for (uint i = 0; m_pThreads && i != (m_numFrames * m_numThreads); ++i) {
+		m_pThreads[i].arena.Release();
+	}
+
+	delete[] m_pFrames;
+	delete[] m_pThreads;
+	m_pFrames = nullptr;
+	m_pThreads = nullptr;
+	m_numFrames = 0;
+	m_numThreads = 0;
+}
+
+bool dmFrameArena_t::BeginFrame()
+{
+	auto next = m_frame + 1;
+	auto slot = (uint)(next % m_numFrames);
+
+	// The last frame to use this slot hasn't retired yet, the caller needs to wait on its fence.
+	if (m_frameInSlot[slot] > m_retired.load(std::memory_order_acquire))
+		return false;
+
+	m_pFrames[slot].arena.Reset();
+	for (uint i = 0; i != m_numThreads; ++i) {
+		m_pThreads[(slot * m_numThreads) + i].arena.Reset();
+	}
+
+	m_frameInSlot[slot] = next;
+	m_frame = next;
+	m_slot = slot;
+	return true;
+}
+
+void dmFrameArena_t::RetireFrame(const uint64_t inFrame)
+{
+	auto retired = m_retired.load(std::memory_order_relaxed);
+	while (inFrame > retired && !m_retired.compare_exchange_weak(retired, inFrame, std::memory_order_release)) {}
+}
+
+void *dmFrameArena_t::Push(const size_t inSize, const size_t inAlign)
+{
+	return m_pFrames[m_slot].arena.Push(inSize, inAlign);
+}
+
+void *dmFrameArena_t::PushThread(const size_t inSize, const size_t inAlign)
+{
+	auto pArena = GetThreadArena();
+	return (pArena) ? pArena->Push(inSize, inAlign) : nullptr;
+}
+
+dmRingArena_t *dmFrameArena_t::GetThreadArena()
+{
+	auto index = GetThreadIndex();
+	if (index >= m_numThreads)
+		return nullptr;
+	return &m_pThreads[(m_slot * m_numThreads) + index].arena;
+}
+
+size_t dmFrameArena_t::GetHighWater()
+{
+	size_t highWater = 0;
+	for (uint i = 0; i != m_numFrames; ++i) {
+		if (m_pFrames[i].arena.m_highWater > highWater)
+			highWater = m_pFrames[i].arena.m_highWater;
+	}
+	return highWater;
+}
+
+size_t dmFrameArena_t::GetThreadHighWater()
+{
+	size_t highWater = 0;
+	for (uint i = 0; i != (m_numFrames * m_numThreads); ++i) {
+		if (m_pThreads[i].arena.m_highWater > highWater)
+			highWater = m_pThreads[i].arena.m_highWater;
+	}
+	return highWater;
+}
+
+uint dmFrameArena_t::GetNumOverflows()
+{
+	uint num = 0;
+	for (uint i = 0; i != m_numFrames; ++i) {
+		num += m_pFrames[i].arena.m_numOverflows;
+	}
+	for (uint i = 0; i != (m_numFrames * m_numThreads); ++i) {
+		num += m_pThreads[i].arena.m_numOverflows;
+	}
+	return num;
+}
+
+uint dmFrameArena_t::GetThreadIndex()
+{
+	if (tThreadIndex == (uint)-1)
+		tThreadIndex = gNextThreadIndex.fetch_add(1);
+	return tThreadIndex;
+}
+
+// Anything handed out from here on starts above the indices that are assigned by hand.
+static void RaiseNextThreadIndex(const uint inIndex)
+{
+	uint next = gNextThreadIndex.load();
+	while (next < inIndex && !gNextThreadIndex.compare_exchange_weak(next, inIndex)) {}
+}
+
+void dmFrameArena_t::SetThreadIndex(const uint inIndex)
+{
+	tThreadIndex = inIndex;
+	RaiseNextThreadIndex(inIndex + 1);
+}
+
+void dmFrameArena_t::ReserveThreadIndices(const uint inCount)
+{
+	RaiseNextThreadIndex(inCount);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define HEADER_SIZE (offsetof(dmHeap_t::header_t, pNextFree))
+#define MIN_BLOCK_SIZE (sizeof(void *) * 2) // Room for the free list links.
+#define FREE_BIT ((size_t)1)
+
+#define CACHE_CLASSES 16 // Payloads of 16..256 bytes.
+#define CACHE_DEPTH 32
+#define CACHE_MAX_SIZE (CACHE_CLASSES * DM_HEAP_ALIGN)
+
+typedef dmHeap_t::header_t header_t;
+
+struct dmHeapLock_t 
+{
+	std::mutex mutex;
+};
+
+struct heapThreadCache_t
+{
+	uint heapId; // 0 when the cache isn't bound to a heap.
+	uint numCached;
+	header_t *pHeads[CACHE_CLASSES];
+	uint counts[CACHE_CLASSES];
+};
+
+static thread_local heapThreadCache_t tCache;
+static std::atomic<uint> gNextHeapId(1);
+static std::atomic<uint> gCachedHeapIds[DM_HEAP_MAX_CACHED]; // Live thread-cached heaps, 0 = empty.
+
+static bool AddCachedHeapId(uint inId)
+{
+	for (auto &id : gCachedHeapIds) {
+		uint expected = 0;
+		if (id.compare_exchange_strong(expected, inId))
+			return true;
+	}
+	return false;
+}
+
+static void RemoveCachedHeapId(uint inId)
+{
+	if (inId == 0)
+		return;
+	for (auto &id : gCachedHeapIds) {
+		uint expected = inId;
+		if (id.compare_exchange_strong(expected, 0))
+			return;
+	}
+}
+
+static bool IsCachedHeapIdLive(uint inId)
+{
+	for (auto &id : gCachedHeapIds) {
+		if (id.load(std::memory_order_acquire) == inId)
+			return true;
+	}
+	return false;
+}
+
+static inline uint BitScanLow(uint32_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (uint)i;
+#else
+	return (uint)__builtin_ctz(x);
+#endif
+}
+
+static inline uint BitScanHigh(uint64_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanReverse64(&i, x);
+	return (uint)i;
+#else
+	return (uint)(63 - __builtin_clzll(x));
+#endif
+}
+
+static inline size_t BlockSize(const header_t *pBlock) { return (pBlock->size & ~FREE_BIT); }
+static inline bool IsFree(const header_t *pBlock) { return (pBlock->size & FREE_BIT) != 0; }
+static inline void *Payload(const header_t *pBlock) { return (void *)(((uintptr_t)pBlock) + HEADER_SIZE); }
+static inline header_t *HeaderOf(const void *inPtr) { return (header_t *)(((uintptr_t)inPtr) - HEADER_SIZE); }
+static inline header_t *NextPhys(const header_t *pBlock) { return (header_t *)(((uintptr_t)pBlock) + HEADER_SIZE + BlockSize(pBlock)); }
+
+static inline size_t AdjustSize(size_t inSize)
+{
+	if (inSize < MIN_BLOCK_SIZE)
+		return MIN_BLOCK_SIZE;
+	return ALIGN(inSize, (size_t)DM_HEAP_ALIGN);
+}
+
+// Maps a block size to the free list it lives in.
+static inline void MapInsert(size_t inSize, uint *pFl, uint *pSl)
+{
+	if (inSize < DM_HEAP_SMALL_SIZE) {
+		*pFl = 0;
+		*pSl = (uint)(inSize >> DM_HEAP_ALIGN_LOG2);
+	} else {
+		uint fl = BitScanHigh(inSize);
+		*pSl = (uint)(inSize >> (fl - DM_HEAP_SL_LOG2)) ^ DM_HEAP_SL_COUNT;
+		*pFl = fl - (DM_HEAP_FL_SHIFT - 1);
+	}
+}
+
+// Maps a request to the first free list whose blocks are all guaranteed to fit it.
+static inline void MapSearch(size_t inSize, uint *pFl, uint *pSl)
+{
+	if (inSize >= DM_HEAP_SMALL_SIZE) {
+		inSize += ((size_t)1 << (BitScanHigh(inSize) - DM_HEAP_SL_LOG2)) - 1;
+	}
+	MapInsert(inSize, pFl, pSl);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool dmHeap_t::Initialize(const size_t inSize, const uint inFlags) 
 {
+	ZeroThat(this);
+	if (inSize < (HEADER_SIZE * 2 + MIN_BLOCK_SIZE + DM_HEAP_ALIGN))
+		return false;
+
 	m_baseAddr = malloc(inSize);
 	if (m_baseAddr) {
-		memset(m_baseAddr, 0, inSize);
-		m_pFirst = (header_t *)m_baseAddr;
-		m_pFirst->pNext = nullptr;
-		m_pFirst->size = inSize - sizeof(*m_pFirst);
+		m_allocatedSize = inSize;
+		m_flags = inFlags;
+		if (m_flags & DM_HEAP_THREAD_CACHE)
+			m_flags |= DM_HEAP_THREADSAFE;
+		if (m_flags & DM_HEAP_THREADSAFE)
+			m_pLock = new dmHeapLock_t;
+		this->Reset();
 	}
 	return (m_baseAddr != nullptr);
 }
 
 void dmHeap_t::Release()
 {
-	free(m_baseAddr);
-	m_baseAddr = nullptr;
-	m_pFirst = nullptr;
-	m_allocatedSize = 0;
+	if (m_baseAddr) {
+		RemoveCachedHeapId(m_id);
+		free(m_baseAddr);
+		delete m_pLock;
+		ZeroThat(this);
+	}
 }
 
 void dmHeap_t::Reset()
 {
-	memset(m_baseAddr, 0, m_allocatedSize);
-	m_pFirst = (header_t *)m_baseAddr;
-	m_pFirst->size = m_allocatedSize;
+	Lock();
+
+	// Caches bound to the old id hold blocks of the old pool; dropping the id lets their threads tell.
+	RemoveCachedHeapId(m_id);
+	m_id = gNextHeapId.fetch_add(1);
+	if ((m_flags & DM_HEAP_THREAD_CACHE) && !AddCachedHeapId(m_id))
+		m_flags &= ~DM_HEAP_THREAD_CACHE;
+	m_flBitmap = 0;
+	memset(m_slBitmap, 0, sizeof(m_slBitmap));
+	memset(m_pFreeHeads, 0, sizeof(m_pFreeHeads));
+	m_liveBytes = 0;
+	m_peakBytes = 0;
+	m_freeBytes = 0;
+	m_numAllocs = 0;
+	m_numFreeBlocks = 0;
+
+	// [h . . . . . . . . . . . . . . . h] <- Zero sized, never free sentinel so merging stops at the end of the pool.
+	uintptr_t floor = ALIGN((uintptr_t)m_baseAddr, (uintptr_t)DM_HEAP_ALIGN);
+	uintptr_t ceiling = (((uintptr_t)m_baseAddr) + m_allocatedSize) & ~(uintptr_t)(DM_HEAP_ALIGN - 1);
+
+	auto pFirst = (header_t *)floor;
+	auto pSentinel = (header_t *)(ceiling - HEADER_SIZE);
+	pFirst->pPrevPhys = nullptr;
+	pFirst->size = ((uintptr_t)pSentinel) - floor - HEADER_SIZE;
+	pSentinel->pPrevPhys = pFirst;
+	pSentinel->size = 0;
+	InsertFree(pFirst);
+
+	Unlock();
 }
 
 void *dmHeap_t::Alloc(const size_t inSize)
 {
-	header_t *pPrev = nullptr, *pThis = m_pFirst;
+	if ((m_flags & DM_HEAP_THREAD_CACHE) && inSize <= CACHE_MAX_SIZE && tCache.heapId == m_id) {
+		uint c = (uint)(AdjustSize(inSize) >> DM_HEAP_ALIGN_LOG2) - 1;
+		auto pBlock = tCache.pHeads[c];
+		if (pBlock) {
+			tCache.pHeads[c] = pBlock->pNextFree;
+			--tCache.counts[c];
+			--tCache.numCached;
+			return Payload(pBlock);
+		}
+	}
+
+	Lock();
+	auto p = AllocLocked(inSize, DM_HEAP_ALIGN);
+	Unlock();
+	return p;
+}
+
+void *dmHeap_t::AllocAligned(const size_t inSize, const size_t inAlign)
+{
+	Lock();
+	auto p = AllocLocked(inSize, inAlign);
+	Unlock();
+	return p;
+}
+
+// Only DM_HEAP_ALIGN alignment is kept if the block has to move.
+void *dmHeap_t::Realloc(const void *inPtr, const size_t inSize)
+{
+	Lock();
+	auto p = ReallocLocked(inPtr, inSize);
+	Unlock();
+	return p;
+}
+
+void dmHeap_t::Free(const void *inPtr)
+{
+	if (!inPtr)
+		return;
 
-	while (pThis) {
+	if (m_flags & DM_HEAP_THREAD_CACHE) {
+		auto pBlock = HeaderOf(inPtr);
+		size_t size = BlockSize(pBlock);
 
-		// If 'pThis' is big enough for inSize + a tracking size_t...
-		if (pThis->size >= (inSize + sizeof(size_t))) {
-			pPrev->pNext = pThis->pNext; // Unlink 'pThis'.
+		// Take over the cache if it's empty, or if the heap it was bound to has been Reset() or Released()
+		// since; its blocks went with the old pool. A cache of another live heap is left alone.
+		if (tCache.heapId != m_id && (tCache.numCached == 0 || !IsCachedHeapIdLive(tCache.heapId))) {
+			ZeroThat(&tCache);
+			tCache.heapId = m_id;
+		}
 
-			// If 'pThis' can be bisected...
-			if (pThis->size > (inSize + sizeof(size_t) + sizeof(header_t))) {
-				// [h . . . . . . . . . .]  -> [h . . . h . . . . . .]
-				auto pInsert = (header_t *)(((uintptr_t)pThis) + inSize + sizeof(size_t));
-				pInsert->pNext = pPrev->pNext;
-				pInsert->size = (pThis->size - (inSize));
-				pPrev->pNext = pInsert;
+		if (tCache.heapId == m_id && size <= CACHE_MAX_SIZE) {
+			uint c = (uint)(size >> DM_HEAP_ALIGN_LOG2) - 1;
+			if (tCache.counts[c] < CACHE_DEPTH) {
+				pBlock->pNextFree = tCache.pHeads[c];
+				tCache.pHeads[c] = pBlock;
+				++tCache.counts[c];
+				++tCache.numCached;
+				return;
 			}
+		}
+	}
+
+	Lock();
+	FreeLocked(inPtr);
+	Unlock();
+}
 
-			*(size_t *)pThis = inSize; // Insert tracking size_t.
-			return (void *)(((uintptr_t)pThis) + sizeof(size_t)); // Return usable addr.
+void dmHeap_t::FlushThreadCache()
+{
+	if (tCache.heapId != m_id)
+		return;
+
+	Lock();
+	for (uint c = 0; c != CACHE_CLASSES; ++c) {
+		for (auto pBlock = tCache.pHeads[c]; pBlock != nullptr;) {
+			auto pNext = pBlock->pNextFree;
+			FreeLocked(Payload(pBlock));
+			pBlock = pNext;
+		}
+	}
+	Unlock();
+
+	ZeroThat(&tCache);
+}
+
+void dmHeap_t::GetStats(dmHeapStats_t *pOut)
+{
+	ZeroThat(pOut);
+
+	Lock();
+	pOut->capacity = (((uintptr_t)m_baseAddr + m_allocatedSize) & ~(uintptr_t)(DM_HEAP_ALIGN - 1)) - ALIGN((uintptr_t)m_baseAddr, (uintptr_t)DM_HEAP_ALIGN) - (HEADER_SIZE * 2);
+	pOut->liveBytes = m_liveBytes;
+	pOut->peakBytes = m_peakBytes;
+	pOut->freeBytes = m_freeBytes;
+	pOut->numAllocs = m_numAllocs;
+	pOut->numFreeBlocks = m_numFreeBlocks;
+
+	// The largest block is somewhere in the highest non-empty list.
+	if (m_flBitmap) {
+		uint fl = BitScanHigh(m_flBitmap);
+		uint sl = BitScanHigh(m_slBitmap[fl]);
+		for (auto pBlock = m_pFreeHeads[fl][sl]; pBlock != nullptr; pBlock = pBlock->pNextFree) {
+			if (BlockSize(pBlock) > pOut->largestFreeBlock)
+				pOut->largestFreeBlock = BlockSize(pBlock);
 		}
+	}
+	Unlock();
+
+	if (pOut->freeBytes)
+		pOut->fragmentation = 1.0f - ((float)pOut->largestFreeBlock / (float)pOut->freeBytes);
+}
+
+size_t dmHeap_t::GetAllocSize(const void *inPtr)
+{
+	return BlockSize(HeaderOf(inPtr));
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void *dmHeap_t::AllocLocked(const size_t inSize, const size_t inAlign)
+{
+	if (inSize > ((size_t)1 << DM_HEAP_FL_MAX))
+		return nullptr;
+
+	size_t size = AdjustSize(inSize);
+
+	if (inAlign <= DM_HEAP_ALIGN) {
+		auto pBlock = FindFree(size);
+		if (!pBlock)
+			return nullptr;
+		Split(pBlock, size);
+
+		m_liveBytes += BlockSize(pBlock);
+		if (m_liveBytes > m_peakBytes)
+			m_peakBytes = m_liveBytes;
+		++m_numAllocs;
+		return Payload(pBlock);
+	}
 
-		pPrev = pThis;
-		pThis = pThis->pNext;
+	// Over-allocate so there's always room to cut a whole free block off the front.
+	const size_t minGap = HEADER_SIZE + MIN_BLOCK_SIZE;
+	auto pBlock = FindFree(size + inAlign + minGap);
+	if (!pBlock)
+		return nullptr;
+
+	uintptr_t payload = (uintptr_t)Payload(pBlock);
+	uintptr_t aligned = ALIGN(payload, (uintptr_t)inAlign);
+	if (aligned != payload && (aligned - payload) < minGap)
+		aligned = ALIGN(payload + minGap, (uintptr_t)inAlign);
+
+	size_t gap = (size_t)(aligned - payload);
+	if (gap) {
+		// [h . . . . . . . . . .]  -> [h . . h . . . . . . .]
+		auto pAligned = HeaderOf((void *)aligned);
+		pAligned->size = BlockSize(pBlock) - gap;
+		pAligned->pPrevPhys = pBlock;
+		NextPhys(pAligned)->pPrevPhys = pAligned;
+		pBlock->size = gap - HEADER_SIZE;
+		InsertFree(pBlock); // Can't merge; the block came off the free lists fully merged.
+		pBlock = pAligned;
 	}
+	Split(pBlock, size);
 
-	return nullptr;
+	m_liveBytes += BlockSize(pBlock);
+	if (m_liveBytes > m_peakBytes)
+		m_peakBytes = m_liveBytes;
+	++m_numAllocs;
+	return Payload(pBlock);
 }
 
-void *dmHeap_t::Realloc(const void *inPtr, size_t inSize)
+void *dmHeap_t::ReallocLocked(const void *inPtr, const size_t inSize)
 {
-	auto pHeader = (header_t *)(((uintptr_t)inPtr) - sizeof(size_t));
-	size_t oldSize = *(size_t *)pHeader;
-	
-	auto pDst = this->Alloc(inSize);
-	if (oldSize >= inSize)
-		memcpy(pDst, inPtr, inSize);
-	else
-		memcpy(pDst, inPtr, oldSize);
+	if (!inPtr)
+		return AllocLocked(inSize, DM_HEAP_ALIGN);
+	if (!inSize) {
+		FreeLocked(inPtr);
+		return nullptr;
+	}
 
-	pHeader->size = oldSize;
-	pHeader->pNext = m_pFirst;
-	m_pFirst = pHeader;
+	auto pBlock = HeaderOf(inPtr);
+	size_t current = BlockSize(pBlock);
+	size_t size = AdjustSize(inSize);
 
-	//DefragOne(pHeader);
+	// Grow in place by swallowing the next block if it's free and big enough.
+	auto pNext = NextPhys(pBlock);
+	if (size > current && IsFree(pNext) && (current + HEADER_SIZE + BlockSize(pNext)) >= size) {
+		RemoveFree(pNext);
+		pBlock->size = current + HEADER_SIZE + BlockSize(pNext);
+		NextPhys(pBlock)->pPrevPhys = pBlock;
+	}
+
+	if (size <= BlockSize(pBlock)) {
+		Split(pBlock, size);
+		m_liveBytes = m_liveBytes - current + BlockSize(pBlock);
+		if (m_liveBytes > m_peakBytes)
+			m_peakBytes = m_liveBytes;
+		return (void *)inPtr;
+	}
 
+	auto pDst = AllocLocked(inSize, DM_HEAP_ALIGN);
+	if (pDst) {
+		memcpy(pDst, inPtr, current);
+		FreeLocked(inPtr);
+	}
 	return pDst;
 }
 
-void dmHeap_t::Free(const void *inPtr)
+void dmHeap_t::FreeLocked(const void *inPtr)
 {
-	auto pHeader = (header_t *)(((uintptr_t)inPtr) - sizeof(size_t));
-	auto size = *(size_t *)pHeader;
-	pHeader->pNext = m_pFirst;
-	pHeader->size = size;
+	if (!inPtr)
+		return;
+
+	auto pBlock = HeaderOf(inPtr);
+	m_liveBytes -= BlockSize(pBlock);
+	--m_numAllocs;
+	InsertFree(Merge(pBlock));
 }
 
-uint dmHeap_t::DefragAll()
+void dmHeap_t::InsertFree(header_t *pBlock)
 {
-	uint numReclaimed = 0; // The number of blocks that have been reclaimed.
+	uint fl, sl;
+	MapInsert(BlockSize(pBlock), &fl, &sl);
 
-	for (auto pHeader = m_pFirst; 
-		 pHeader != nullptr; 
-		 pHeader = pHeader->pNext) 
-	{
-		// While we keep finding contiguous blocks at the end of 'pHeader', keep running the defrag loop.
-		while (true) {
-			// temp
-			header_t *pPrev = nullptr, *pNext = m_pFirst;
+	auto pHead = m_pFreeHeads[fl][sl];
+	pBlock->pPrevFree = nullptr;
+	pBlock->pNextFree = pHead;
+	if (pHead)
+		pHead->pPrevFree = pBlock;
+	m_pFreeHeads[fl][sl] = pBlock;
 
-			while (pNext != nullptr) {
-				// if 'pNext' is directly contiguous with 'pHeader'...
-				if ((uintptr_t)pNext == (((uintptr_t)pHeader) + pHeader->size)) {
-					break;
-				}
-				pPrev = pNext;
-				pNext = pNext->pNext;
-			}
+	m_flBitmap |= (1u << fl);
+	m_slBitmap[fl] |= (1u << sl);
 
-			if (pNext) {
-				++numReclaimed;
-				pHeader->size += pNext->size; // Let 'pHeader' consume 'pNext'.
-				pPrev->pNext = pNext->pNext; // Unlink 'pNext'.
-			} else {
-				break; // 'pHeader' has not consumed anything, so break the loop.
-			}
+	pBlock->size |= FREE_BIT;
+	m_freeBytes += BlockSize(pBlock);
+	++m_numFreeBlocks;
+}
+
+void dmHeap_t::RemoveFree(header_t *pBlock)
+{
+	uint fl, sl;
+	MapInsert(BlockSize(pBlock), &fl, &sl);
+
+	if (pBlock->pNextFree)
+		pBlock->pNextFree->pPrevFree = pBlock->pPrevFree;
+	if (pBlock->pPrevFree)
+		pBlock->pPrevFree->pNextFree = pBlock->pNextFree;
+
+	if (m_pFreeHeads[fl][sl] == pBlock) {
+		m_pFreeHeads[fl][sl] = pBlock->pNextFree;
+		if (!m_pFreeHeads[fl][sl]) {
+			m_slBitmap[fl] &= ~(1u << sl);
+			if (!m_slBitmap[fl])
+				m_flBitmap &= ~(1u << fl);
 		}
 	}
 
-	return numReclaimed;
+	pBlock->size &= ~FREE_BIT;
+	m_freeBytes -= BlockSize(pBlock);
+	--m_numFreeBlocks;
 }
 
-uint dmHeap_t::DefragOne(header_t *pHeader)
+header_t *dmHeap_t::FindFree(size_t inSize)
 {
-	uint numReclaimed = 0;
+	uint fl, sl;
+	MapSearch(inSize, &fl, &sl);
+	if (fl >= DM_HEAP_FL_COUNT)
+		return nullptr;
 
-	while (true) {
-		// temp
-		header_t *pPrev = nullptr, *pNext = m_pFirst;
+	uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+	if (!slMap) {
+		// Nothing big enough in this power of two; take the smallest class of the next one up.
+		uint32_t flMap = m_flBitmap & (~0u << (fl + 1));
+		if (!flMap)
+			return nullptr;
+		fl = BitScanLow(flMap);
+		slMap = m_slBitmap[fl];
+	}
+	sl = BitScanLow(slMap);
 
-		while (pNext != nullptr) {
-			// if 'pNext' is directly contiguous with 'pHeader'...
-			if ((uintptr_t)pNext == (((uintptr_t)pHeader) + pHeader->size)) {
-				break;
-			}
-			pPrev = pNext;
-			pNext = pNext->pNext;
-		}
+	auto pBlock = m_pFreeHeads[fl][sl];
+	RemoveFree(pBlock);
+	return pBlock;
+}
 
-		if (pNext) {
-			++numReclaimed;
-			pHeader->size += pNext->size; // Let 'pHeader' consume 'pNext'.
-			pPrev->pNext = pNext->pNext; // Unlink 'pNext'.
-		} else {
-			break; // 'pHeader' has not consumed anything, so break the loop.
-		}
+// Trims 'pBlock' (which must be off the free lists) down to 'inSize', handing the tail back to the free lists.
+header_t *dmHeap_t::Split(header_t *pBlock, size_t inSize)
+{
+	size_t size = BlockSize(pBlock);
+	if (size < (inSize + HEADER_SIZE + MIN_BLOCK_SIZE))
+		return nullptr;
+
+	// [h . . . . . . . . . .]  -> [h . . . h . . . . . .]
+	auto pRest = (header_t *)(((uintptr_t)Payload(pBlock)) + inSize);
+	pRest->size = size - inSize - HEADER_SIZE;
+	pRest->pPrevPhys = pBlock;
+	NextPhys(pRest)->pPrevPhys = pRest;
+	pBlock->size = inSize;
+
+	pRest = Merge(pRest);
+	InsertFree(pRest);
+	return pRest;
+}
+
+// Coalesces 'pBlock' (which must be off the free lists) with any free physical neighbours.
+header_t *dmHeap_t::Merge(header_t *pBlock)
+{
+	auto pPrev = pBlock->pPrevPhys;
+	if (pPrev && IsFree(pPrev)) {
+		RemoveFree(pPrev);
+		pPrev->size += HEADER_SIZE + BlockSize(pBlock);
+		NextPhys(pPrev)->pPrevPhys = pPrev;
+		pBlock = pPrev;
 	}
 
-	return numReclaimed;
-}
\ No newline at end of file
+	auto pNext = NextPhys(pBlock);
+	if (IsFree(pNext)) {
+		RemoveFree(pNext);
+		pBlock->size += HEADER_SIZE + BlockSize(pNext);
+		NextPhys(pBlock)->pPrevPhys = pBlock;
+	}
+
+	return pBlock;
+}
+
+void dmHeap_t::Lock()
+{
+	if (m_pLock)
+		m_pLock->mutex.lock();
+}
+
+void dmHeap_t::Unlock()
+{
+	if (m_pLock)
+		m_pLock->mutex.unlock();
+}
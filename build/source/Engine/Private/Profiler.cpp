@@ -0,0 +1,368 @@
+#include <pch.h>
+#include <Engine/DebugLog.h>
+#include <Engine/Profiler.h>
+
+#if PROFILE_ENABLED
+
+#include <Engine/FileIO.h>
+#include <Engine/Memory.h>
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+
+// One per thread that has finished a zone. Only the owner moves 'head' and only EndFrame() moves 'tail',
+// so neither side ever waits on the other.
+struct profThreadRing_t
+{
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+	std::atomic<uint32_t> dropped;
+	std::atomic<const char *> pName;
+	uint32_t index;
+	profZone_t zones[PROFILE_RING_SIZE];
+};
+
+struct profSample_t
+{
+	uint counter;
+	uint64_t time;
+	int64_t value;
+};
+
+struct profState_t
+{
+	std::atomic<profThreadRing_t *> rings[PROFILE_MAX_THREADS];
+	std::atomic<uint32_t> numRings;
+	std::atomic<uint32_t> numCounters;
+	std::mutex counterLock; // Registration only.
+
+	uint64_t frame;
+	uint64_t frameBegin;
+	float frameTimes[PROFILE_HISTORY];
+	TArray<profZone_t> frameZones;
+	TArray<profZone_t> gpuZones;
+	uint numDropped;
+
+	bool bCapturing;
+	uint64_t captureBegin;
+	TArray<profZone_t> captureZones;
+	TArray<profSample_t> captureSamples;
+};
+
+static profState_t gProf;
+profCounter_t Profiler::gCounters[PROFILE_MAX_COUNTERS];
+
+static thread_local profThreadRing_t *tRing = nullptr;
+static thread_local bool tNoRing = false;
+static thread_local uint32_t tDepth = 0;
+
+static profThreadRing_t *GetRing()
+{
+	if (tRing || tNoRing)
+		return tRing;
+
+	uint32_t index = gProf.numRings.fetch_add(1);
+	if (index >= PROFILE_MAX_THREADS) {
+		tNoRing = true; // Out of rings; this thread just isn't profiled.
+		return nullptr;
+	}
+
+	auto pRing = new profThreadRing_t();
+	pRing->index = index;
+	gProf.rings[index].store(pRing, std::memory_order_release);
+	tRing = pRing;
+	return pRing;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64_t Profiler::GetTime()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::SetThreadName(const char *pName)
+{
+	if (auto pRing = GetRing())
+		pRing->pName.store(pName, std::memory_order_relaxed);
+}
+
+uint32_t Profiler::EnterZone()
+{
+	return tDepth++;
+}
+
+void Profiler::LeaveZone()
+{
+	--tDepth;
+}
+
+void Profiler::PushZone(const char *pName, uint64_t Begin, uint64_t End, uint32_t Depth)
+{
+	auto pRing = GetRing();
+	if (!pRing)
+		return;
+
+	uint32_t head = pRing->head.load(std::memory_order_relaxed);
+	if (head - pRing->tail.load(std::memory_order_acquire) >= PROFILE_RING_SIZE) {
+		pRing->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	auto &zone = pRing->zones[head % PROFILE_RING_SIZE];
+	zone.pName = pName;
+	zone.begin = Begin;
+	zone.end = End;
+	zone.thread = pRing->index;
+	zone.depth = Depth;
+	pRing->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::ReportGpuFrame(const profZone_t *pZones, uint Num)
+{
+	gProf.gpuZones.Clear();
+	for (uint i = 0; i != Num; ++i) {
+		auto &zone = gProf.gpuZones.Push(pZones[i]);
+		zone.thread = PROFILE_GPU_THREAD;
+		if (gProf.bCapturing)
+			gProf.captureZones.Push(zone);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint Profiler::RegisterCounter(const char *pName, EProfCounterType Type)
+{
+	std::lock_guard<std::mutex> lock(gProf.counterLock);
+
+	uint num = gProf.numCounters.load(std::memory_order_relaxed);
+	for (uint i = 0; i != num; ++i) {
+		if (gCounters[i].pName == pName || !strcmp(gCounters[i].pName, pName))
+			return i;
+	}
+
+	// Out of counters: everything else lands in the last one.
+	VERIFY(num < PROFILE_MAX_COUNTERS);
+	if (num == PROFILE_MAX_COUNTERS)
+		return num - 1;
+
+	gCounters[num].pName = pName;
+	gCounters[num].type = Type;
+	gProf.numCounters.store(num + 1, std::memory_order_release);
+	return num;
+}
+
+void Profiler::WatchHeap(const char *pName, dmHeap_t *pHeap)
+{
+	auto &counter = gCounters[RegisterCounter(pName, eProfCounterBytes)];
+	counter.bHeap = true;
+	counter.pWatched = pHeap;
+}
+
+void Profiler::WatchArena(const char *pName, dmRingArena_t *pArena)
+{
+	auto &counter = gCounters[RegisterCounter(pName, eProfCounterBytes)];
+	counter.bHeap = false;
+	counter.pWatched = pArena;
+}
+
+void Profiler::Unwatch(const void *pWatched)
+{
+	uint num = gProf.numCounters.load(std::memory_order_acquire);
+	for (uint i = 0; i != num; ++i) {
+		if (gCounters[i].pWatched == pWatched) {
+			gCounters[i].pWatched = nullptr;
+			gCounters[i].value.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Profiler::EndFrame()
+{
+	uint64_t now = GetTime();
+	uint slot = (uint)(gProf.frame % PROFILE_HISTORY);
+
+	gProf.frameTimes[slot] = gProf.frameBegin ? (float)((double)(now - gProf.frameBegin) / 1000000.0) : 0.0f;
+	gProf.frameBegin = now;
+
+	// -- Drain the rings.
+	gProf.frameZones.Clear();
+	uint32_t numRings = gProf.numRings.load(std::memory_order_acquire);
+	if (numRings > PROFILE_MAX_THREADS)
+		numRings = PROFILE_MAX_THREADS;
+
+	for (uint32_t i = 0; i != numRings; ++i) {
+		auto pRing = gProf.rings[i].load(std::memory_order_acquire);
+		if (!pRing)
+			continue; // Claimed but not published yet.
+
+		uint32_t tail = pRing->tail.load(std::memory_order_relaxed);
+		uint32_t head = pRing->head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail)
+			gProf.frameZones.Push(pRing->zones[tail % PROFILE_RING_SIZE]);
+		pRing->tail.store(tail, std::memory_order_release);
+
+		gProf.numDropped += pRing->dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	if (gProf.bCapturing) {
+		for (uint i = 0; i != gProf.frameZones.Getcount(); ++i)
+			gProf.captureZones.Push(gProf.frameZones[i]);
+	}
+
+	// -- Sample counters.
+	uint numCounters = gProf.numCounters.load(std::memory_order_acquire);
+	for (uint i = 0; i != numCounters; ++i) {
+		auto &counter = gCounters[i];
+		if (counter.pWatched) {
+			if (counter.bHeap) {
+				dmHeapStats_t stats;
+				((dmHeap_t *)counter.pWatched)->GetStats(&stats);
+				counter.value.store((int64_t)stats.liveBytes, std::memory_order_relaxed);
+			} else {
+				counter.value.store((int64_t)((dmRingArena_t *)counter.pWatched)->GetUsed(), std::memory_order_relaxed);
+			}
+		}
+
+		int64_t value = (counter.type == eProfCounterPerFrame) ? counter.value.exchange(0, std::memory_order_relaxed) : counter.value.load(std::memory_order_relaxed);
+		counter.history[slot] = value;
+		if (gProf.bCapturing)
+			gProf.captureSamples.Push({ i, now, value });
+	}
+
+	++gProf.frame;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Profiler::StartCapture()
+{
+	gProf.captureZones.Clear();
+	gProf.captureSamples.Clear();
+	gProf.captureBegin = GetTime();
+	gProf.bCapturing = true;
+}
+
+bool Profiler::IsCapturing()
+{
+	return gProf.bCapturing;
+}
+
+static void AppendJsonString(TString<char> *pJson, const char *pStr)
+{
+	pJson->Append("\"", 1);
+	for (auto c = pStr; *c; ++c) {
+		if (*c == '"' || *c == '\\')
+			pJson->Append("\\", 1);
+		pJson->Append(c, 1);
+	}
+	pJson->Append("\"", 1);
+}
+
+// Trace timestamps are microseconds from the start of the capture.
+static inline double TraceTime(uint64_t Time)
+{
+	return ((double)(int64_t)(Time - gProf.captureBegin)) / 1000.0;
+}
+
+bool Profiler::StopCapture(const TCHAR *Path)
+{
+	if (!gProf.bCapturing)
+		return false;
+	gProf.bCapturing = false;
+
+	TString<char> json;
+	char line[256];
+	json.Append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	// -- Track names.
+	uint32_t numRings = gProf.numRings.load(std::memory_order_acquire);
+	if (numRings > PROFILE_MAX_THREADS)
+		numRings = PROFILE_MAX_THREADS;
+	for (uint32_t i = 0; i != numRings; ++i) {
+		snprintf(line, sizeof(line), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", i);
+		json.Append(line);
+		AppendJsonString(&json, GetThreadName(i));
+		json.Append("}},\n");
+	}
+	snprintf(line, sizeof(line), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", PROFILE_GPU_THREAD);
+	json.Append(line);
+
+	// -- Zones as complete events, counters as counter events.
+	for (uint i = 0; i != gProf.captureZones.Getcount(); ++i) {
+		auto &zone = gProf.captureZones[i];
+		json.Append(",\n{\"ph\":\"X\",\"name\":");
+		AppendJsonString(&json, zone.pName);
+		snprintf(line, sizeof(line), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			zone.thread, TraceTime(zone.begin), (double)(zone.end - zone.begin) / 1000.0);
+		json.Append(line);
+	}
+
+	for (uint i = 0; i != gProf.captureSamples.Getcount(); ++i) {
+		auto &sample = gProf.captureSamples[i];
+		json.Append(",\n{\"ph\":\"C\",\"name\":");
+		AppendJsonString(&json, gCounters[sample.counter].pName);
+		snprintf(line, sizeof(line), ",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%lld}}", TraceTime(sample.time), (long long)sample.value);
+		json.Append(line);
+	}
+
+	json.Append("\n]}\n");
+
+	gProf.captureZones.Free();
+	gProf.captureSamples.Free();
+	return WriteEntireFile(Path, (const char *)json, json.Length());
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64_t Profiler::GetFrameNumber()
+{
+	return gProf.frame;
+}
+
+float Profiler::GetFrameTime(uint64_t Frame)
+{
+	if (Frame >= gProf.frame || gProf.frame - Frame > PROFILE_HISTORY)
+		return 0.0f;
+	return gProf.frameTimes[Frame % PROFILE_HISTORY];
+}
+
+TArray<profZone_t> &Profiler::GetFrameZones()
+{
+	return gProf.frameZones;
+}
+
+TArray<profZone_t> &Profiler::GetGpuZones()
+{
+	return gProf.gpuZones;
+}
+
+uint Profiler::GetNumCounters()
+{
+	return gProf.numCounters.load(std::memory_order_acquire);
+}
+
+const profCounter_t &Profiler::GetCounter(uint Index)
+{
+	return gCounters[Index];
+}
+
+const char *Profiler::GetThreadName(uint32_t Thread)
+{
+	if (Thread == PROFILE_GPU_THREAD)
+		return "GPU";
+
+	auto pRing = (Thread < PROFILE_MAX_THREADS) ? gProf.rings[Thread].load(std::memory_order_acquire) : nullptr;
+	auto pName = pRing ? pRing->pName.load(std::memory_order_relaxed) : nullptr;
+	return pName ? pName : "Thread";
+}
+
+uint Profiler::GetNumDroppedZones()
+{
+	return gProf.numDropped;
+}
+
+#endif // PROFILE_ENABLED
@@ -0,0 +1,147 @@
+#if !defined(_ENGINE_PROFILER_H_)
+#define _ENGINE_PROFILER_H_
+
+#include <pch.h>
+#include <Stl/Container.h>
+
+#include <atomic>
+
+// Instrumentation.
+// - CPU zones are scopes. A thread writes each finished zone into its own ring (one producer, one consumer,
+//   no locks); Profiler::EndFrame() on the main thread drains every ring. A full ring drops zones and counts them.
+// - GPU zones are timestamp pairs written by the Vulkan RHI and handed over with ReportGpuFrame() once the frame
+//   that recorded them has retired, so they show up a few frames late.
+// - Counters are named int64 values. Per-frame counters (draws, I/O bytes) are summed and reset by EndFrame();
+//   gauges hold their last value. Watched heaps and arenas are sampled by EndFrame() as gauges.
+// - A capture records everything between StartCapture() and StopCapture() as Chrome trace-event JSON
+//   (chrome://tracing or ui.perfetto.dev).
+// Names are never copied: pass string literals or anything else that outlives the profiler.
+// With PROFILE_ENABLED at 0 (Release) the macros expand to nothing and none of this is compiled.
+#if !defined(PROFILE_ENABLED)
+#	if defined(NDEBUG)
+#		define PROFILE_ENABLED 0
+#	else
+#		define PROFILE_ENABLED 1
+#	endif
+#endif
+
+#if PROFILE_ENABLED
+
+#define PROFILE_MAX_THREADS 64
+#define PROFILE_RING_SIZE 4096 // Zones a thread can finish between two EndFrame() calls.
+#define PROFILE_MAX_COUNTERS 64
+#define PROFILE_HISTORY 128    // Frames of frame times and counter values kept for the overlay.
+#define PROFILE_GPU_THREAD PROFILE_MAX_THREADS // Trace track the GPU zones go on.
+
+enum EProfCounterType
+{
+	eProfCounterPerFrame,
+	eProfCounterGauge,
+	eProfCounterBytes, // Gauge, shown as a size.
+};
+
+struct profZone_t
+{
+	const char *pName;
+	uint64_t begin; // Nanoseconds, Profiler::GetTime().
+	uint64_t end;
+	uint32_t thread;
+	uint32_t depth;
+};
+
+struct profCounter_t
+{
+	const char *pName;
+	EProfCounterType type;
+	std::atomic<int64_t> value;
+	void *pWatched; // dmHeap_t or dmRingArena_t sampled each frame, or null.
+	bool bHeap;
+	int64_t history[PROFILE_HISTORY]; // Value at the end of each frame, indexed by frame % PROFILE_HISTORY.
+};
+
+struct dmHeap_t;
+struct dmRingArena_t;
+
+namespace Profiler {
+	uint64_t GetTime();
+
+	// Names the calling thread in captures and the overlay.
+	void SetThreadName(const char *pName);
+
+	void PushZone(const char *pName, uint64_t Begin, uint64_t End, uint32_t Depth);
+	uint32_t EnterZone(); // Returns the depth for the zone being opened.
+	void LeaveZone();
+
+	// Replaces the GPU zones shown by the overlay. Times must already be on the GetTime() clock.
+	void ReportGpuFrame(const profZone_t *pZones, uint Num);
+
+	uint RegisterCounter(const char *pName, EProfCounterType Type);
+	void WatchHeap(const char *pName, dmHeap_t *pHeap);
+	void WatchArena(const char *pName, dmRingArena_t *pArena);
+	void Unwatch(const void *pWatched);
+
+	void EndFrame();
+
+	void StartCapture();
+	bool StopCapture(const TCHAR *Path);
+	bool IsCapturing();
+
+	// -- Read back for the overlay. Main thread; valid until the next EndFrame().
+	uint64_t GetFrameNumber(); // Frames ended so far.
+	float GetFrameTime(uint64_t Frame); // Milliseconds, 0 for frames that fell out of the history.
+	TArray<profZone_t> &GetFrameZones(); // CPU zones finished during the last frame.
+	TArray<profZone_t> &GetGpuZones();   // GPU zones of the most recent frame the RHI resolved.
+	uint GetNumCounters();
+	const profCounter_t &GetCounter(uint Index);
+	const char *GetThreadName(uint32_t Thread);
+	uint GetNumDroppedZones();
+
+	extern profCounter_t gCounters[PROFILE_MAX_COUNTERS];
+	inline void CounterAdd(uint Id, int64_t Value) { gCounters[Id].value.fetch_add(Value, std::memory_order_relaxed); }
+	inline void CounterSet(uint Id, int64_t Value) { gCounters[Id].value.store(Value, std::memory_order_relaxed); }
+}
+
+struct profZoneScope_t
+{
+	profZoneScope_t(const char *pName) : m_pName(pName), m_depth(Profiler::EnterZone()), m_begin(Profiler::GetTime()) {}
+	~profZoneScope_t()
+	{
+		Profiler::PushZone(m_pName, m_begin, Profiler::GetTime(), m_depth);
+		Profiler::LeaveZone();
+	}
+
+	const char *m_pName;
+	uint32_t m_depth;
+	uint64_t m_begin;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_ZONE(Name) profZoneScope_t PROFILE_CONCAT(profZone, __LINE__)(Name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD(Name) Profiler::SetThreadName(Name)
+#define PROFILE_END_FRAME() Profiler::EndFrame()
+
+// The counter id is looked up once per call site.
+#define PROFILE_COUNTER_ADD(Name, Value) do { static uint s_counterId = Profiler::RegisterCounter(Name, eProfCounterPerFrame); Profiler::CounterAdd(s_counterId, (int64_t)(Value)); } while (0)
+#define PROFILE_COUNTER_SET(Name, Value) do { static uint s_counterId = Profiler::RegisterCounter(Name, eProfCounterGauge); Profiler::CounterSet(s_counterId, (int64_t)(Value)); } while (0)
+#define PROFILE_WATCH_HEAP(Name, pHeap) Profiler::WatchHeap(Name, pHeap)
+#define PROFILE_WATCH_ARENA(Name, pArena) Profiler::WatchArena(Name, pArena)
+#define PROFILE_UNWATCH(p) Profiler::Unwatch(p)
+
+#else
+
+#define PROFILE_ZONE(Name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(Name)
+#define PROFILE_END_FRAME()
+#define PROFILE_COUNTER_ADD(Name, Value)
+#define PROFILE_COUNTER_SET(Name, Value)
+#define PROFILE_WATCH_HEAP(Name, pHeap)
+#define PROFILE_WATCH_ARENA(Name, pArena)
+#define PROFILE_UNWATCH(p)
+
+#endif // PROFILE_ENABLED
+
+#endif // _ENGINE_PROFILER_H_
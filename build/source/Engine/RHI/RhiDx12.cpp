@@ -21,7 +21,7 @@ SRhiState *GetRhiState() {
 
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-bool RHI::Initialize(bool bValidate)
+bool RHI::Initialize(bool bValidate, uint NumFramesInFlight, bool bHeadless)
 {
 #ifdef _DEBUG
 	if (bValidate) {
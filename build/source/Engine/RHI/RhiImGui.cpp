@@ -0,0 +1,428 @@
+#include "pch.h"
+#include "Engine/DebugLog.h"
+#include "Engine/Profiler.h"
+#include "Engine/RHI/RhiVulkan.h"
+
+#include <imgui/imgui.h>
+
+struct SImGuiBuffer
+{
+	VkBuffer Buffer;
+	VkDeviceMemory Memory;
+	void *pMapped;
+	size_t Size;
+};
+
+struct SImGuiRenderer
+{
+	VkDescriptorSetLayout SetLayout;
+	VkPipelineLayout PipelineLayout;
+	VkDescriptorPool DescriptorPool;
+	VkSampler Sampler;
+
+	VkImage FontImage;
+	VkDeviceMemory FontMemory;
+	VkImageView FontView;
+	VkDescriptorSet FontSet;
+
+	RHI::pipelineHandle_t Pipeline;
+
+	// Host visible and mapped for good; one pair per frame slot so the CPU never writes what the GPU reads.
+	SImGuiBuffer Vertices[RHI_MAX_FRAMES_IN_FLIGHT];
+	SImGuiBuffer Indices[RHI_MAX_FRAMES_IN_FLIGHT];
+};
+
+static SImGuiRenderer gImGui = {};
+
+static uint32_t FindMemoryType(uint32_t TypeBits, VkMemoryPropertyFlags Flags)
+{
+	VkPhysicalDeviceMemoryProperties memoryProps;
+	vkGetPhysicalDeviceMemoryProperties(RHI::gRhi->Adapter, &memoryProps);
+
+	for (uint32_t i = 0; i != memoryProps.memoryTypeCount; ++i) {
+		if ((TypeBits & (1u << i)) && (memoryProps.memoryTypes[i].propertyFlags & Flags) == Flags)
+			return i;
+	}
+	return UINT32_MAX;
+}
+
+static bool CreateBuffer(size_t Size, VkBufferUsageFlags Usage, SImGuiBuffer *pOut)
+{
+	auto device = RHI::gRhi->Device;
+	ZeroThat(pOut);
+
+	VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.size = Size;
+	bufferInfo.usage = Usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &pOut->Buffer) != VK_SUCCESS)
+		return false;
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, pOut->Buffer, &requirements);
+
+	VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX || vkAllocateMemory(device, &allocInfo, nullptr, &pOut->Memory) != VK_SUCCESS) {
+		vkDestroyBuffer(device, pOut->Buffer, nullptr);
+		ZeroThat(pOut);
+		return false;
+	}
+
+	vkBindBufferMemory(device, pOut->Buffer, pOut->Memory, 0);
+	vkMapMemory(device, pOut->Memory, 0, VK_WHOLE_SIZE, 0, &pOut->pMapped);
+	pOut->Size = Size;
+	return true;
+}
+
+// Freeing the memory unmaps it.
+static void ReleaseBuffer(SImGuiBuffer *pBuffer, bool bDeferred)
+{
+	if (bDeferred) {
+		RHI::DeferRelease(VK_OBJECT_TYPE_BUFFER, pBuffer->Buffer);
+		RHI::DeferRelease(VK_OBJECT_TYPE_DEVICE_MEMORY, pBuffer->Memory);
+	} else {
+		vkDestroyBuffer(RHI::gRhi->Device, pBuffer->Buffer, nullptr);
+		vkFreeMemory(RHI::gRhi->Device, pBuffer->Memory, nullptr);
+	}
+	ZeroThat(pBuffer);
+}
+
+// Grows by half again so a UI that grows slowly doesn't reallocate every frame.
+static bool EnsureBuffer(SImGuiBuffer *pBuffer, size_t Size, VkBufferUsageFlags Usage)
+{
+	if (pBuffer->Size >= Size)
+		return true;
+	if (pBuffer->Buffer)
+		ReleaseBuffer(pBuffer, true);
+	return CreateBuffer(Size + Size / 2, Usage, pBuffer);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Staged through a host visible buffer and copied on a one-off command buffer; start-up only, so it just waits.
+static bool CreateFontTexture()
+{
+	auto device = RHI::gRhi->Device;
+
+	unsigned char *pPixels;
+	int width, height;
+	ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pPixels, &width, &height);
+	size_t size = (size_t)width * (size_t)height * 4;
+
+	VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = { (uint32_t)width, (uint32_t)height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, nullptr, &gImGui.FontImage) != VK_SUCCESS)
+		return false;
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, gImGui.FontImage, &requirements);
+
+	VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX || vkAllocateMemory(device, &allocInfo, nullptr, &gImGui.FontMemory) != VK_SUCCESS)
+		return false;
+	vkBindImageMemory(device, gImGui.FontImage, gImGui.FontMemory, 0);
+
+	VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+	viewInfo.image = gImGui.FontImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+	if (vkCreateImageView(device, &viewInfo, nullptr, &gImGui.FontView) != VK_SUCCESS)
+		return false;
+
+	SImGuiBuffer staging;
+	if (!CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &staging))
+		return false;
+	memcpy(staging.pMapped, pPixels, size);
+
+	VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	poolInfo.queueFamilyIndex = RHI::gRhi->QueueFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	VkCommandPool pool;
+	vkCreateCommandPool(device, &poolInfo, nullptr, &pool);
+
+	VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	cmdInfo.commandPool = pool;
+	cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmdInfo.commandBufferCount = 1;
+	VkCommandBuffer cmd;
+	vkAllocateCommandBuffers(device, &cmdInfo, &cmd);
+
+	VkCommandBufferBeginInfo cmdBegin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	cmdBegin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cmd, &cmdBegin);
+
+	VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = gImGui.FontImage;
+	barrier.subresourceRange = viewInfo.subresourceRange;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = imageInfo.extent;
+	vkCmdCopyBufferToImage(cmd, staging.Buffer, gImGui.FontImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkEndCommandBuffer(cmd);
+
+	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+	vkQueueSubmit(RHI::gRhi->MainQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(RHI::gRhi->MainQueue);
+
+	vkDestroyCommandPool(device, pool, nullptr);
+	ReleaseBuffer(&staging, false);
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RHI::InitializeImGui()
+{
+	auto device = gRhi->Device;
+	ZeroThat(&gImGui);
+
+	// -- Descriptors: one combined image sampler per texture ImGui is given, the font being the first.
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+	setLayoutInfo.bindingCount = 1;
+	setLayoutInfo.pBindings = &binding;
+	vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &gImGui.SetLayout);
+
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16 };
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	descriptorPoolInfo.maxSets = 16;
+	descriptorPoolInfo.poolSizeCount = 1;
+	descriptorPoolInfo.pPoolSizes = &poolSize;
+	vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &gImGui.DescriptorPool);
+
+	VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 1.0f;
+	vkCreateSampler(device, &samplerInfo, nullptr, &gImGui.Sampler);
+
+	// -- Scale and translate from ImGui's pixel space to clip space.
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushRange.size = sizeof(float) * 4;
+
+	VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &gImGui.SetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	vkCreatePipelineLayout(device, &layoutInfo, nullptr, &gImGui.PipelineLayout);
+
+	if (!CreateFontTexture()) {
+		ReleaseImGui();
+		return false;
+	}
+
+	VkDescriptorSetAllocateInfo setInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	setInfo.descriptorPool = gImGui.DescriptorPool;
+	setInfo.descriptorSetCount = 1;
+	setInfo.pSetLayouts = &gImGui.SetLayout;
+	vkAllocateDescriptorSets(device, &setInfo, &gImGui.FontSet);
+
+	VkDescriptorImageInfo fontInfo = {};
+	fontInfo.sampler = gImGui.Sampler;
+	fontInfo.imageView = gImGui.FontView;
+	fontInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+	write.dstSet = gImGui.FontSet;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &fontInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	ImGui::GetIO().Fonts->SetTexID((ImTextureID)gImGui.FontSet);
+
+	// -- Pipeline.
+	SGraphicsPipelineDesc pipelineDesc = {};
+	pipelineDesc.VertexShader = "ImGui.spv";
+	pipelineDesc.FragmentShader = "ImGuiTex.spv";
+	pipelineDesc.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	pipelineDesc.PolygonMode = VK_POLYGON_MODE_FILL;
+	pipelineDesc.CullMode = VK_CULL_MODE_NONE;
+	pipelineDesc.FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	pipelineDesc.bBlend = true;
+	pipelineDesc.VertexStride = sizeof(ImDrawVert);
+	pipelineDesc.NumVertexAttributes = 3;
+	pipelineDesc.VertexAttributes[0] = { 0, 0, VK_FORMAT_R32G32_SFLOAT, (uint32_t)offsetof(ImDrawVert, pos) };
+	pipelineDesc.VertexAttributes[1] = { 1, 0, VK_FORMAT_R32G32_SFLOAT, (uint32_t)offsetof(ImDrawVert, uv) };
+	pipelineDesc.VertexAttributes[2] = { 2, 0, VK_FORMAT_R8G8B8A8_UNORM, (uint32_t)offsetof(ImDrawVert, col) };
+	pipelineDesc.Layout = gImGui.PipelineLayout;
+	pipelineDesc.RenderPass = gRhi->RenderPass;
+	gImGui.Pipeline = RequestPipeline(pipelineDesc);
+
+	return gImGui.Pipeline != 0;
+}
+
+void RHI::ReleaseImGui()
+{
+	auto device = gRhi->Device;
+	RHI::WaitForRendering();
+
+	for (uint i = 0; i != RHI_MAX_FRAMES_IN_FLIGHT; ++i) {
+		if (gImGui.Vertices[i].Buffer)
+			ReleaseBuffer(&gImGui.Vertices[i], false);
+		if (gImGui.Indices[i].Buffer)
+			ReleaseBuffer(&gImGui.Indices[i], false);
+	}
+
+	// The pipeline belongs to the pipeline system and goes with it.
+	vkDestroyImageView(device, gImGui.FontView, nullptr);
+	vkDestroyImage(device, gImGui.FontImage, nullptr);
+	vkFreeMemory(device, gImGui.FontMemory, nullptr);
+	vkDestroySampler(device, gImGui.Sampler, nullptr);
+	vkDestroyDescriptorPool(device, gImGui.DescriptorPool, nullptr);
+	vkDestroyPipelineLayout(device, gImGui.PipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, gImGui.SetLayout, nullptr);
+	ZeroThat(&gImGui);
+}
+
+void RHI::RenderImGui(VkCommandBuffer Cmd, ImDrawData *pDrawData)
+{
+	PROFILE_ZONE("RHI::RenderImGui");
+
+	if (!pDrawData || pDrawData->TotalVtxCount == 0)
+		return;
+
+	uint32_t fbWidth = (uint32_t)(pDrawData->DisplaySize.x * pDrawData->FramebufferScale.x);
+	uint32_t fbHeight = (uint32_t)(pDrawData->DisplaySize.y * pDrawData->FramebufferScale.y);
+	if (fbWidth == 0 || fbHeight == 0)
+		return;
+
+	VkPipeline pipeline = GetPipeline(gImGui.Pipeline);
+	if (!pipeline)
+		return;
+
+	// -- Upload this frame's geometry into the slot's buffers.
+	uint slot = (uint)(gRhi->FrameNumber % gRhi->NumFramesInFlight);
+	auto &vertices = gImGui.Vertices[slot];
+	auto &indices = gImGui.Indices[slot];
+	if (!EnsureBuffer(&vertices, pDrawData->TotalVtxCount * sizeof(ImDrawVert), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) ||
+		!EnsureBuffer(&indices, pDrawData->TotalIdxCount * sizeof(ImDrawIdx), VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+		return;
+
+	auto pVertexDst = (ImDrawVert *)vertices.pMapped;
+	auto pIndexDst = (ImDrawIdx *)indices.pMapped;
+	for (int i = 0; i != pDrawData->CmdListsCount; ++i) {
+		auto pList = pDrawData->CmdLists[i];
+		memcpy(pVertexDst, pList->VtxBuffer.Data, pList->VtxBuffer.Size * sizeof(ImDrawVert));
+		memcpy(pIndexDst, pList->IdxBuffer.Data, pList->IdxBuffer.Size * sizeof(ImDrawIdx));
+		pVertexDst += pList->VtxBuffer.Size;
+		pIndexDst += pList->IdxBuffer.Size;
+	}
+
+	// -- State.
+	vkCmdBindPipeline(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(Cmd, 0, 1, &vertices.Buffer, &offset);
+	vkCmdBindIndexBuffer(Cmd, indices.Buffer, 0, sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+	VkViewport viewport = {};
+	viewport.width = (float)fbWidth;
+	viewport.height = (float)fbHeight;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(Cmd, 0, 1, &viewport);
+
+	float transform[4];
+	transform[0] = 2.0f / pDrawData->DisplaySize.x;
+	transform[1] = 2.0f / pDrawData->DisplaySize.y;
+	transform[2] = -1.0f - pDrawData->DisplayPos.x * transform[0];
+	transform[3] = -1.0f - pDrawData->DisplayPos.y * transform[1];
+	vkCmdPushConstants(Cmd, gImGui.PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(transform), transform);
+
+	// -- Draws. Clip rects are in ImGui's space and become scissors in framebuffer pixels.
+	ImVec2 clipOffset = pDrawData->DisplayPos;
+	ImVec2 clipScale = pDrawData->FramebufferScale;
+	ImTextureID boundTexture = nullptr;
+	uint numDraws = 0;
+	uint vertexBase = 0;
+	uint indexBase = 0;
+
+	for (int i = 0; i != pDrawData->CmdListsCount; ++i) {
+		auto pList = pDrawData->CmdLists[i];
+		for (int c = 0; c != pList->CmdBuffer.Size; ++c) {
+			auto &drawCmd = pList->CmdBuffer[c];
+			if (drawCmd.UserCallback) {
+				if (drawCmd.UserCallback != ImDrawCallback_ResetRenderState)
+					drawCmd.UserCallback(pList, &drawCmd);
+				continue;
+			}
+
+			float minX = (drawCmd.ClipRect.x - clipOffset.x) * clipScale.x;
+			float minY = (drawCmd.ClipRect.y - clipOffset.y) * clipScale.y;
+			float maxX = (drawCmd.ClipRect.z - clipOffset.x) * clipScale.x;
+			float maxY = (drawCmd.ClipRect.w - clipOffset.y) * clipScale.y;
+			if (minX < 0.0f)
+				minX = 0.0f;
+			if (minY < 0.0f)
+				minY = 0.0f;
+			if (maxX > (float)fbWidth)
+				maxX = (float)fbWidth;
+			if (maxY > (float)fbHeight)
+				maxY = (float)fbHeight;
+			if (maxX <= minX || maxY <= minY)
+				continue;
+
+			VkRect2D scissor;
+			scissor.offset = { (int32_t)minX, (int32_t)minY };
+			scissor.extent = { (uint32_t)(maxX - minX), (uint32_t)(maxY - minY) };
+			vkCmdSetScissor(Cmd, 0, 1, &scissor);
+
+			ImTextureID texture = drawCmd.GetTexID();
+			if (texture != boundTexture) {
+				VkDescriptorSet set = (VkDescriptorSet)texture;
+				vkCmdBindDescriptorSets(Cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gImGui.PipelineLayout, 0, 1, &set, 0, nullptr);
+				boundTexture = texture;
+			}
+
+			vkCmdDrawIndexed(Cmd, drawCmd.ElemCount, 1, drawCmd.IdxOffset + indexBase, (int32_t)(drawCmd.VtxOffset + vertexBase), 0);
+			++numDraws;
+		}
+		vertexBase += pList->VtxBuffer.Size;
+		indexBase += pList->IdxBuffer.Size;
+	}
+
+	PROFILE_COUNTER_ADD("Draws", numDraws);
+}
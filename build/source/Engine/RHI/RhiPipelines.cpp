@@ -0,0 +1,615 @@
+#include "pch.h"
+#include "Engine/DebugLog.h"
+#include "Engine/Archive.h"
+#include "Engine/FileIO.h"
+#include "Engine/JobSystem.h"
+#include "Engine/RHI/RhiVulkan.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+
+#define PIPELINE_CACHE_MAGIC 0x48435050 // 'PPCH'
+#define PIPELINE_CACHE_VERSION 1
+#define SHADER_POLL_MS 250.0 // Write times are a syscall per shader; checking a few times a second is plenty.
+
+// Written in front of the driver's blob. Drivers check their own header as well, but not all of them cope
+// gracefully with a blob from another GPU, so nothing reaches vkCreatePipelineCache unless this matches.
+struct pipelineCacheHeader_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint32_t reserved;
+	uint8_t deviceUUID[VK_UUID_SIZE];
+	uint8_t cacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
+
+struct SShader
+{
+	uint64_t Hash; // ArchiveHashPath of the name, so it doubles as the archive key.
+	char Name[64];
+	VkShaderModule Module; // Null until the first compile that needs it has created it.
+	ioHandle_t Read;       // Loose file read queued by RequestPipeline() that no compile has picked up yet.
+	uint64 WriteTime;      // Loose files only.
+};
+
+struct SPipeline
+{
+	uint64_t Hash;
+	RHI::SGraphicsPipelineDesc Desc; // Shader names point into the shader table.
+	uint Shaders[2];
+	VkPipeline Pipeline; // The one handed out.
+	VkPipeline Built;    // Written by the compile job; claimed once 'Compiling' is done.
+	bool bRebuilding;
+	double CompileMs;
+	jobCounter_t Compiling;
+};
+
+struct SPipelineState
+{
+	TString<TCHAR> CachePath;
+	archive_t ShaderPak;
+	RHI::SPipelineStats Stats;
+	uint NumShaders;
+	uint NumPipelines;
+	std::chrono::steady_clock::time_point LastShaderPoll;
+	std::mutex ShaderLock; // Compile jobs turning reads into modules.
+	SShader Shaders[RHI_MAX_SHADERS];
+	SPipeline Pipelines[RHI_MAX_PIPELINES];
+};
+
+static SPipelineState *gPipelines = nullptr;
+
+static inline double MillisecondsSince(std::chrono::steady_clock::time_point Start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+static uint64_t HashBytes(const void *pData, size_t Size)
+{
+	auto p = (const uint8 *)pData;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i != Size; ++i) {
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Everything that ends up in the VkGraphicsPipelineCreateInfo, shaders by name.
+static uint64_t HashDesc(const RHI::SGraphicsPipelineDesc &Desc)
+{
+	uint64_t state[12 + RHI_MAX_VERTEX_ATTRIBUTES * 3] = {
+		ArchiveHashPath(Desc.VertexShader, TStrlen(Desc.VertexShader)),
+		ArchiveHashPath(Desc.FragmentShader, TStrlen(Desc.FragmentShader)),
+		(uint64_t)Desc.Topology,
+		(uint64_t)Desc.PolygonMode,
+		(uint64_t)Desc.CullMode,
+		(uint64_t)Desc.FrontFace,
+		(uint64_t)Desc.bBlend,
+		(uint64_t)Desc.Layout,
+		(uint64_t)Desc.RenderPass,
+		(uint64_t)Desc.Subpass,
+		(uint64_t)Desc.VertexStride,
+		(uint64_t)Desc.NumVertexAttributes,
+	};
+
+	for (uint i = 0; i != Desc.NumVertexAttributes; ++i) {
+		state[12 + i * 3 + 0] = Desc.VertexAttributes[i].location;
+		state[12 + i * 3 + 1] = Desc.VertexAttributes[i].format;
+		state[12 + i * 3 + 2] = Desc.VertexAttributes[i].offset;
+	}
+	return HashBytes(state, sizeof(state));
+}
+
+static void FillCacheHeader(pipelineCacheHeader_t *pHeader)
+{
+	VkPhysicalDeviceIDProperties idProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+	VkPhysicalDeviceProperties2 props = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+	props.pNext = &idProps;
+	vkGetPhysicalDeviceProperties2(RHI::gRhi->Adapter, &props);
+
+	ZeroThat(pHeader);
+	pHeader->magic = PIPELINE_CACHE_MAGIC;
+	pHeader->version = PIPELINE_CACHE_VERSION;
+	pHeader->vendorID = props.properties.vendorID;
+	pHeader->deviceID = props.properties.deviceID;
+	pHeader->driverVersion = props.properties.driverVersion;
+	memcpy(pHeader->deviceUUID, idProps.deviceUUID, VK_UUID_SIZE);
+	memcpy(pHeader->cacheUUID, props.properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+static bool IsCacheBlobValid(const fileBlob_t &Blob)
+{
+	if (Blob.Size < sizeof(pipelineCacheHeader_t))
+		return false;
+
+	pipelineCacheHeader_t expected;
+	FillCacheHeader(&expected);
+
+	auto pHeader = (const pipelineCacheHeader_t *)Blob.pBuffer;
+	if (pHeader->magic != expected.magic || pHeader->version != expected.version ||
+		pHeader->vendorID != expected.vendorID || pHeader->deviceID != expected.deviceID ||
+		pHeader->driverVersion != expected.driverVersion ||
+		memcmp(pHeader->deviceUUID, expected.deviceUUID, VK_UUID_SIZE) ||
+		memcmp(pHeader->cacheUUID, expected.cacheUUID, VK_UUID_SIZE))
+		return false;
+
+	// Catches torn writes from a crash mid-save.
+	if (pHeader->dataSize != Blob.Size - sizeof(pipelineCacheHeader_t))
+		return false;
+	return pHeader->dataHash == HashBytes(pHeader + 1, (size_t)pHeader->dataSize);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void GetShaderPath(const char *Name, TString<TCHAR> *pOut)
+{
+	*pOut = STR("data\\cso\\");
+	uint base = pOut->Length();
+	uint length = TStrlen(Name);
+	pOut->Resize(base + length);
+	for (uint i = 0; i != length; ++i)
+		(*pOut)[base + i] = (TCHAR)Name[i];
+}
+
+// Replaces pShader->Module only on success, so a half-written file during a reload leaves the old one in place.
+static bool CreateShaderModule(SShader *pShader, const void *pCode, size_t Size)
+{
+	if (!Size || (Size % sizeof(uint32_t)) != 0)
+		return false;
+
+	VkShaderModuleCreateInfo moduleInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+	moduleInfo.codeSize = Size;
+	moduleInfo.pCode = (const uint32_t *)pCode;
+
+	VkShaderModule module = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(RHI::gRhi->Device, &moduleInfo, nullptr, &module) != VK_SUCCESS)
+		return false;
+	pShader->Module = module;
+	return true;
+}
+
+// Blocking load, for archived shaders (already mapped), reloads and retries after a failed read.
+static bool LoadShaderModule(SShader *pShader)
+{
+	if (gPipelines->ShaderPak.IsOpen()) {
+		archiveData_t data = {};
+		if (!gPipelines->ShaderPak.Load(gPipelines->ShaderPak.Find(pShader->Hash), &data))
+			return false;
+
+		bool bOk = CreateShaderModule(pShader, data.pData, data.Size);
+		data.Release();
+		return bOk;
+	}
+
+	TString<TCHAR> path;
+	GetShaderPath(pShader->Name, &path);
+
+	// Time first: a write that lands during the read shows up as another change.
+	uint64 writeTime = 0;
+	fileBlob_t blob = {};
+	if (!QueryFileWriteTime(path, &writeTime) || !ReadEntireFile(path, &blob))
+		return false;
+
+	bool bOk = CreateShaderModule(pShader, blob.pBuffer, blob.Size);
+	blob.Release();
+	if (bOk)
+		pShader->WriteTime = writeTime;
+	return bOk;
+}
+
+// Registers a shader the first time it's seen. When it's a loose file, 'pPath' gets the file for the caller
+// to queue a read of; it stays empty for archived and known shaders.
+static uint FindOrAddShader(const char *Name, TString<TCHAR> *pPath)
+{
+	uint64_t hash = ArchiveHashPath(Name, TStrlen(Name));
+	for (uint i = 0; i != gPipelines->NumShaders; ++i) {
+		if (gPipelines->Shaders[i].Hash == hash)
+			return i;
+	}
+
+	ASSERT(gPipelines->NumShaders < RHI_MAX_SHADERS);
+	ASSERT(TStrlen(Name) < sizeof(SShader::Name));
+	auto &shader = gPipelines->Shaders[gPipelines->NumShaders];
+	ZeroThat(&shader);
+	shader.Hash = hash;
+	strncpy(shader.Name, Name, sizeof(shader.Name) - 1);
+
+	// Time first, as in LoadShaderModule(). A missing file gets no read; the compile reports it.
+	if (!gPipelines->ShaderPak.IsOpen()) {
+		GetShaderPath(Name, pPath);
+		if (!QueryFileWriteTime(*pPath, &shader.WriteTime))
+			pPath->Free();
+	}
+	return gPipelines->NumShaders++;
+}
+
+// Runs on compile jobs. The first compile to need a shader waits for its read and creates the module; the
+// lock is held across that wait, but the rest of the batch is in flight meanwhile. A shader that failed to
+// load is tried again, blocking, by the next compile that uses it.
+static VkShaderModule AcquireShaderModule(uint Index)
+{
+	auto &shader = gPipelines->Shaders[Index];
+	std::lock_guard<std::mutex> lock(gPipelines->ShaderLock);
+	if (shader.Module)
+		return shader.Module;
+
+	bool bLoaded;
+	if (shader.Read) {
+		fileBlob_t blob;
+		bLoaded = IO::Wait(shader.Read, &blob) && CreateShaderModule(&shader, blob.pBuffer, blob.Size);
+		blob.Release();
+		shader.Read = 0;
+	} else {
+		bLoaded = LoadShaderModule(&shader);
+	}
+
+	if (!bLoaded)
+		printf("[RHI] Couldn't load shader '%s'.\n", shader.Name);
+	return shader.Module;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void CompilePipelineJob(void *pData)
+{
+	auto pPipeline = (SPipeline *)pData;
+	auto &desc = pPipeline->Desc;
+	auto start = std::chrono::steady_clock::now();
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {
+		{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO },
+		{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO }
+	};
+
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = AcquireShaderModule(pPipeline->Shaders[0]);
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = AcquireShaderModule(pPipeline->Shaders[1]);
+	shaderStages[1].pName = "main";
+
+	VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+	VkVertexInputBindingDescription vertexBinding = {};
+	VkVertexInputAttributeDescription vertexAttributes[RHI_MAX_VERTEX_ATTRIBUTES];
+	if (desc.VertexStride) {
+		vertexBinding.stride = desc.VertexStride;
+		vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		for (uint i = 0; i != desc.NumVertexAttributes; ++i) {
+			vertexAttributes[i] = desc.VertexAttributes[i];
+			vertexAttributes[i].binding = 0;
+		}
+		vertexInput.vertexBindingDescriptionCount = 1;
+		vertexInput.pVertexBindingDescriptions = &vertexBinding;
+		vertexInput.vertexAttributeDescriptionCount = desc.NumVertexAttributes;
+		vertexInput.pVertexAttributeDescriptions = vertexAttributes;
+	}
+
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+	assemblyInfo.topology = desc.Topology;
+
+	VkPipelineViewportStateCreateInfo viewportInfo = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+	viewportInfo.viewportCount = 1;
+	viewportInfo.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+	rasterizer.polygonMode = desc.PolygonMode;
+	rasterizer.cullMode = desc.CullMode;
+	rasterizer.frontFace = desc.FrontFace;
+	rasterizer.lineWidth = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlend = {};
+	colorBlend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	if (desc.bBlend) {
+		colorBlend.blendEnable = VK_TRUE;
+		colorBlend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlend.colorBlendOp = VK_BLEND_OP_ADD;
+		colorBlend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlend.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+
+	VkPipelineColorBlendStateCreateInfo blendInfo = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+	blendInfo.attachmentCount = 1;
+	blendInfo.pAttachments = &colorBlend;
+	blendInfo.logicOp = VK_LOGIC_OP_COPY;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInput;
+	pipelineInfo.pInputAssemblyState = &assemblyInfo;
+	pipelineInfo.pViewportState = &viewportInfo;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pColorBlendState = &blendInfo;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.layout = desc.Layout;
+	pipelineInfo.renderPass = desc.RenderPass;
+	pipelineInfo.subpass = desc.Subpass;
+	pipelineInfo.basePipelineIndex = -1;
+
+	// The cache is internally synchronised, so every compile job can share it.
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (!shaderStages[0].module || !shaderStages[1].module ||
+		vkCreateGraphicsPipelines(RHI::gRhi->Device, RHI::gRhi->PipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		pipeline = VK_NULL_HANDLE;
+
+	pPipeline->Built = pipeline;
+	pPipeline->CompileMs += MillisecondsSince(start);
+}
+
+// Takes the compile job's result once it's done. Returns true if it replaced a pipeline that had been handed out.
+static bool ClaimBuilt(SPipeline *pPipeline)
+{
+	if (!pPipeline->Compiling.IsDone())
+		return false;
+
+	bool bWasRebuild = pPipeline->bRebuilding;
+	pPipeline->bRebuilding = false;
+	if (!pPipeline->Built) {
+		if (bWasRebuild)
+			printf("[RHI] Rebuilding pipeline %016llx failed, keeping the old one.\n", (unsigned long long)pPipeline->Hash);
+		return false;
+	}
+
+	bool bReplaced = pPipeline->Pipeline != VK_NULL_HANDLE;
+	if (bReplaced)
+		RHI::DeferRelease(VK_OBJECT_TYPE_PIPELINE, pPipeline->Pipeline);
+	pPipeline->Pipeline = pPipeline->Built;
+	pPipeline->Built = VK_NULL_HANDLE;
+	return bReplaced;
+}
+
+static bool IsShaderInUseByCompile(uint ShaderIndex)
+{
+	for (uint i = 0; i != gPipelines->NumPipelines; ++i) {
+		auto &pipeline = gPipelines->Pipelines[i];
+		if ((pipeline.Shaders[0] == ShaderIndex || pipeline.Shaders[1] == ShaderIndex) && !pipeline.Compiling.IsDone())
+			return true;
+	}
+	return false;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RHI::InitializePipelines(const TCHAR *CachePath)
+{
+	ASSERT(!gPipelines);
+	gPipelines = new SPipelineState();
+	gPipelines->CachePath = CachePath;
+	gPipelines->ShaderPak.Open(STR("data\\cso.pak"));
+
+	auto start = std::chrono::steady_clock::now();
+
+	VkPipelineCacheCreateInfo cacheInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	fileBlob_t blob = {};
+	if (ReadEntireFile(CachePath, &blob)) {
+		if (IsCacheBlobValid(blob)) {
+			auto pHeader = (const pipelineCacheHeader_t *)blob.pBuffer;
+			cacheInfo.initialDataSize = (size_t)pHeader->dataSize;
+			cacheInfo.pInitialData = pHeader + 1;
+		} else {
+			printf("[RHI] Pipeline cache was written by another device or driver, starting cold.\n");
+		}
+	}
+
+	auto hr = vkCreatePipelineCache(gRhi->Device, &cacheInfo, nullptr, &gRhi->PipelineCache);
+	if (hr != VK_SUCCESS && cacheInfo.initialDataSize) {
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		hr = vkCreatePipelineCache(gRhi->Device, &cacheInfo, nullptr, &gRhi->PipelineCache);
+	}
+
+	gPipelines->Stats.bWarmCache = cacheInfo.initialDataSize != 0;
+	gPipelines->Stats.CacheSize = cacheInfo.initialDataSize;
+	gPipelines->Stats.CacheLoadMs = MillisecondsSince(start);
+	blob.Release();
+
+	return hr == VK_SUCCESS;
+}
+
+void RHI::ReleasePipelines()
+{
+	if (!gPipelines)
+		return;
+
+	for (uint i = 0; i != gPipelines->NumPipelines; ++i) {
+		auto &pipeline = gPipelines->Pipelines[i];
+		Jobs::Wait(&pipeline.Compiling);
+		vkDestroyPipeline(gRhi->Device, pipeline.Built, nullptr);
+		vkDestroyPipeline(gRhi->Device, pipeline.Pipeline, nullptr);
+	}
+	for (uint i = 0; i != gPipelines->NumShaders; ++i) {
+		auto &shader = gPipelines->Shaders[i];
+		if (shader.Read) {
+			fileBlob_t blob;
+			IO::Wait(shader.Read, &blob);
+			blob.Release();
+		}
+		vkDestroyShaderModule(gRhi->Device, shader.Module, nullptr);
+	}
+
+	SavePipelineCache();
+	vkDestroyPipelineCache(gRhi->Device, gRhi->PipelineCache, nullptr);
+	gRhi->PipelineCache = VK_NULL_HANDLE;
+
+	gPipelines->ShaderPak.Close();
+	delete gPipelines;
+	gPipelines = nullptr;
+}
+
+bool RHI::SavePipelineCache()
+{
+	size_t size = 0;
+	if (vkGetPipelineCacheData(gRhi->Device, gRhi->PipelineCache, &size, nullptr) != VK_SUCCESS || !size)
+		return false;
+
+	auto pBlob = (uint8 *)malloc(sizeof(pipelineCacheHeader_t) + size);
+	auto pHeader = (pipelineCacheHeader_t *)pBlob;
+	bool bOk = vkGetPipelineCacheData(gRhi->Device, gRhi->PipelineCache, &size, pHeader + 1) == VK_SUCCESS;
+	if (bOk) {
+		FillCacheHeader(pHeader);
+		pHeader->dataSize = size;
+		pHeader->dataHash = HashBytes(pHeader + 1, size);
+		bOk = WriteEntireFile(gPipelines->CachePath, pBlob, sizeof(pipelineCacheHeader_t) + size);
+	}
+	free(pBlob);
+
+	if (bOk)
+		gPipelines->Stats.CacheSize = size;
+	return bOk;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RHI::pipelineHandle_t RHI::RequestPipeline(const SGraphicsPipelineDesc &Desc)
+{
+	uint64_t hash = HashDesc(Desc);
+	for (uint i = 0; i != gPipelines->NumPipelines; ++i) {
+		if (gPipelines->Pipelines[i].Hash == hash)
+			return i + 1;
+	}
+
+	// New loose shaders are read in one batch; the compile job turns them into modules once they land.
+	TString<TCHAR> paths[2];
+	uint shaders[2] = { FindOrAddShader(Desc.VertexShader, &paths[0]), FindOrAddShader(Desc.FragmentShader, &paths[1]) };
+
+	ioReadDesc_t reads[2] = {};
+	uint readShaders[2];
+	uint numReads = 0;
+	for (uint i = 0; i != 2; ++i) {
+		if (!paths[i].Length())
+			continue;
+		reads[numReads].Path = paths[i];
+		reads[numReads].Priority = eIoPriorityHigh;
+		readShaders[numReads++] = shaders[i];
+	}
+	if (numReads) {
+		ioHandle_t handles[2];
+		IO::ReadBatch(reads, numReads, handles);
+		for (uint i = 0; i != numReads; ++i)
+			gPipelines->Shaders[readShaders[i]].Read = handles[i];
+	}
+
+	ASSERT(gPipelines->NumPipelines < RHI_MAX_PIPELINES);
+	auto &pipeline = gPipelines->Pipelines[gPipelines->NumPipelines];
+	pipeline.Hash = hash;
+	pipeline.Desc = Desc;
+	pipeline.Desc.VertexShader = gPipelines->Shaders[shaders[0]].Name;
+	pipeline.Desc.FragmentShader = gPipelines->Shaders[shaders[1]].Name;
+	pipeline.Shaders[0] = shaders[0];
+	pipeline.Shaders[1] = shaders[1];
+
+	Jobs::Run(CompilePipelineJob, &pipeline, &pipeline.Compiling);
+	return ++gPipelines->NumPipelines;
+}
+
+bool RHI::IsPipelineReady(pipelineHandle_t Handle)
+{
+	if (Handle == 0 || Handle > gPipelines->NumPipelines)
+		return false;
+
+	auto &pipeline = gPipelines->Pipelines[Handle - 1];
+	return pipeline.Pipeline || pipeline.Compiling.IsDone();
+}
+
+VkPipeline RHI::GetPipeline(pipelineHandle_t Handle)
+{
+	if (Handle == 0 || Handle > gPipelines->NumPipelines)
+		return VK_NULL_HANDLE;
+
+	// A rebuild in progress keeps handing out the old pipeline; only a first use ever waits.
+	auto &pipeline = gPipelines->Pipelines[Handle - 1];
+	if (!pipeline.Pipeline) {
+		Jobs::Wait(&pipeline.Compiling);
+		ClaimBuilt(&pipeline);
+	}
+	return pipeline.Pipeline;
+}
+
+uint RHI::UpdatePipelines()
+{
+	uint numSwapped = 0;
+	for (uint i = 0; i != gPipelines->NumPipelines; ++i) {
+		if (ClaimBuilt(&gPipelines->Pipelines[i]))
+			++numSwapped;
+	}
+
+	// Archived shaders are baked; only loose files are watched.
+	if (gPipelines->ShaderPak.IsOpen())
+		return numSwapped;
+
+	if (MillisecondsSince(gPipelines->LastShaderPoll) < SHADER_POLL_MS)
+		return numSwapped;
+	gPipelines->LastShaderPoll = std::chrono::steady_clock::now();
+
+	TString<TCHAR> path;
+	for (uint i = 0; i != gPipelines->NumShaders; ++i) {
+		auto &shader = gPipelines->Shaders[i];
+		GetShaderPath(shader.Name, &path);
+
+		uint64 writeTime = 0;
+		if (!QueryFileWriteTime(path, &writeTime) || writeTime == shader.WriteTime)
+			continue;
+
+		// A compile may still be reading the module; pick the change up on a later call.
+		if (IsShaderInUseByCompile(i))
+			continue;
+
+		VkShaderModule oldModule = shader.Module;
+		if (!LoadShaderModule(&shader))
+			continue;
+		if (oldModule)
+			RHI::DeferRelease(VK_OBJECT_TYPE_SHADER_MODULE, oldModule);
+		printf("[RHI] Reloaded shader '%s'.\n", shader.Name);
+
+		for (uint j = 0; j != gPipelines->NumPipelines; ++j) {
+			auto &pipeline = gPipelines->Pipelines[j];
+			if (pipeline.Shaders[0] != i && pipeline.Shaders[1] != i)
+				continue;
+
+			// Don't let the rebuild overwrite a first build nobody has claimed yet.
+			ClaimBuilt(&pipeline);
+			pipeline.bRebuilding = true;
+			Jobs::Run(CompilePipelineJob, &pipeline, &pipeline.Compiling);
+		}
+	}
+
+	return numSwapped;
+}
+
+const RHI::SPipelineStats &RHI::GetPipelineStats()
+{
+	auto &stats = gPipelines->Stats;
+	stats.NumCompiled = 0;
+	stats.CompileMs = 0.0;
+	for (uint i = 0; i != gPipelines->NumPipelines; ++i) {
+		auto &pipeline = gPipelines->Pipelines[i];
+		if (!pipeline.Compiling.IsDone())
+			continue;
+		++stats.NumCompiled;
+		stats.CompileMs += pipeline.CompileMs;
+	}
+	return stats;
+}
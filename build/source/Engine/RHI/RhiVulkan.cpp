@@ -1,9 +1,12 @@
 #include "pch.h"
 #include "Engine/DebugLog.h"
 #include "Engine/FileIO.h"
-#include "Engine/Rhi/RhiVulkan.h"
+#include "Engine/JobSystem.h"
+#include "Engine/RHI/RhiVulkan.h"
 
+#ifdef PLATFORM_WIN64
 #include <Windows.h>
+#endif
 
 RHI::SRhiState _Vk = {};
 RHI::SRhiState *RHI::gRhi = &_Vk;
@@ -32,22 +35,75 @@ VkBool32 VulkanDebugMessengerCallback(VkDebugUtilsMessageSeverityFlagBitsEXT mes
 	return VK_FALSE;
 }
 
-bool RHI::Initialize(bool EnableDebugging)
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void DestroyDeferred(const RHI::SDeferredRelease &Release)
+{
+	auto device = pVk->Device;
+	switch (Release.Type) {
+	case VK_OBJECT_TYPE_BUFFER: vkDestroyBuffer(device, (VkBuffer)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_IMAGE: vkDestroyImage(device, (VkImage)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW: vkDestroyImageView(device, (VkImageView)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_SAMPLER: vkDestroySampler(device, (VkSampler)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER: vkDestroyFramebuffer(device, (VkFramebuffer)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_RENDER_PASS: vkDestroyRenderPass(device, (VkRenderPass)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_PIPELINE: vkDestroyPipeline(device, (VkPipeline)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_PIPELINE_LAYOUT: vkDestroyPipelineLayout(device, (VkPipelineLayout)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_SHADER_MODULE: vkDestroyShaderModule(device, (VkShaderModule)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_POOL: vkDestroyDescriptorPool(device, (VkDescriptorPool)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_SEMAPHORE: vkDestroySemaphore(device, (VkSemaphore)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_FENCE: vkDestroyFence(device, (VkFence)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_DEVICE_MEMORY: vkFreeMemory(device, (VkDeviceMemory)Release.Handle, nullptr); break;
+	case VK_OBJECT_TYPE_SWAPCHAIN_KHR: vkDestroySwapchainKHR(device, (VkSwapchainKHR)Release.Handle, nullptr); break;
+	default: ASSERT(!"Unhandled deferred release type"); break;
+	}
+}
+
+// Destroys everything in the slot's list that was queued on or before 'Completed'. A frame that was
+// skipped (failed acquire) leaves its entries for the next time the slot comes round.
+static void RunDeferredReleases(RHI::SRhiFrame *pFrame, uint64_t Completed)
 {
-	volkInitialize();
+	auto &releases = pFrame->Releases;
+	for (uint i = 0; i < releases.Getcount();) {
+		if (releases[i].Frame <= Completed) {
+			DestroyDeferred(releases[i]);
+			releases.RemoveSwap(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+bool RHI::Initialize(bool EnableDebugging, uint NumFramesInFlight, bool bHeadless)
+{
+	if (volkInitialize() != VK_SUCCESS) {
+		printf("[RHI] :: No Vulkan loader.\n");
+		return false;
+	}
+
+#ifndef PLATFORM_WIN64
+	bHeadless = true; // Window contexts are Win32 only so far.
+#endif
+	pVk->bHeadless = bHeadless;
 
 	const uint numInstanceLayers = 1;
 	const char *instanceLayers[numInstanceLayers] = {
 		"VK_LAYER_KHRONOS_validation",
 	};
 
-	// -- Create instance
-	const uint numInstanceExtensions = 3;
-	const char *instanceExtensions[numInstanceExtensions] = {
-		"VK_KHR_surface",
-		"VK_KHR_win32_surface",
-		"VK_EXT_debug_utils",
-	};
+	// -- Create instance. Headless needs no surface extensions, which software ICDs may not have.
+	uint numInstanceExtensions = 0;
+	const char *instanceExtensions[3];
+	if (!bHeadless) {
+		instanceExtensions[numInstanceExtensions++] = "VK_KHR_surface";
+#ifdef PLATFORM_WIN64
+		instanceExtensions[numInstanceExtensions++] = "VK_KHR_win32_surface";
+#endif
+	}
+#ifdef _DEBUG
+	if (EnableDebugging)
+		instanceExtensions[numInstanceExtensions++] = "VK_EXT_debug_utils";
+#endif
 
 	VkDebugUtilsMessengerCreateInfoEXT messengerInfo = { VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT };
 	messengerInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
@@ -111,6 +167,10 @@ bool RHI::Initialize(bool EnableDebugging)
 		}
 	}
 
+	// Nothing discrete (CI, software ICDs like lavapipe): take whatever is there.
+	if (!pVk->Adapter && numAdapters)
+		pVk->Adapter = pAdapters[0];
+
 	free(pAdapters);
 	ASSERT(pVk->Adapter);
 
@@ -122,22 +182,41 @@ bool RHI::Initialize(bool EnableDebugging)
 	auto pQueueFamilies = (VkQueueFamilyProperties *)malloc(numQueueFamilies * sizeof(VkQueueFamilyProperties));
 	vkGetPhysicalDeviceQueueFamilyProperties(pVk->Adapter, &numQueueFamilies, pQueueFamilies);
 
-	for (auto i = 0; i != numQueueFamilies; ++i) {
-		auto _GetPhysicalDeviceWin32PresentationSupport = (PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR)vkGetInstanceProcAddr(pVk->Instance, "vkGetPhysicalDeviceWin32PresentationSupportKHR");
-		ASSERT(_GetPhysicalDeviceWin32PresentationSupport);
 #ifdef PLATFORM_WIN64
-		VkBool32 presentationSupport = _GetPhysicalDeviceWin32PresentationSupport(pVk->Adapter, i);
+	if (!bHeadless) {
+		auto _GetPhysicalDeviceWin32PresentationSupport = (PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR)vkGetInstanceProcAddr(pVk->Instance, "vkGetPhysicalDeviceWin32PresentationSupportKHR");
+		for (auto i = 0; i != numQueueFamilies && _GetPhysicalDeviceWin32PresentationSupport; ++i) {
+			VkBool32 presentationSupport = _GetPhysicalDeviceWin32PresentationSupport(pVk->Adapter, i);
+			if (pQueueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT && presentationSupport)
+				pVk->QueueFamily = i;
+		}
+	}
 #endif
 
-		if (pQueueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT && presentationSupport)
+	// Headless: any graphics queue will do.
+	for (auto i = 0; i != numQueueFamilies && pVk->QueueFamily == (uint)-1; ++i) {
+		if (pQueueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
 			pVk->QueueFamily = i;
 	}
 
+	if (pVk->QueueFamily == (uint)-1) {
+		free(pQueueFamilies);
+		return false;
+	}
+
+#if PROFILE_ENABLED
+	uint32_t timestampBits = pQueueFamilies[pVk->QueueFamily].timestampValidBits;
+	VkPhysicalDeviceProperties adapterProps;
+	vkGetPhysicalDeviceProperties(pVk->Adapter, &adapterProps);
+	pVk->TimestampPeriod = timestampBits ? adapterProps.limits.timestampPeriod : 0.0f;
+	pVk->TimestampMask = (timestampBits >= 64) ? UINT64_MAX : ((1ull << timestampBits) - 1);
+#endif
+
 	free(pQueueFamilies);
 
 	// -- Create device.
-	const uint numRequiredDeviceExtensions = 1;
-	const char *requiredDeviceExtensions[numRequiredDeviceExtensions] = {
+	const uint numRequiredDeviceExtensions = bHeadless ? 0 : 1;
+	const char *requiredDeviceExtensions[1] = {
 		"VK_KHR_swapchain",
 	};
 
@@ -148,7 +227,11 @@ bool RHI::Initialize(bool EnableDebugging)
 	queueInfo.queueCount = 1;
 	queueInfo.queueFamilyIndex = pVk->QueueFamily;
 	
+	VkPhysicalDeviceVulkan12Features features12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+	features12.timelineSemaphore = VK_TRUE;
+
 	VkDeviceCreateInfo deviceInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+	deviceInfo.pNext = &features12;
 	deviceInfo.enabledExtensionCount = numRequiredDeviceExtensions;
 	deviceInfo.ppEnabledExtensionNames = requiredDeviceExtensions;
 	deviceInfo.pQueueCreateInfos = &queueInfo;
@@ -168,87 +251,42 @@ bool RHI::Initialize(bool EnableDebugging)
 	volkLoadDevice(pVk->Device);
 	vkGetDeviceQueue(pVk->Device, pVk->QueueFamily, 0, &pVk->MainQueue);
 
-	// -- Create default command pool & buffer.
-	VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-	cmdPoolInfo.queueFamilyIndex = pVk->QueueFamily;
-	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-	vkCreateCommandPool(pVk->Device, &cmdPoolInfo, nullptr, &pVk->CommandPool);
-
-	VkCommandBufferAllocateInfo cmdBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-	cmdBufferInfo.commandPool = pVk->CommandPool;
-	cmdBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cmdBufferInfo.commandBufferCount = 1;
-
-	vkAllocateCommandBuffers(pVk->Device, &cmdBufferInfo, &pVk->Cmd);
+	// -- Create a command pool & buffer per frame in flight. Pools are reset whole, so buffers don't need the reset flag.
+	if (NumFramesInFlight == 0)
+		NumFramesInFlight = 1;
+	if (NumFramesInFlight > RHI_MAX_FRAMES_IN_FLIGHT)
+		NumFramesInFlight = RHI_MAX_FRAMES_IN_FLIGHT;
+	pVk->NumFramesInFlight = NumFramesInFlight;
+	pVk->FrameNumber = 1;
 
-	// -- Load default shaders.
-	VkShaderModule vertModule;
-	VkShaderModule fragModule;
-
-	SFileBlob vs, fs;
-	ASSERT(ReadEntireFile(STR("data\\cso\\Static.spv"), &vs));
-	ASSERT(ReadEntireFile(STR("data\\cso\\Illum.spv"), &fs));
-
-	VkShaderModuleCreateInfo shaderModuleInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-	
-	shaderModuleInfo.codeSize = vs.Size;
-	shaderModuleInfo.pCode = (const uint32_t *)vs.pBuffer;
-	hr = vkCreateShaderModule(pVk->Device, &shaderModuleInfo, nullptr, &vertModule);
-
-	shaderModuleInfo.codeSize = fs.Size;
-	shaderModuleInfo.pCode = (const uint32_t *)fs.pBuffer;
-	hr = vkCreateShaderModule(pVk->Device, &shaderModuleInfo, nullptr, &fragModule);
-
-	VkPipelineShaderStageCreateInfo shaderStages[2] = {
-		{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO },
-		{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO }
-	};
-	
-	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	shaderStages[0].module = vertModule;
-	shaderStages[0].pName = "main";
-
-	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shaderStages[1].module = fragModule;
-	shaderStages[1].pName = "main";
-
-	// -- Fill in default pipline state info structs.
-	VkDynamicState dynamicStates[] = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR,
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-	dynamicState.dynamicStateCount = 2;
-	dynamicState.pDynamicStates = dynamicStates;
-
-	VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
-
-	VkPipelineInputAssemblyStateCreateInfo assemblyInfo = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
-	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-	VkPipelineViewportStateCreateInfo viewportInfo = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-	viewportInfo.viewportCount = 1;
-	viewportInfo.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizer.lineWidth = 1.0f;
-	
-	VkPipelineColorBlendAttachmentState colorBlend = {};
-	colorBlend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlend.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo blendInfo = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-	blendInfo.attachmentCount = 1;
-	blendInfo.pAttachments = &colorBlend;
-	blendInfo.logicOp = VK_LOGIC_OP_COPY;
+	if (!pVk->FrameArena.Initialize(NumFramesInFlight, RHI_FRAME_ARENA_SIZE, Jobs::GetNumThreads(), RHI_FRAME_THREAD_ARENA_SIZE))
+		return false;
 
-	VkPipelineMultisampleStateCreateInfo multisampling = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	cmdPoolInfo.queueFamilyIndex = pVk->QueueFamily;
+	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	for (uint i = 0; i != NumFramesInFlight; ++i) {
+		auto &frame = pVk->Frames[i];
+		vkCreateCommandPool(pVk->Device, &cmdPoolInfo, nullptr, &frame.CommandPool);
+
+		VkCommandBufferAllocateInfo cmdBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		cmdBufferInfo.commandPool = frame.CommandPool;
+		cmdBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdBufferInfo.commandBufferCount = 1;
+		vkAllocateCommandBuffers(pVk->Device, &cmdBufferInfo, &frame.Cmd);
+
+		frame.SubmitValue = 0;
+
+#if PROFILE_ENABLED
+		if (pVk->TimestampPeriod > 0.0f) {
+			VkQueryPoolCreateInfo queryPoolInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = RHI_MAX_GPU_ZONES * 2;
+			vkCreateQueryPool(pVk->Device, &queryPoolInfo, nullptr, &frame.TimestampPool);
+		}
+#endif
+	}
 
 	VkPipelineLayoutCreateInfo pipelineLayout = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
 	vkCreatePipelineLayout(pVk->Device, &pipelineLayout, nullptr, &pVk->PipelineLayout);
@@ -262,7 +300,7 @@ bool RHI::Initialize(bool EnableDebugging)
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = bHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Headless targets get read back.
 
 	VkAttachmentReference colorAttachmentReference = {};
 	colorAttachmentReference.attachment = 0;
@@ -290,86 +328,418 @@ bool RHI::Initialize(bool EnableDebugging)
 	hr = vkCreateRenderPass(pVk->Device, &renderPassInfo, nullptr, &pVk->RenderPass);
 	ASSERT(hr == VK_SUCCESS);
 
-	VkGraphicsPipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInput;
-	pipelineInfo.pInputAssemblyState = &assemblyInfo;
-	pipelineInfo.pViewportState = &viewportInfo;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pColorBlendState = &blendInfo;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.layout = pVk->PipelineLayout;
-	pipelineInfo.renderPass = pVk->RenderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineIndex = -1;
-
-	hr = vkCreateGraphicsPipelines(pVk->Device, nullptr, 1, &pipelineInfo, nullptr, &pVk->Pipeline);
-	ASSERT(hr == VK_SUCCESS);
+	// -- Default pipeline. Compiles on a job against the on-disk pipeline cache while the rest of start-up carries on.
+	if (!RHI::InitializePipelines(STR("data\\pipeline.cache")))
+		return false;
 
-	vkDestroyShaderModule(pVk->Device, fragModule, nullptr);
-	vkDestroyShaderModule(pVk->Device, vertModule, nullptr);
-	fs.Release();
-	vs.Release();
+	SGraphicsPipelineDesc defaultPipeline = {};
+	defaultPipeline.VertexShader = "Static.spv";
+	defaultPipeline.FragmentShader = "Illum.spv";
+	defaultPipeline.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	defaultPipeline.PolygonMode = VK_POLYGON_MODE_FILL;
+	defaultPipeline.CullMode = VK_CULL_MODE_BACK_BIT;
+	defaultPipeline.FrontFace = VK_FRONT_FACE_CLOCKWISE;
+	defaultPipeline.Layout = pVk->PipelineLayout;
+	defaultPipeline.RenderPass = pVk->RenderPass;
+	pVk->DefaultPipeline = RHI::RequestPipeline(defaultPipeline);
+	ASSERT(pVk->DefaultPipeline || bHeadless); // Headless runs may not ship the shaders.
+
+	// -- Create the frame timeline. Every submit signals it with its frame number.
+	VkSemaphoreTypeCreateInfo timelineInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
 
-	// -- Create Sync objects.
 	VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-	vkCreateSemaphore(pVk->Device, &semaphoreInfo, nullptr, &pVk->RenderSemaphore);
-	
-	VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	vkCreateFence(pVk->Device, &fenceInfo, nullptr, &pVk->QueueFence);
+	semaphoreInfo.pNext = &timelineInfo;
+	hr = vkCreateSemaphore(pVk->Device, &semaphoreInfo, nullptr, &pVk->FrameTimeline);
+	ASSERT(hr == VK_SUCCESS);
 
 	return true;
 }
 
 void RHI::Release()
 {
-	vkDeviceWaitIdle(pVk->Device);
-	vkDestroyFence(pVk->Device, pVk->QueueFence, nullptr);
-	vkDestroySemaphore(pVk->Device, pVk->RenderSemaphore, nullptr);
-	vkDestroyPipeline(pVk->Device, pVk->Pipeline, nullptr);
+	RHI::WaitForRendering();
+
+	for (uint i = 0; i != pVk->NumFramesInFlight; ++i) {
+		auto &frame = pVk->Frames[i];
+		RunDeferredReleases(&frame, UINT64_MAX);
+		frame.Releases.Free();
+		vkDestroyCommandPool(pVk->Device, frame.CommandPool, nullptr);
+		for (auto &recordPool : frame.RecordPools) {
+			if (recordPool.Pool)
+				vkDestroyCommandPool(pVk->Device, recordPool.Pool, nullptr);
+			recordPool.Buffers.Free();
+		}
+#if PROFILE_ENABLED
+		vkDestroyQueryPool(pVk->Device, frame.TimestampPool, nullptr);
+#endif
+	}
+
+	RHI::ReleasePipelines();
+	pVk->FrameArena.Release();
+	vkDestroySemaphore(pVk->Device, pVk->FrameTimeline, nullptr);
 	vkDestroyRenderPass(pVk->Device, pVk->RenderPass, nullptr);
 	vkDestroyPipelineLayout(pVk->Device, pVk->PipelineLayout, nullptr);
-	vkDestroyCommandPool(pVk->Device, pVk->CommandPool, nullptr);
 	vkDestroyDevice(pVk->Device, nullptr);
-	vkDestroyDebugUtilsMessengerEXT(pVk->Instance, pVk->DebugMessenger, nullptr);
+	if (pVk->DebugMessenger)
+		vkDestroyDebugUtilsMessengerEXT(pVk->Instance, pVk->DebugMessenger, nullptr);
 	vkDestroyInstance(pVk->Instance, nullptr);
 	ZeroThat(pVk);
 }
 
 void RHI::WaitForRendering()
 {
-	vkWaitForFences(pVk->Device, 1, &pVk->QueueFence, VK_TRUE, (uint64)5000000);
-	vkResetFences(pVk->Device, 1, &pVk->QueueFence);
+	WaitForFrame(pVk->FrameNumber - 1);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+dmFrameArena_t *RHI::GetFrameArena()
+{
+	return &pVk->FrameArena;
+}
+
+uint64_t RHI::GetFrameNumber()
+{
+	return pVk->FrameNumber;
+}
+
+uint64_t RHI::GetCompletedFrame()
+{
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(pVk->Device, pVk->FrameTimeline, &value);
+	return value;
+}
+
+bool RHI::WaitForFrame(uint64_t Frame, uint64_t Timeout)
+{
+	if (Frame == 0)
+		return true;
+
+	VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &pVk->FrameTimeline;
+	waitInfo.pValues = &Frame;
+	return vkWaitSemaphores(pVk->Device, &waitInfo, Timeout) == VK_SUCCESS;
+}
+
+void RHI::DeferRelease(VkObjectType Type, uint64_t Handle)
+{
+	if (Handle == 0)
+		return;
+
+	auto &frame = pVk->Frames[pVk->FrameNumber % pVk->NumFramesInFlight];
+	frame.Releases.Push({ Type, Handle, pVk->FrameNumber });
+}
+
+#if PROFILE_ENABLED
+uint RHI::BeginGpuZone(VkCommandBuffer Cmd, const char *pName)
+{
+	auto &frame = pVk->Frames[pVk->FrameNumber % pVk->NumFramesInFlight];
+	if (!frame.TimestampPool || frame.NumGpuZones == RHI_MAX_GPU_ZONES)
+		return (uint)-1;
+
+	uint zone = frame.NumGpuZones++;
+	frame.GpuZoneNames[zone] = pName;
+	frame.GpuZoneDepths[zone] = pVk->GpuZoneDepth++;
+	vkCmdWriteTimestamp(Cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.TimestampPool, zone * 2);
+	return zone;
+}
+
+void RHI::EndGpuZone(VkCommandBuffer Cmd, uint Zone)
+{
+	if (Zone == (uint)-1)
+		return;
+
+	auto &frame = pVk->Frames[pVk->FrameNumber % pVk->NumFramesInFlight];
+	--pVk->GpuZoneDepth;
+	vkCmdWriteTimestamp(Cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.TimestampPool, Zone * 2 + 1);
+}
+
+// The slot's last submit is known to be done here, so the results are there without waiting. The frame
+// zone's start is pinned to the CPU time of the submit.
+static void ResolveGpuZones(RHI::SRhiFrame *pFrame)
+{
+	uint num = pFrame->NumGpuZonesSubmitted;
+	pFrame->NumGpuZonesSubmitted = 0;
+	if (!num)
+		return;
+
+	uint64_t timestamps[RHI_MAX_GPU_ZONES * 2];
+	auto hr = vkGetQueryPoolResults(pVk->Device, pFrame->TimestampPool, 0, num * 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (hr != VK_SUCCESS)
+		return;
+
+	profZone_t zones[RHI_MAX_GPU_ZONES];
+	uint64_t base = timestamps[0] & pVk->TimestampMask;
+	for (uint i = 0; i != num; ++i) {
+		uint64_t begin = (timestamps[i * 2] & pVk->TimestampMask) - base;
+		uint64_t end = (timestamps[i * 2 + 1] & pVk->TimestampMask) - base;
+		zones[i].pName = pFrame->GpuZoneNames[i];
+		zones[i].begin = pFrame->SubmitTime + (uint64_t)((double)begin * pVk->TimestampPeriod);
+		zones[i].end = pFrame->SubmitTime + (uint64_t)((double)end * pVk->TimestampPeriod);
+		zones[i].thread = PROFILE_GPU_THREAD;
+		zones[i].depth = pFrame->GpuZoneDepths[i];
+	}
+	Profiler::ReportGpuFrame(zones, num);
+}
+#endif
+
+VkCommandBuffer RHI::BeginFrame()
+{
+	PROFILE_ZONE("RHI::BeginFrame");
+	auto &frame = pVk->Frames[pVk->FrameNumber % pVk->NumFramesInFlight];
+
+	// Only this slot's previous frame has to be done; the ones after it keep running.
+	{
+		PROFILE_ZONE("RHI::WaitForFrame");
+		WaitForFrame(frame.SubmitValue);
+	}
+	uint64_t completed = GetCompletedFrame();
+	RunDeferredReleases(&frame, completed);
+#if PROFILE_ENABLED
+	ResolveGpuZones(&frame);
+#endif
+
+	// A frame skipped after a failed acquire begins again under the same number; what it pushed stays until
+	// the slot comes round.
+	pVk->FrameArena.RetireFrame(completed);
+	if (pVk->FrameArena.GetFrame() != pVk->FrameNumber) {
+		bool bBegun = pVk->FrameArena.BeginFrame();
+		VERIFY(bBegun); // Can't fail: the wait above retired the slot's last frame.
+		(void)bBegun;
+	}
+
+	vkResetCommandPool(pVk->Device, frame.CommandPool, 0);
+	for (auto &recordPool : frame.RecordPools) {
+		if (recordPool.NumUsed) {
+			vkResetCommandPool(pVk->Device, recordPool.Pool, 0);
+			recordPool.NumUsed = 0;
+		}
+	}
+
+	VkCommandBufferBeginInfo cmdBegin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	cmdBegin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(frame.Cmd, &cmdBegin);
+
+#if PROFILE_ENABLED
+	frame.NumGpuZones = 0;
+	pVk->GpuZoneDepth = 0;
+	if (frame.TimestampPool)
+		vkCmdResetQueryPool(frame.Cmd, frame.TimestampPool, 0, RHI_MAX_GPU_ZONES * 2);
+	frame.FrameZone = BeginGpuZone(frame.Cmd, "GPU Frame");
+#endif
+
+	return frame.Cmd;
+}
+
+VkCommandBuffer RHI::BeginSecondary(VkRenderPass RenderPass, VkFramebuffer Framebuffer)
+{
+	uint thread = Jobs::GetThreadIndex();
+	if (thread == (uint)-1)
+		thread = 0; // No job system: only the main thread records.
+	ASSERT(thread < RHI_MAX_RECORD_THREADS);
+
+	auto &recordPool = pVk->Frames[pVk->FrameNumber % pVk->NumFramesInFlight].RecordPools[thread];
+	if (!recordPool.Pool) {
+		VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		cmdPoolInfo.queueFamilyIndex = pVk->QueueFamily;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(pVk->Device, &cmdPoolInfo, nullptr, &recordPool.Pool) != VK_SUCCESS)
+			return VK_NULL_HANDLE;
+	}
+
+	// Buffers stay allocated across frames; resetting the pool recycles them all.
+	if (recordPool.NumUsed == recordPool.Buffers.Getcount()) {
+		VkCommandBufferAllocateInfo cmdBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		cmdBufferInfo.commandPool = recordPool.Pool;
+		cmdBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		cmdBufferInfo.commandBufferCount = 1;
+
+		VkCommandBuffer cmd;
+		if (vkAllocateCommandBuffers(pVk->Device, &cmdBufferInfo, &cmd) != VK_SUCCESS)
+			return VK_NULL_HANDLE;
+		recordPool.Buffers.Push(cmd);
+	}
+	auto cmd = recordPool.Buffers[recordPool.NumUsed++];
+
+	VkCommandBufferInheritanceInfo inheritance = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+	inheritance.renderPass = RenderPass;
+	inheritance.framebuffer = Framebuffer;
+
+	VkCommandBufferBeginInfo cmdBegin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	cmdBegin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	cmdBegin.pInheritanceInfo = &inheritance;
+	vkBeginCommandBuffer(cmd, &cmdBegin);
+	return cmd;
+}
+
+bool RHI::AcquireImage(SWindowContext *pCtx, uint *pImageIndex)
+{
+	PROFILE_ZONE("RHI::AcquireImage");
+	if (pCtx->bOutOfDate)
+		RHI::ResizeWindowContext(pCtx, 0, 0);
+
+	auto semaphore = pCtx->ImageSemaphores[pVk->FrameNumber % pVk->NumFramesInFlight];
+
+	uint32_t imageIndex = 0;
+	auto hr = vkAcquireNextImageKHR(pVk->Device, pCtx->Swapchain, UINT64_MAX, semaphore, VK_NULL_HANDLE, &imageIndex);
+	if (hr == VK_ERROR_OUT_OF_DATE_KHR) {
+		RHI::ResizeWindowContext(pCtx, 0, 0);
+		return false;
+	}
+	if (hr == VK_SUBOPTIMAL_KHR)
+		pCtx->bOutOfDate = true; // Still presentable; rebuild before the next frame.
+	else if (hr != VK_SUCCESS)
+		return false;
+
+	*pImageIndex = imageIndex;
+	return true;
+}
+
+void RHI::SubmitFrame(SWindowContext *pCtx, uint ImageIndex)
+{
+	PROFILE_ZONE("RHI::SubmitFrame");
+	auto &frame = pVk->Frames[pVk->FrameNumber % pVk->NumFramesInFlight];
+#if PROFILE_ENABLED
+	EndGpuZone(frame.Cmd, frame.FrameZone);
+	frame.NumGpuZonesSubmitted = frame.NumGpuZones;
+	frame.SubmitTime = Profiler::GetTime();
+#endif
+	vkEndCommandBuffer(frame.Cmd);
+
+	// Binary semaphores ignore their entry in the value array.
+	VkSemaphore signalSemaphores[2] = { pVk->FrameTimeline, VK_NULL_HANDLE };
+	uint64_t signalValues[2] = { pVk->FrameNumber, 0 };
+	uint numSignals = 1;
+
+	VkPipelineStageFlags stagesToWait[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	if (pCtx) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &pCtx->ImageSemaphores[pVk->FrameNumber % pVk->NumFramesInFlight];
+		submitInfo.pWaitDstStageMask = stagesToWait;
+		signalSemaphores[numSignals++] = pCtx->RenderSemaphores[ImageIndex];
+	}
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmit = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+	timelineSubmit.signalSemaphoreValueCount = numSignals;
+	timelineSubmit.pSignalSemaphoreValues = signalValues;
+
+	submitInfo.pNext = &timelineSubmit;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.Cmd;
+	submitInfo.signalSemaphoreCount = numSignals;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	auto hr = vkQueueSubmit(pVk->MainQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	ASSERT(hr == VK_SUCCESS);
+	frame.SubmitValue = pVk->FrameNumber;
+
+	if (pCtx) {
+		PROFILE_ZONE("RHI::Present");
+		VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &pCtx->RenderSemaphores[ImageIndex];
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &pCtx->Swapchain;
+		presentInfo.pImageIndices = &ImageIndex;
+
+		hr = vkQueuePresentKHR(pVk->MainQueue, &presentInfo);
+		if (hr == VK_ERROR_OUT_OF_DATE_KHR || hr == VK_SUBOPTIMAL_KHR)
+			pCtx->bOutOfDate = true;
+	}
+
+	++pVk->FrameNumber;
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Swapchain images, their views/framebuffers and their present semaphores. Rebuilt on every resize.
+static void CreateSwapchainTargets(RHI::SWindowContext *pCtx)
+{
+	VkImage images[RHI_MAX_SWAPCHAIN_IMAGES];
+	pCtx->ImageCount = RHI_MAX_SWAPCHAIN_IMAGES;
+	vkGetSwapchainImagesKHR(pVk->Device, pCtx->Swapchain, &pCtx->ImageCount, images);
+
+	VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+	viewInfo.format = pCtx->SwapchainInfo.imageFormat;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+
+	VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+	framebufferInfo.renderPass = pVk->RenderPass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.width = pCtx->SwapchainInfo.imageExtent.width;
+	framebufferInfo.height = pCtx->SwapchainInfo.imageExtent.height;
+	framebufferInfo.layers = 1;
+
+	VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+
+	for (uint i = 0; i != pCtx->ImageCount; ++i) {
+		viewInfo.image = images[i];
+		vkCreateImageView(pVk->Device, &viewInfo, nullptr, &pCtx->ImageViews[i]);
+
+		framebufferInfo.pAttachments = &pCtx->ImageViews[i];
+		vkCreateFramebuffer(pVk->Device, &framebufferInfo, nullptr, &pCtx->Framebuffers[i]);
+
+		vkCreateSemaphore(pVk->Device, &semaphoreInfo, nullptr, &pCtx->RenderSemaphores[i]);
+	}
+}
+
+static void DeferSwapchainTargets(RHI::SWindowContext *pCtx)
+{
+	for (uint i = 0; i != pCtx->ImageCount; ++i) {
+		RHI::DeferRelease(VK_OBJECT_TYPE_FRAMEBUFFER, pCtx->Framebuffers[i]);
+		RHI::DeferRelease(VK_OBJECT_TYPE_IMAGE_VIEW, pCtx->ImageViews[i]);
+		RHI::DeferRelease(VK_OBJECT_TYPE_SEMAPHORE, pCtx->RenderSemaphores[i]);
+		pCtx->Framebuffers[i] = VK_NULL_HANDLE;
+		pCtx->ImageViews[i] = VK_NULL_HANDLE;
+		pCtx->RenderSemaphores[i] = VK_NULL_HANDLE;
+	}
+	pCtx->ImageCount = 0;
+}
+
 bool RHI::CreateWindowContext(void *pWnd, SWindowContext *pCtx)
 {
-	HWND hwnd = (HWND)pWnd;
+	ZeroThat(pCtx);
+	if (pVk->bHeadless)
+		return false;
 
 #ifdef PLATFORM_WIN64
 	VkWin32SurfaceCreateInfoKHR surfaceInfo = { VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR };
 	surfaceInfo.hinstance = ::GetModuleHandle(nullptr);
-	surfaceInfo.hwnd = hwnd;
+	surfaceInfo.hwnd = (HWND)pWnd;
 
-	vkCreateWin32SurfaceKHR(pVk->Instance, &surfaceInfo, nullptr, &pCtx->Surface);
+	if (vkCreateWin32SurfaceKHR(pVk->Instance, &surfaceInfo, nullptr, &pCtx->Surface) != VK_SUCCESS)
+		return false;
+#else
+	(void)pWnd;
+	return false;
 #endif
 
 	VkSurfaceCapabilitiesKHR surfaceCapabilities;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(pVk->Adapter, pCtx->Surface, &surfaceCapabilities);
 
-	ZeroThat(&pCtx->SwapchainInfo);
+	// One more image than frames in flight so acquire doesn't block on the oldest frame's present.
+	uint minImageCount = pVk->NumFramesInFlight + 1;
+	if (minImageCount < surfaceCapabilities.minImageCount)
+		minImageCount = surfaceCapabilities.minImageCount;
+	if (surfaceCapabilities.maxImageCount && minImageCount > surfaceCapabilities.maxImageCount)
+		minImageCount = surfaceCapabilities.maxImageCount;
+	if (minImageCount > RHI_MAX_SWAPCHAIN_IMAGES)
+		minImageCount = RHI_MAX_SWAPCHAIN_IMAGES;
+
 	pCtx->SwapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	pCtx->SwapchainInfo.imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
 	pCtx->SwapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	pCtx->SwapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	pCtx->SwapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	pCtx->SwapchainInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-	pCtx->SwapchainInfo.minImageCount = 2;
+	pCtx->SwapchainInfo.minImageCount = minImageCount;
 	pCtx->SwapchainInfo.clipped = false;
 	pCtx->SwapchainInfo.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
 	pCtx->SwapchainInfo.imageArrayLayers = 1;
@@ -383,67 +753,41 @@ bool RHI::CreateWindowContext(void *pWnd, SWindowContext *pCtx)
 		return false;
 	}
 
-	// -- Retrieve images.
-	VkImage images[2];
-	vkGetSwapchainImagesKHR(pVk->Device, pCtx->Swapchain, &pCtx->SwapchainInfo.minImageCount, images);
-
-	VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-	viewInfo.format = pCtx->SwapchainInfo.imageFormat;
-	viewInfo.image = images[0];
-	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewInfo.subresourceRange.layerCount = 1;
-	viewInfo.subresourceRange.levelCount = 1;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	
-	vkCreateImageView(pVk->Device, &viewInfo, nullptr, &pCtx->ImageViews[0]);
-	viewInfo.image = images[1];
-	vkCreateImageView(pVk->Device, &viewInfo, nullptr, &pCtx->ImageViews[1]);
-
-	// -- Create Framebuffers
-	VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-	framebufferInfo.renderPass = pVk->RenderPass;
-	framebufferInfo.attachmentCount = 1;
-	framebufferInfo.width = pCtx->SwapchainInfo.imageExtent.width;
-	framebufferInfo.height = pCtx->SwapchainInfo.imageExtent.height;
-	framebufferInfo.layers = 1;
-
-	framebufferInfo.pAttachments = &pCtx->ImageViews[0];
-	vkCreateFramebuffer(pVk->Device, &framebufferInfo, nullptr, &pCtx->Framebuffers[0]);
+	CreateSwapchainTargets(pCtx);
 
-	framebufferInfo.pAttachments = &pCtx->ImageViews[1];
-	vkCreateFramebuffer(pVk->Device, &framebufferInfo, nullptr, &pCtx->Framebuffers[1]);
-
-	// -- Create semaphore
 	VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-	vkCreateSemaphore(pVk->Device, &semaphoreInfo, nullptr, &pCtx->ImageSemaphore);
+	for (uint i = 0; i != pVk->NumFramesInFlight; ++i) {
+		vkCreateSemaphore(pVk->Device, &semaphoreInfo, nullptr, &pCtx->ImageSemaphores[i]);
+	}
 
 	return true;
 }
 
 void RHI::ReleaseWindowContext(SWindowContext *pCtx)
 {
+	// Old swapchains from resizes are still queued and have to go before the surface does.
 	RHI::WaitForRendering();
-	vkDestroySemaphore(pVk->Device, pCtx->ImageSemaphore, nullptr);
-	vkDestroyFramebuffer(pVk->Device, pCtx->Framebuffers[1], nullptr);
-	vkDestroyFramebuffer(pVk->Device, pCtx->Framebuffers[0], nullptr);
-	vkDestroyImageView(pVk->Device, pCtx->ImageViews[1], nullptr);
-	vkDestroyImageView(pVk->Device, pCtx->ImageViews[0], nullptr);
+	for (uint i = 0; i != pVk->NumFramesInFlight; ++i) {
+		RunDeferredReleases(&pVk->Frames[i], UINT64_MAX);
+	}
+
+	for (uint i = 0; i != pVk->NumFramesInFlight; ++i) {
+		vkDestroySemaphore(pVk->Device, pCtx->ImageSemaphores[i], nullptr);
+	}
+	for (uint i = 0; i != pCtx->ImageCount; ++i) {
+		vkDestroySemaphore(pVk->Device, pCtx->RenderSemaphores[i], nullptr);
+		vkDestroyFramebuffer(pVk->Device, pCtx->Framebuffers[i], nullptr);
+		vkDestroyImageView(pVk->Device, pCtx->ImageViews[i], nullptr);
+	}
 	vkDestroySwapchainKHR(pVk->Device, pCtx->Swapchain, nullptr);
 	vkDestroySurfaceKHR(pVk->Instance, pCtx->Surface, nullptr);
 	ZeroThat(pCtx);
 }
 
+// Doesn't wait for the GPU: the new swapchain retires the old one, and the old one and everything built
+// on it are handed to the current frame's release list.
 void RHI::ResizeWindowContext(SWindowContext *pCtx, uint NewWidth, uint NewHeight)
 {
-	RHI::WaitForRendering();
-
-	vkDestroyFramebuffer(pVk->Device, pCtx->Framebuffers[1], nullptr);
-	vkDestroyFramebuffer(pVk->Device, pCtx->Framebuffers[0], nullptr);
-	vkDestroyImageView(pVk->Device, pCtx->ImageViews[1], nullptr);
-	vkDestroyImageView(pVk->Device, pCtx->ImageViews[0], nullptr);
-	
-	vkDestroySwapchainKHR(pVk->Device, pCtx->Swapchain, nullptr);
-
 	VkSurfaceCapabilitiesKHR surfaceCaps;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(pVk->Adapter, pCtx->Surface, &surfaceCaps);
 
@@ -458,37 +802,20 @@ void RHI::ResizeWindowContext(SWindowContext *pCtx, uint NewWidth, uint NewHeigh
 		pCtx->SwapchainInfo.imageExtent.height = surfaceCaps.currentExtent.height;
 
 	pCtx->SwapchainInfo.preTransform = surfaceCaps.currentTransform;
+	pCtx->SwapchainInfo.oldSwapchain = pCtx->Swapchain;
 
-	vkCreateSwapchainKHR(pVk->Device, &pCtx->SwapchainInfo, nullptr, &pCtx->Swapchain);
-
-	VkImage images[2];
-	vkGetSwapchainImagesKHR(pVk->Device, pCtx->Swapchain, &pCtx->SwapchainInfo.minImageCount, images);
-
-	VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-	viewInfo.format = pCtx->SwapchainInfo.imageFormat;
-	viewInfo.image = images[0];
-	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewInfo.subresourceRange.layerCount = 1;
-	viewInfo.subresourceRange.levelCount = 1;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-
-	vkCreateImageView(pVk->Device, &viewInfo, nullptr, &pCtx->ImageViews[0]);
-	viewInfo.image = images[1];
-	vkCreateImageView(pVk->Device, &viewInfo, nullptr, &pCtx->ImageViews[1]);
-
-	// -- Create Framebuffers
-	VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-	framebufferInfo.renderPass = pVk->RenderPass;
-	framebufferInfo.attachmentCount = 1;
-	framebufferInfo.width = pCtx->SwapchainInfo.imageExtent.width;
-	framebufferInfo.height = pCtx->SwapchainInfo.imageExtent.height;
-	framebufferInfo.layers = 1;
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	auto hr = vkCreateSwapchainKHR(pVk->Device, &pCtx->SwapchainInfo, nullptr, &swapchain);
+	pCtx->SwapchainInfo.oldSwapchain = VK_NULL_HANDLE;
+	if (hr != VK_SUCCESS)
+		return; // Minimised or similar; bOutOfDate stays set and the next acquire tries again.
 
-	framebufferInfo.pAttachments = &pCtx->ImageViews[0];
-	vkCreateFramebuffer(pVk->Device, &framebufferInfo, nullptr, &pCtx->Framebuffers[0]);
+	DeferSwapchainTargets(pCtx);
+	RHI::DeferRelease(VK_OBJECT_TYPE_SWAPCHAIN_KHR, pCtx->Swapchain);
 
-	framebufferInfo.pAttachments = &pCtx->ImageViews[1];
-	vkCreateFramebuffer(pVk->Device, &framebufferInfo, nullptr, &pCtx->Framebuffers[1]);
+	pCtx->Swapchain = swapchain;
+	pCtx->bOutOfDate = false;
+	CreateSwapchainTargets(pCtx);
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1,9 +1,14 @@
 #pragma once
 #include "pch.h"
 #include <Engine/Rhi.h>
+#include <Engine/Memory.h>
+#include <Engine/Profiler.h>
+#include <Stl/Container.h>
 
 #include <volk.h>
 
+struct ImDrawData;
+
 namespace RHI {
 	void PrintAvailableVulkanLayers();            
 	void PrintAvailableVulkanInstanceExtensions();
@@ -13,20 +18,78 @@ namespace RHI {
 	bool CheckVulkanInstanceExtensionPresent(uint32_t Count, ...);
 	bool CheckVulkanDeviceExtensionPresent(VkPhysicalDevice Adapter, uint32_t Count, ...);
 
+	// Frames in flight: the CPU records frame N while the GPU is still on N-1 .. N-(count-1). Each frame slot
+	// owns its command pool and a list of objects to destroy, and every submit signals FrameTimeline with
+	// its frame number. BeginFrame() waits on the timeline for the slot's last use (not the whole queue),
+	// then runs the slot's deferred releases, so anything queued with DeferRelease() during frame N is
+	// destroyed once frame N is known to be done.
+	#define RHI_MAX_FRAMES_IN_FLIGHT 4 // Can't be more than DM_FRAME_ARENA_MAX_FRAMES.
+	#define RHI_MAX_SWAPCHAIN_IMAGES 8
+
+	typedef uint32_t pipelineHandle_t; // 0 is never a valid handle.
+
+	struct SDeferredRelease
+	{
+		VkObjectType Type;
+		uint64_t Handle;
+		uint64_t Frame; // Frame being recorded when it was queued.
+	};
+
+	// Scratch memory per frame in flight (and per job thread), reset by BeginFrame() once the timeline says the
+	// slot's previous frame is done, so anything the GPU reads during a frame can live there without a free.
+	#define RHI_FRAME_ARENA_SIZE MEGABYTES(8)
+	#define RHI_FRAME_THREAD_ARENA_SIZE MEGABYTES(1)
+
+	#define RHI_MAX_GPU_ZONES 64
+	#define RHI_MAX_RECORD_THREADS 64 // The job system's thread limit.
+
+	// Secondary command buffers recorded on one job thread. Pools can't be shared between threads, so each
+	// thread gets its own per frame slot, created on first use and reset with the slot.
+	struct SRecordPool
+	{
+		VkCommandPool Pool;
+		TArray<VkCommandBuffer> Buffers;
+		uint NumUsed;
+	};
+
+	struct SRhiFrame
+	{
+		VkCommandPool CommandPool;
+		VkCommandBuffer Cmd;
+		uint64_t SubmitValue; // Timeline value of this slot's last submit; 0 if never submitted.
+		TArray<SDeferredRelease> Releases;
+		SRecordPool RecordPools[RHI_MAX_RECORD_THREADS]; // By Jobs::GetThreadIndex().
+
+#if PROFILE_ENABLED
+		// Timestamp pair per GPU zone, read back when the slot comes round again.
+		VkQueryPool TimestampPool;
+		uint NumGpuZones;
+		uint NumGpuZonesSubmitted;
+		uint FrameZone;
+		uint64_t SubmitTime;
+		const char *GpuZoneNames[RHI_MAX_GPU_ZONES];
+		uint32_t GpuZoneDepths[RHI_MAX_GPU_ZONES];
+#endif
+	};
+
 	struct SWindowContext
 	{
 		VkSurfaceKHR Surface;
 		VkSwapchainCreateInfoKHR SwapchainInfo;
 		VkSwapchainKHR Swapchain;
-		VkImageView ImageViews[2];
-		VkFramebuffer Framebuffers[2];
-		VkSemaphore ImageSemaphore;
+		uint ImageCount;
+		VkImageView ImageViews[RHI_MAX_SWAPCHAIN_IMAGES];
+		VkFramebuffer Framebuffers[RHI_MAX_SWAPCHAIN_IMAGES];
+		VkSemaphore RenderSemaphores[RHI_MAX_SWAPCHAIN_IMAGES]; // Per image: presentation may still hold one after its frame retires.
+		VkSemaphore ImageSemaphores[RHI_MAX_FRAMES_IN_FLIGHT];  // Per frame slot: acquire -> submit.
+		bool bOutOfDate;
 	};
 
 	struct SRhiState
 	{
 		VkAllocationCallbacks Allocator;
 		bool bValidate;
+		bool bHeadless; // No surface extensions; CreateWindowContext() fails.
 
 		VkInstance Instance;
 		VkDebugUtilsMessengerEXT DebugMessenger;
@@ -34,14 +97,125 @@ namespace RHI {
 		VkDevice Device;
 		VkQueue MainQueue;
 		uint QueueFamily;
-		VkFence QueueFence;
-		VkSemaphore RenderSemaphore;
 
 		VkRenderPass RenderPass;
 		VkPipelineLayout PipelineLayout;
-		VkPipeline Pipeline;
+		VkPipelineCache PipelineCache;
+		pipelineHandle_t DefaultPipeline; // Resolve with GetPipeline() every frame; hot reloads replace the VkPipeline.
 
-		VkCommandPool CommandPool;
-		VkCommandBuffer Cmd;
+		VkSemaphore FrameTimeline;
+		uint64_t FrameNumber; // Frame being recorded; starts at 1 so 0 can mean 'nothing submitted'.
+		uint NumFramesInFlight;
+		SRhiFrame Frames[RHI_MAX_FRAMES_IN_FLIGHT];
+		dmFrameArena_t FrameArena; // Its frame numbers follow FrameNumber.
+
+#if PROFILE_ENABLED
+		float TimestampPeriod; // Nanoseconds per tick; 0 if the queue can't write timestamps.
+		uint64_t TimestampMask;
+		uint32_t GpuZoneDepth;
+#endif
 	};
-}
\ No newline at end of file
+
+	// -- Frame pacing. Usage per frame: BeginFrame, AcquireImage, record into the returned command buffer, SubmitFrame.
+	//    Headless use skips AcquireImage and passes a null window context to SubmitFrame.
+	VkCommandBuffer BeginFrame();
+	bool AcquireImage(SWindowContext *pCtx, uint *pImageIndex); // False if the swapchain had to be rebuilt; skip the frame.
+	void SubmitFrame(SWindowContext *pCtx, uint ImageIndex);
+
+	dmFrameArena_t *GetFrameArena(); // Push() from the main thread, PushThread() from jobs; valid until the frame retires.
+
+	uint64_t GetFrameNumber();
+	uint64_t GetCompletedFrame(); // Most recent frame the GPU has finished.
+	bool WaitForFrame(uint64_t Frame, uint64_t Timeout = UINT64_MAX);
+
+	// -- Parallel recording. Jobs record render pass contents into secondary command buffers that the main thread
+	//    then runs with vkCmdExecuteCommands() in the order it wants; the render pass has to be begun with
+	//    VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Callable from any job thread (or the main thread) between
+	//    BeginFrame and SubmitFrame; end the buffer with vkEndCommandBuffer().
+	VkCommandBuffer BeginSecondary(VkRenderPass RenderPass, VkFramebuffer Framebuffer);
+
+	void DeferRelease(VkObjectType Type, uint64_t Handle);
+	template <typename T> inline void DeferRelease(VkObjectType Type, T Handle) { DeferRelease(Type, (uint64_t)Handle); }
+
+	// -- GPU zones. Timestamps around a stretch of the current frame's command buffer; BeginFrame() opens a zone
+	//    for the whole frame and the profiler gets them once the frame retires. GPU time is lined up with the CPU
+	//    clock at submit, so zones are placed approximately. A zone left open loses that frame's GPU timings.
+#if PROFILE_ENABLED
+	uint BeginGpuZone(VkCommandBuffer Cmd, const char *pName);
+	void EndGpuZone(VkCommandBuffer Cmd, uint Zone);
+
+	struct SGpuZoneScope
+	{
+		SGpuZoneScope(VkCommandBuffer Cmd, const char *pName) : m_Cmd(Cmd), m_Zone(BeginGpuZone(Cmd, pName)) {}
+		~SGpuZoneScope() { EndGpuZone(m_Cmd, m_Zone); }
+
+		VkCommandBuffer m_Cmd;
+		uint m_Zone;
+	};
+#	define RHI_GPU_ZONE(Cmd, Name) RHI::SGpuZoneScope PROFILE_CONCAT(gpuZone, __LINE__)(Cmd, Name)
+#else
+#	define RHI_GPU_ZONE(Cmd, Name)
+#endif
+
+	// -- Pipelines (RhiPipelines.cpp).
+	//    RequestPipeline() hashes the create-state and hands back the existing handle for a request it has seen,
+	//    otherwise it queues a compile job against the shared VkPipelineCache and returns straight away.
+	//    GetPipeline() runs other jobs until that compile has finished, so only the first use of a pipeline
+	//    that isn't ready yet waits. The cache blob is loaded from and saved to disk, and ignored if it was
+	//    written by another device or driver.
+	//    Shaders are SPIR-V entries of data\cso.pak or, when there isn't one, loose files in data\cso\. Loose
+	//    files a request hasn't seen before are read through IO:: in one batch (so IO must be up), and the
+	//    compile job that first needs a shader creates its module from the read. UpdatePipelines() watches the
+	//    loose files: a rewritten .spv recompiles every pipeline that uses it, and the new pipeline replaces the
+	//    old one once it's built (the old one goes through DeferRelease). Built pipelines are swapped in on
+	//    every call, but the files are only checked a few times a second.
+	//    Everything here is main thread only; a compile job touches nothing but its own entry and, under a
+	//    lock, the modules of its shaders. The exception is GetPipeline() from a recording job the main thread
+	//    is waiting on, as long as no other thread is resolving the same handle at the same time.
+	#define RHI_MAX_PIPELINES 256
+	#define RHI_MAX_SHADERS 128
+	#define RHI_MAX_VERTEX_ATTRIBUTES 8
+
+	struct SGraphicsPipelineDesc
+	{
+		const char *VertexShader; // Entry name, e.g. "Static.spv".
+		const char *FragmentShader;
+		VkPrimitiveTopology Topology;
+		VkPolygonMode PolygonMode;
+		VkCullModeFlags CullMode;
+		VkFrontFace FrontFace;
+		bool bBlend;
+		uint VertexStride; // 0 = no vertex buffer, positions come from the shader.
+		uint NumVertexAttributes;
+		VkVertexInputAttributeDescription VertexAttributes[RHI_MAX_VERTEX_ATTRIBUTES]; // All from binding 0.
+		VkPipelineLayout Layout;
+		VkRenderPass RenderPass;
+		uint Subpass;
+	};
+
+	struct SPipelineStats
+	{
+		bool bWarmCache;       // A valid cache blob was loaded.
+		size_t CacheSize;      // Bytes loaded (or 0), then bytes saved.
+		double CacheLoadMs;
+		uint NumCompiled;
+		double CompileMs;      // Summed over compile jobs, not wall time.
+	};
+
+	bool InitializePipelines(const TCHAR *CachePath);
+	void ReleasePipelines(); // Saves the cache first.
+	bool SavePipelineCache();
+
+	pipelineHandle_t RequestPipeline(const SGraphicsPipelineDesc &Desc);
+	bool IsPipelineReady(pipelineHandle_t Handle);
+	VkPipeline GetPipeline(pipelineHandle_t Handle);
+	uint UpdatePipelines(); // Picks up changed shaders and swaps in rebuilt pipelines. Returns how many were swapped.
+	const SPipelineStats &GetPipelineStats();
+
+	// -- Dear ImGui renderer (RhiImGui.cpp). Draws into the default render pass through the pipeline system, so
+	//    ImGui.spv/ImGuiTex.spv hot reload like any other shader. Needs a current ImGui context. RenderImGui()
+	//    can record into a secondary command buffer from a job.
+	bool InitializeImGui();
+	void ReleaseImGui();
+	void RenderImGui(VkCommandBuffer Cmd, ImDrawData *pDrawData);
+}
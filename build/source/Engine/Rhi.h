@@ -8,9 +8,11 @@ namespace RHI {
 	struct SRhiState;
 	extern SRhiState *gRhi;
 
-	bool Initialize(bool bValidate);
+	// Headless skips the surface/swapchain extensions and the presentation queue check, for offscreen and CI
+	// runs (software ICDs such as lavapipe); window contexts can't be created then. Forced off Win64.
+	bool Initialize(bool bValidate, uint NumFramesInFlight = 2, bool bHeadless = false);
 	void Release();
-	void WaitForRendering();
+	void WaitForRendering(); // Every frame submitted so far.
 
 	void SetRhiState(SRhiState *pState);
 	SRhiState *GetRhiState();
@@ -0,0 +1,19 @@
+#version 430
+
+layout(location = 0) in vec2 Position;
+layout(location = 1) in vec2 TexCoord;
+layout(location = 2) in vec4 Color;
+
+layout(push_constant) uniform Transform {
+    vec2 Scale;
+    vec2 Translate;
+} transform;
+
+layout(location = 0) out vec4 VertexColor;
+layout(location = 1) out vec2 VertexTexCoord;
+
+void main() {
+    VertexColor = Color;
+    VertexTexCoord = TexCoord;
+    gl_Position = vec4(Position * transform.Scale + transform.Translate, 0.0, 1.0);
+}
\ No newline at end of file
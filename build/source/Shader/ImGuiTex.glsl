@@ -0,0 +1,11 @@
+#version 430
+
+layout(set = 0, binding = 0) uniform sampler2D Texture;
+
+layout(location = 0) in vec4 VertexColor;
+layout(location = 1) in vec2 VertexTexCoord;
+layout(location = 0) out vec4 PixelColor;
+
+void main() {
+    PixelColor = VertexColor * texture(Texture, VertexTexCoord);
+}
\ No newline at end of file
@@ -1,8 +1,32 @@
 #ifndef _STL_CONTAINER_H_
 #define _STL_CONTAINER_H_
 
+#include <pch.h>
+
+#include <type_traits>
+#include <utility>
+
+/* -------------------------------------------------------------------------------------------------------------- */
+// Allocators are small value types with Alloc/Realloc/Free. Realloc is only used for trivially copyable
+// elements; everything else is moved into a fresh Alloc. Engine/Memory.h has dmHeap_t and dmRingArena_t backed ones.
+struct TMallocAllocator
+{
+	inline void *Alloc(size_t Size) { return malloc(Size); }
+	inline void *Realloc(void *Ptr, size_t, size_t NewSize) { return realloc(Ptr, NewSize); }
+	inline void Free(void *Ptr, size_t) { free(Ptr); }
+};
+
+// Containers can't hand a failed allocation back through Push() and friends, so running out is fatal in every
+// build. Arena backed containers are the ones likely to get here: their Alloc returns null once the arena is full.
+[[noreturn]] inline void TOutOfMemory(size_t Size)
+{
+	fprintf(stderr, "[Stl] Out of memory (%zu bytes).\n", Size);
+	abort();
+}
+
 /* -------------------------------------------------------------------------------------------------------------- */
-template <typename T>
+// Only elements in [0, count) are constructed. Capacity grows geometrically (x1.5) so appends are amortised O(1).
+template <typename T, typename A = TMallocAllocator>
 struct TArray
 {
 	TArray()
@@ -12,84 +36,207 @@ struct TArray
 		m_uCap = 0;
 	}
 
+	explicit TArray(const A &Allocator) : TArray()
+	{
+		m_Allocator = Allocator;
+	}
+
+	TArray(const TArray &Other) : TArray()
+	{
+		m_Allocator = Other.m_Allocator;
+		Append(Other.m_uCount, Other.m_pElements);
+	}
+
+	TArray(TArray &&Other)
+	{
+		m_pElements = Other.m_pElements;
+		m_uCount = Other.m_uCount;
+		m_uCap = Other.m_uCap;
+		m_Allocator = Other.m_Allocator;
+		Other.m_pElements = nullptr;
+		Other.m_uCount = 0;
+		Other.m_uCap = 0;
+	}
+
 	~TArray()
 	{
-		Release();
+		Free();
+	}
+
+	TArray &operator =(const TArray &Other)
+	{
+		if (this != &Other) {
+			Clear();
+			Append(Other.m_uCount, Other.m_pElements);
+		}
+		return *this;
+	}
+
+	TArray &operator =(TArray &&Other)
+	{
+		if (this != &Other) {
+			Free();
+			m_pElements = Other.m_pElements;
+			m_uCount = Other.m_uCount;
+			m_uCap = Other.m_uCap;
+			m_Allocator = Other.m_Allocator;
+			Other.m_pElements = nullptr;
+			Other.m_uCount = 0;
+			Other.m_uCap = 0;
+		}
+		return *this;
 	}
 
 	void Free()
 	{
 		if (m_pElements) {
-			free(m_pElements);
+			Clear();
+			m_Allocator.Free(m_pElements, m_uCap * sizeof(T));
 			m_pElements = nullptr;
-			m_uCount = 0;
 			m_uCap = 0;
 		}
 	}
 
-	// Ensures that there is space for ('m_uCount' + 'Count') elements.
-	void Reserve(uint Count)
+	// Destroys every element but keeps the memory.
+	void Clear()
 	{
-		if (m_pElements) {
-			auto t = m_uCount + Count;
-			if (t > m_uCap) {
-				auto oldCap = m_uCap;
-				m_uCap = ALIGN8(t);
-				m_pElements = (T *)realloc(m_pElements, m_uCap * sizeof(T));
-				new(&m_pElements[oldCap]) T[m_uCap - oldCap];
-			}
-		}
-		else {
-			m_uCap = ALIGN8(Count);
-			m_uCount = 0;
-			m_pElements = (T *)malloc(m_uCap * sizeof(T));
-			new(m_pElements) T[m_uCap];
+		if constexpr (!std::is_trivially_destructible<T>::value) {
+			for (uint i = 0; i != m_uCount; ++i)
+				m_pElements[i].~T();
 		}
+		m_uCount = 0;
 	}
 
-	T *Append(uint uCount = 1, T *pSource = nullptr)
+	// Ensures that there is space for ('m_uCount' + 'Count') elements.
+	void Reserve(uint Count)
 	{
-		T *pDst = nullptr;
+		auto t = m_uCount + Count;
+		if (t > m_uCap)
+			Grow(t);
+	}
 
-		if (!m_pElements) {
-			m_uCount = uCount;
-			m_uCap = ALIGN8(m_uCount);
-			m_pElements = (T *)malloc(m_uCap * sizeof(T));
-			new(m_pElements) T[m_uCap];
-			pDst = m_pElements;
+	// Appends 'uCount' elements, copied from 'pSource' or default constructed. 'pSource' may point into this array.
+	T *Append(uint uCount = 1, const T *pSource = nullptr)
+	{
+		if ((m_uCount + uCount) > m_uCap) {
+			// Growing moves the elements, so a source inside the array is found again by its index.
+			if (pSource && pSource >= m_pElements && pSource < (m_pElements + m_uCount)) {
+				uint sourceIndex = (uint)(pSource - m_pElements);
+				Grow(m_uCount + uCount);
+				pSource = &m_pElements[sourceIndex];
+			} else {
+				Grow(m_uCount + uCount);
+			}
 		}
-		else {
-			auto t = m_uCount + uCount;
-			if (t > m_uCap) {
-				auto oldCap = m_uCap;
-				m_uCap = ALIGN8(t);
-				m_pElements = (T *)realloc(m_pElements, m_uCap * sizeof(T));
-				new(&m_pElements[oldCap]) T[m_uCap - oldCap];
+
+		T *pDst = &m_pElements[m_uCount];
+		if (pSource) {
+			if constexpr (std::is_trivially_copyable<T>::value) {
+				memcpy((void *)pDst, (const void *)pSource, uCount * sizeof(T));
+			} else {
+				for (uint i = 0; i != uCount; ++i)
+					new(&pDst[i]) T(pSource[i]);
 			}
-			pDst = &m_pElements[m_uCount];
+		} else {
+			for (uint i = 0; i != uCount; ++i)
+				new(&pDst[i]) T();
 		}
 
-		if (pSource)
-			memcpy(pDst, pSource, uCount * sizeof(T));
 		m_uCount += uCount;
 		return pDst;
 	}
 
+	// The arguments may refer to an element of this array (a.Push(a[0])): when the array has to grow,
+	// the new element is built before the old storage goes away.
+	template <typename... Args>
+	T &Emplace(Args &&... args)
+	{
+		T *pDst;
+		if (m_uCount == m_uCap) {
+			T value(std::forward<Args>(args)...);
+			Grow(m_uCount + 1);
+			pDst = new(&m_pElements[m_uCount]) T(std::move(value));
+		} else {
+			pDst = new(&m_pElements[m_uCount]) T(std::forward<Args>(args)...);
+		}
+		++m_uCount;
+		return *pDst;
+	}
+	inline T &Push(const T &Value) { return Emplace(Value); }
+	inline T &Push(T &&Value) { return Emplace(std::move(Value)); }
+
+	void Pop()
+	{
+		if (m_uCount) {
+			--m_uCount;
+			m_pElements[m_uCount].~T();
+		}
+	}
+
+	// O(1) removal; the last element takes the removed one's place.
+	void RemoveSwap(uint Index)
+	{
+		--m_uCount;
+		if (Index != m_uCount)
+			m_pElements[Index] = std::move(m_pElements[m_uCount]);
+		m_pElements[m_uCount].~T();
+	}
+
+	void Resize(uint Count)
+	{
+		if (Count > m_uCount) {
+			Append(Count - m_uCount);
+		} else {
+			while (m_uCount > Count)
+				Pop();
+		}
+	}
+
 	T *begin() { return m_pElements; }
 	T *end() { return &m_pElements[m_uCount]; }
 
 	inline T *GetPtr() { return m_pElements; }
 	inline uint GetCapacity() { return m_uCap; }
 	inline uint Getcount() { return m_uCount; }
+	inline A &GetAllocator() { return m_Allocator; }
 
 	inline T &operator [](uint it) { return m_pElements[it]; }
 	inline operator T *() { return m_pElements; }
 
 private:
+	void Grow(uint Required)
+	{
+		uint newCap = m_uCap + (m_uCap / 2);
+		if (newCap < Required)
+			newCap = Required;
+		if (newCap < 8)
+			newCap = 8;
+
+		if constexpr (std::is_trivially_copyable<T>::value) {
+			auto pNew = (T *)m_Allocator.Realloc(m_pElements, m_uCap * sizeof(T), newCap * sizeof(T));
+			if (!pNew)
+				TOutOfMemory(newCap * sizeof(T));
+			m_pElements = pNew;
+		} else {
+			auto pNew = (T *)m_Allocator.Alloc(newCap * sizeof(T));
+			if (!pNew)
+				TOutOfMemory(newCap * sizeof(T));
+			for (uint i = 0; i != m_uCount; ++i) {
+				new(&pNew[i]) T(std::move(m_pElements[i]));
+				m_pElements[i].~T();
+			}
+			if (m_pElements)
+				m_Allocator.Free(m_pElements, m_uCap * sizeof(T));
+			m_pElements = pNew;
+		}
+		m_uCap = newCap;
+	}
+
 	T *m_pElements;
 	uint m_uCount;
 	uint m_uCap;
+	A m_Allocator;
 };
 
 
-#endif // _STL_CONTAINER_H_
\ No newline at end of file
+#endif // _STL_CONTAINER_H_
@@ -0,0 +1,328 @@
+#ifndef _STL_MAP_H_
+#define _STL_MAP_H_
+
+#include <pch.h>
+#include <Stl/Container.h>
+
+/* -------------------------------------------------------------------------------------------------------------- */
+// Hashing. Overload THashOf() next to your own key types.
+
+inline uint32_t THashOf(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return (uint32_t)x;
+}
+
+template <typename K>
+inline typename std::enable_if<std::is_integral<K>::value || std::is_enum<K>::value, uint32_t>::type THashOf(const K &Key)
+{
+	return THashOf((uint64_t)Key);
+}
+
+template <typename K>
+inline uint32_t THashOf(K *const &Key)
+{
+	return THashOf((uint64_t)(uintptr_t)Key);
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+// Open addressing with linear probing. The 32-bit hashes live in their own array so a probe walks a few
+// contiguous words before it ever touches an entry; 0 marks an empty slot. Removal shifts the rest of the
+// cluster back instead of leaving tombstones, so lookups never slow down after heavy churn.
+template <typename K, typename E, typename Traits, typename A>
+class THashTable
+{
+public:
+	THashTable()
+	{
+		m_pHashes = nullptr;
+		m_pEntries = nullptr;
+		m_uCount = 0;
+		m_uCap = 0;
+	}
+
+	explicit THashTable(const A &Allocator) : THashTable()
+	{
+		m_Allocator = Allocator;
+	}
+
+	THashTable(const THashTable &) = delete;
+	THashTable &operator =(const THashTable &) = delete;
+
+	THashTable(THashTable &&Other)
+	{
+		m_pHashes = Other.m_pHashes;
+		m_pEntries = Other.m_pEntries;
+		m_uCount = Other.m_uCount;
+		m_uCap = Other.m_uCap;
+		m_Allocator = Other.m_Allocator;
+		Other.m_pHashes = nullptr;
+		Other.m_pEntries = nullptr;
+		Other.m_uCount = 0;
+		Other.m_uCap = 0;
+	}
+
+	~THashTable()
+	{
+		Free();
+	}
+
+	void Free()
+	{
+		if (m_pHashes) {
+			Clear();
+			m_Allocator.Free(m_pHashes, AllocSize(m_uCap));
+			m_pHashes = nullptr;
+			m_pEntries = nullptr;
+			m_uCap = 0;
+		}
+	}
+
+	void Clear()
+	{
+		for (uint i = 0; i != m_uCap; ++i) {
+			if (m_pHashes[i]) {
+				m_pEntries[i].~E();
+				m_pHashes[i] = 0;
+			}
+		}
+		m_uCount = 0;
+	}
+
+	// Makes room for 'Count' entries in total without rehashing.
+	void Reserve(uint Count)
+	{
+		uint cap = 8;
+		while ((cap * 3) < (Count * 4))
+			cap *= 2;
+		if (cap > m_uCap)
+			Rehash(cap);
+	}
+
+	E *FindEntry(const K &Key)
+	{
+		if (!m_uCount)
+			return nullptr;
+
+		uint32_t hash = HashKey(Key);
+		uint mask = m_uCap - 1;
+		for (uint i = hash & mask;; i = (i + 1) & mask) {
+			if (!m_pHashes[i])
+				return nullptr;
+			if (m_pHashes[i] == hash && Traits::KeyOf(m_pEntries[i]) == Key)
+				return &m_pEntries[i];
+		}
+	}
+
+	// Returns the existing entry for 'Key', or constructs a new one from 'args'. 'bInserted' says which.
+	template <typename... Args>
+	E *FindOrInsert(const K &Key, bool *pInserted, Args &&... args)
+	{
+		if (((m_uCount + 1) * 4) > (m_uCap * 3))
+			Rehash((m_uCap) ? (m_uCap * 2) : 8);
+
+		uint32_t hash = HashKey(Key);
+		uint mask = m_uCap - 1;
+		uint i = hash & mask;
+		for (; m_pHashes[i]; i = (i + 1) & mask) {
+			if (m_pHashes[i] == hash && Traits::KeyOf(m_pEntries[i]) == Key) {
+				*pInserted = false;
+				return &m_pEntries[i];
+			}
+		}
+
+		new(&m_pEntries[i]) E(std::forward<Args>(args)...);
+		m_pHashes[i] = hash;
+		++m_uCount;
+		*pInserted = true;
+		return &m_pEntries[i];
+	}
+
+	bool Remove(const K &Key)
+	{
+		E *pEntry = FindEntry(Key);
+		if (!pEntry)
+			return false;
+
+		uint mask = m_uCap - 1;
+		uint i = (uint)(pEntry - m_pEntries);
+		m_pEntries[i].~E();
+
+		// Pull back any entry further along the cluster that would otherwise become unreachable.
+		for (uint j = (i + 1) & mask; m_pHashes[j]; j = (j + 1) & mask) {
+			uint ideal = m_pHashes[j] & mask;
+			if (((j - ideal) & mask) >= ((j - i) & mask)) {
+				new(&m_pEntries[i]) E(std::move(m_pEntries[j]));
+				m_pEntries[j].~E();
+				m_pHashes[i] = m_pHashes[j];
+				i = j;
+			}
+		}
+
+		m_pHashes[i] = 0;
+		--m_uCount;
+		return true;
+	}
+
+	inline uint Getcount() { return m_uCount; }
+	inline uint GetCapacity() { return m_uCap; }
+
+	// -----------------------------------
+	// Iteration (unordered).
+	// -----------------------------------
+	struct Iterator
+	{
+		THashTable *pTable;
+		uint Index;
+
+		inline E &operator *() { return pTable->m_pEntries[Index]; }
+		inline E *operator ->() { return &pTable->m_pEntries[Index]; }
+		inline bool operator !=(const Iterator &Other) { return Index != Other.Index; }
+		inline Iterator &operator ++() { Index = pTable->NextOccupied(Index + 1); return *this; }
+	};
+
+	Iterator begin() { return { this, NextOccupied(0) }; }
+	Iterator end() { return { this, m_uCap }; }
+
+private:
+	static inline uint32_t HashKey(const K &Key)
+	{
+		uint32_t hash = THashOf(Key);
+		return (hash) ? hash : 1;
+	}
+
+	static inline size_t EntryOffset(uint Cap) { return ALIGN16((size_t)Cap * sizeof(uint32_t)); }
+	static inline size_t AllocSize(uint Cap) { return EntryOffset(Cap) + ((size_t)Cap * sizeof(E)); }
+
+	uint NextOccupied(uint Index)
+	{
+		while (Index < m_uCap && !m_pHashes[Index])
+			++Index;
+		return Index;
+	}
+
+	void Rehash(uint NewCap)
+	{
+		auto pOldHashes = m_pHashes;
+		auto pOldEntries = m_pEntries;
+		auto oldCap = m_uCap;
+
+		auto pMem = (uint8 *)m_Allocator.Alloc(AllocSize(NewCap));
+		if (!pMem)
+			TOutOfMemory(AllocSize(NewCap));
+		m_pHashes = (uint32_t *)pMem;
+		m_pEntries = (E *)(pMem + EntryOffset(NewCap));
+		m_uCap = NewCap;
+		memset(m_pHashes, 0, NewCap * sizeof(uint32_t));
+
+		uint mask = NewCap - 1;
+		for (uint i = 0; i != oldCap; ++i) {
+			if (pOldHashes[i]) {
+				uint j = pOldHashes[i] & mask;
+				while (m_pHashes[j])
+					j = (j + 1) & mask;
+				new(&m_pEntries[j]) E(std::move(pOldEntries[i]));
+				pOldEntries[i].~E();
+				m_pHashes[j] = pOldHashes[i];
+			}
+		}
+
+		if (pOldHashes)
+			m_Allocator.Free(pOldHashes, AllocSize(oldCap));
+	}
+
+	uint32_t *m_pHashes;
+	E *m_pEntries;
+	uint m_uCount;
+	uint m_uCap; // Always zero or a power of two.
+	A m_Allocator;
+};
+
+/* -------------------------------------------------------------------------------------------------------------- */
+template <typename K, typename V>
+struct TPair
+{
+	K Key;
+	V Value;
+};
+
+template <typename K, typename V>
+struct TMapTraits
+{
+	static inline const K &KeyOf(const TPair<K, V> &Entry) { return Entry.Key; }
+};
+
+template <typename K, typename V, typename A = TMallocAllocator>
+class TMap : public THashTable<K, TPair<K, V>, TMapTraits<K, V>, A>
+{
+	typedef THashTable<K, TPair<K, V>, TMapTraits<K, V>, A> Super;
+
+public:
+	TMap() = default;
+	explicit TMap(const A &Allocator) : Super(Allocator) {}
+
+	inline V *Find(const K &Key)
+	{
+		auto pEntry = this->FindEntry(Key);
+		return (pEntry) ? &pEntry->Value : nullptr;
+	}
+
+	inline bool Contains(const K &Key) { return this->FindEntry(Key) != nullptr; }
+
+	// Inserts or overwrites.
+	V *Insert(const K &Key, V Value)
+	{
+		auto pEntry = this->FindEntry(Key);
+		if (pEntry) {
+			pEntry->Value = std::move(Value);
+			return &pEntry->Value;
+		}
+
+		bool bInserted;
+		return &this->FindOrInsert(Key, &bInserted, TPair<K, V>{ Key, std::move(Value) })->Value;
+	}
+
+	// Default constructs the value if the key isn't present.
+	V &operator [](const K &Key)
+	{
+		auto pEntry = this->FindEntry(Key);
+		if (pEntry)
+			return pEntry->Value;
+
+		bool bInserted;
+		return this->FindOrInsert(Key, &bInserted, TPair<K, V>{ Key, V() })->Value;
+	}
+};
+
+/* -------------------------------------------------------------------------------------------------------------- */
+template <typename K>
+struct TSetTraits
+{
+	static inline const K &KeyOf(const K &Entry) { return Entry; }
+};
+
+template <typename K, typename A = TMallocAllocator>
+class TSet : public THashTable<K, K, TSetTraits<K>, A>
+{
+	typedef THashTable<K, K, TSetTraits<K>, A> Super;
+
+public:
+	TSet() = default;
+	explicit TSet(const A &Allocator) : Super(Allocator) {}
+
+	inline bool Contains(const K &Key) { return this->FindEntry(Key) != nullptr; }
+
+	// Returns false if 'Key' was already present.
+	inline bool Insert(const K &Key)
+	{
+		bool bInserted;
+		this->FindOrInsert(Key, &bInserted, Key);
+		return bInserted;
+	}
+};
+
+#endif // _STL_MAP_H_
@@ -0,0 +1,152 @@
+#include <pch.h>
+#include <Stl/Name.h>
+#include <Stl/String.h>
+
+#include <atomic>
+#include <mutex>
+
+#define NAME_PAGE_BITS 12
+#define NAME_PAGE_SIZE (1 << NAME_PAGE_BITS)
+#define NAME_MAX_PAGES 1024 // ~4M names.
+#define NAME_CHUNK_SIZE KILOBYTES(64)
+
+struct nameEntry_t
+{
+	const char *Str;
+	uint Length;
+};
+
+struct nameKey_t
+{
+	const char *Str;
+	uint Length;
+	uint32_t Hash;
+
+	inline bool operator ==(const nameKey_t &Other) const {
+		return (Length == Other.Length) && TMemEqual(Str, Other.Str, Length);
+	}
+};
+
+static inline uint32_t THashOf(const nameKey_t &Key) { return Key.Hash; }
+
+// Entries live in fixed pages that never move, so readers can resolve an id without taking the lock.
+struct nameTable_t
+{
+	std::mutex Lock;
+	TMap<nameKey_t, uint32_t> Lookup;
+	std::atomic<nameEntry_t *> pPages[NAME_MAX_PAGES];
+	uint32_t NextId;
+	char *pChunk;
+	size_t ChunkLeft;
+};
+
+static nameTable_t *GetNameTable()
+{
+	static nameTable_t *pTable = []() {
+		auto p = new nameTable_t;
+		for (auto &page : p->pPages)
+			page.store(nullptr, std::memory_order_relaxed);
+		p->NextId = 1;
+		p->pChunk = nullptr;
+		p->ChunkLeft = 0;
+		return p;
+	}();
+	return pTable;
+}
+
+static uint32_t HashChars(const char *Str, uint Length)
+{
+	uint32_t hash = 2166136261u; // FNV-1a
+	for (uint i = 0; i != Length; ++i) {
+		hash ^= (uint8)Str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Names are never freed, so their characters are packed into big chunks.
+static const char *StoreChars(nameTable_t *pTable, const char *Str, uint Length)
+{
+	char *pDst;
+	if ((size_t)(Length + 1) > (NAME_CHUNK_SIZE / 4)) {
+		pDst = (char *)malloc(Length + 1);
+	} else {
+		if ((size_t)(Length + 1) > pTable->ChunkLeft) {
+			pTable->pChunk = (char *)malloc(NAME_CHUNK_SIZE);
+			pTable->ChunkLeft = NAME_CHUNK_SIZE;
+		}
+		pDst = pTable->pChunk;
+		pTable->pChunk += (Length + 1);
+		pTable->ChunkLeft -= (Length + 1);
+	}
+
+	memcpy(pDst, Str, Length);
+	pDst[Length] = 0;
+	return pDst;
+}
+
+/* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
+SName::SName(const char *Str) 
+{
+	*this = Intern(Str, TStrlen(Str));
+}
+
+SName::SName(const wchar_t *Str)
+{
+	*this = Intern(Str, TStrlen(Str));
+}
+
+SName SName::Intern(const char *Str, uint Length)
+{
+	if (!Length)
+		return SName();
+
+	auto pTable = GetNameTable();
+	nameKey_t key = { Str, Length, HashChars(Str, Length) };
+
+	std::lock_guard<std::mutex> lock(pTable->Lock);
+
+	auto pId = pTable->Lookup.Find(key);
+	if (pId)
+		return FromId(*pId);
+
+	uint32_t id = pTable->NextId;
+	uint page = id >> NAME_PAGE_BITS;
+	if (page >= NAME_MAX_PAGES)
+		return SName();
+
+	auto pPage = pTable->pPages[page].load(std::memory_order_relaxed);
+	if (!pPage) {
+		pPage = (nameEntry_t *)calloc(NAME_PAGE_SIZE, sizeof(nameEntry_t));
+		pTable->pPages[page].store(pPage, std::memory_order_release);
+	}
+
+	key.Str = StoreChars(pTable, Str, Length);
+	pPage[id & (NAME_PAGE_SIZE - 1)] = { key.Str, Length };
+	pTable->Lookup.Insert(key, id);
+	++pTable->NextId;
+	return FromId(id);
+}
+
+SName SName::Intern(const wchar_t *Str, uint Length)
+{
+	TString<char> utf8;
+	TWideToUtf8(Str, Length, &utf8);
+	return Intern((const char *)utf8, utf8.Length());
+}
+
+const char *SName::GetString() const
+{
+	if (!Id)
+		return "";
+	auto pPage = GetNameTable()->pPages[Id >> NAME_PAGE_BITS].load(std::memory_order_acquire);
+	return pPage[Id & (NAME_PAGE_SIZE - 1)].Str;
+}
+
+uint SName::GetLength() const
+{
+	if (!Id)
+		return 0;
+	auto pPage = GetNameTable()->pPages[Id >> NAME_PAGE_BITS].load(std::memory_order_acquire);
+	return pPage[Id & (NAME_PAGE_SIZE - 1)].Length;
+}
@@ -0,0 +1,33 @@
+#if !defined(_STL_NAME_H_)
+#define _STL_NAME_H_
+
+#include <pch.h>
+#include <Stl/Map.h>
+
+/* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
+// Interned string handle. Every distinct string gets a stable 32-bit id for the life of the program, so names
+// compare and hash as integers. Id 0 is the empty/none name. Interning takes a lock; GetString() doesn't.
+// Wide strings are stored as UTF-8, so SName(L"Foo") == SName("Foo").
+struct SName
+{
+	SName() : Id(0) {}
+	explicit SName(const char *Str);
+	explicit SName(const wchar_t *Str);
+
+	static SName Intern(const char *Str, uint Length);
+	static SName Intern(const wchar_t *Str, uint Length);
+	static SName FromId(uint32_t Id) { SName name; name.Id = Id; return name; }
+
+	const char *GetString() const;
+	uint GetLength() const;
+
+	inline bool IsNone() const { return Id == 0; }
+	inline bool operator ==(const SName &Other) const { return Id == Other.Id; }
+	inline bool operator !=(const SName &Other) const { return Id != Other.Id; }
+
+	uint32_t Id;
+};
+
+inline uint32_t THashOf(const SName &Name) { return THashOf((uint64_t)Name.Id); }
+
+#endif // _STL_NAME_H_
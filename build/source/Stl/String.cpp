@@ -1,11 +1,294 @@
 #include <pch.h>
 #include <Stl/String.h>
 
-template <> static uint TStrlen<char>(const char *Str) { return (uint)strlen(Str); }
-template <> static uint TStrlen<wchar_t>(const wchar_t *Str) { return (uint)wcslen(Str); }
+#include <wchar.h>
 
-template <> static bool TStrcmp<char>(const char *Left, const char *Right) { return !strcmp(Left, Right); }
-template <> static bool TStrcmp<wchar_t>(const wchar_t *Left, const wchar_t *Right) { return !wcscmp(Left, Right); }
+// SSE2 is part of x64. AVX2 isn't, so its kernels are compiled for it on their own (no build flag needed) and
+// only run when cpuid says the CPU and OS support it.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#	define STL_STRING_SSE2
+#	include <emmintrin.h>
+#	if defined(_MSC_VER)
+#		define STL_STRING_AVX2
+#		define STL_AVX2_TARGET
+#	elif defined(__GNUC__)
+#		define STL_STRING_AVX2
+#		define STL_AVX2_TARGET __attribute__((target("avx2")))
+#	endif
+#	if defined(STL_STRING_AVX2)
+#		include <immintrin.h>
+#	endif
+#endif
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
 
-template <> const char *TEmptyString() { return ""; }
-template <> const wchar_t *TEmptyString() { return L""; }
\ No newline at end of file
+template <> uint TStrlen<char>(const char *Str) { return (uint)strlen(Str); }
+template <> uint TStrlen<wchar_t>(const wchar_t *Str) { return (uint)wcslen(Str); }
+
+template <> bool TStrcmp<char>(const char *Left, const char *Right) { return !strcmp(Left, Right); }
+template <> bool TStrcmp<wchar_t>(const wchar_t *Left, const wchar_t *Right) { return !wcscmp(Left, Right); }
+
+/* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
+/* Search/compare kernels. The vector loops compare a whole register of characters at once and turn the result into a */
+/* byte mask; the first (or last) set bit is the match. The AVX2 loops run first when the CPU has it, and the */
+/* SSE2 and scalar loops finish off whatever is left. */
+
+static inline uint LowBit(uint32_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (uint)i;
+#else
+	return (uint)__builtin_ctz(x);
+#endif
+}
+
+static inline uint HighBit(uint32_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanReverse(&i, x);
+	return (uint)i;
+#else
+	return (uint)(31 - __builtin_clz(x));
+#endif
+}
+
+#if defined(STL_STRING_SSE2)
+template <typename T>
+static inline __m128i Splat128(T Ch)
+{
+	if constexpr (sizeof(T) == 1) return _mm_set1_epi8((char)Ch);
+	else if constexpr (sizeof(T) == 2) return _mm_set1_epi16((short)Ch);
+	else return _mm_set1_epi32((int)Ch);
+}
+
+template <typename T>
+static inline uint32_t Match128(const T *Ptr, __m128i Needle)
+{
+	auto v = _mm_loadu_si128((const __m128i *)Ptr);
+	if constexpr (sizeof(T) == 1) return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, Needle));
+	else if constexpr (sizeof(T) == 2) return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(v, Needle));
+	else return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi32(v, Needle));
+}
+#endif
+
+#if defined(STL_STRING_AVX2)
+static bool DetectAvx2()
+{
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7)
+		return false;
+
+	// AVX needs the OS to save the YMM registers as well as the CPU to have it.
+	__cpuid(regs, 1);
+	if (!(regs[2] & (1 << 27)) || !(regs[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init(); // May run before libgcc's own constructor has.
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Anything that searches before this is initialized sees false and takes the SSE2 path.
+static const bool gHasAvx2 = DetectAvx2();
+
+template <typename T>
+STL_AVX2_TARGET static inline __m256i Splat256(T Ch)
+{
+	if constexpr (sizeof(T) == 1) return _mm256_set1_epi8((char)Ch);
+	else if constexpr (sizeof(T) == 2) return _mm256_set1_epi16((short)Ch);
+	else return _mm256_set1_epi32((int)Ch);
+}
+
+template <typename T>
+STL_AVX2_TARGET static inline uint32_t Match256(const T *Ptr, __m256i Needle)
+{
+	auto v = _mm256_loadu_si256((const __m256i *)Ptr);
+	if constexpr (sizeof(T) == 1) return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, Needle));
+	else if constexpr (sizeof(T) == 2) return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, Needle));
+	else return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, Needle));
+}
+
+// The AVX2 halves of the kernels below. Each goes over whole 32-byte blocks and leaves '*pI' where it stopped.
+template <typename T>
+STL_AVX2_TARGET static const T *FindCharAvx2(const T *Str, uint Length, T Ch, uint *pI)
+{
+	const uint lanes = 32 / sizeof(T);
+	auto needle = Splat256(Ch);
+	uint i = *pI;
+	for (; (i + lanes) <= Length; i += lanes) {
+		auto mask = Match256(&Str[i], needle);
+		if (mask)
+			return &Str[i + (LowBit(mask) / sizeof(T))];
+	}
+	*pI = i;
+	return nullptr;
+}
+
+template <typename T>
+STL_AVX2_TARGET static const T *FindLastCharAvx2(const T *Str, T Ch, uint *pI)
+{
+	const uint lanes = 32 / sizeof(T);
+	auto needle = Splat256(Ch);
+	uint i = *pI;
+	for (; i >= lanes; i -= lanes) {
+		auto mask = Match256(&Str[i - lanes], needle);
+		if (mask)
+			return &Str[(i - lanes) + (HighBit(mask) / sizeof(T))];
+	}
+	*pI = i;
+	return nullptr;
+}
+
+// False as soon as a block differs.
+STL_AVX2_TARGET static bool MemEqualAvx2(const uint8 *Left, const uint8 *Right, size_t Size, size_t *pI)
+{
+	size_t i = *pI;
+	for (; (i + 32) <= Size; i += 32) {
+		auto eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&Left[i]), _mm256_loadu_si256((const __m256i *)&Right[i]));
+		if ((uint32_t)_mm256_movemask_epi8(eq) != 0xFFFFFFFFu)
+			return false;
+	}
+	*pI = i;
+	return true;
+}
+#endif
+
+template <typename T>
+static const T *FindCharImpl(const T *Str, uint Length, T Ch)
+{
+	uint i = 0;
+
+#if defined(STL_STRING_AVX2)
+	if (gHasAvx2) {
+		if (auto pFound = FindCharAvx2(Str, Length, Ch, &i))
+			return pFound;
+	}
+#endif
+
+#if defined(STL_STRING_SSE2)
+	const uint lanes = 16 / sizeof(T);
+	auto needle = Splat128(Ch);
+	for (; (i + lanes) <= Length; i += lanes) {
+		auto mask = Match128(&Str[i], needle);
+		if (mask)
+			return &Str[i + (LowBit(mask) / sizeof(T))];
+	}
+#endif
+
+	for (; i != Length; ++i) {
+		if (Str[i] == Ch)
+			return &Str[i];
+	}
+	return nullptr;
+}
+
+template <typename T>
+static const T *FindLastCharImpl(const T *Str, uint Length, T Ch)
+{
+	uint i = Length;
+
+#if defined(STL_STRING_AVX2)
+	if (gHasAvx2) {
+		if (auto pFound = FindLastCharAvx2(Str, Ch, &i))
+			return pFound;
+	}
+#endif
+
+#if defined(STL_STRING_SSE2)
+	const uint lanes = 16 / sizeof(T);
+	auto needle = Splat128(Ch);
+	for (; i >= lanes; i -= lanes) {
+		auto mask = Match128(&Str[i - lanes], needle);
+		if (mask)
+			return &Str[(i - lanes) + (HighBit(mask) / sizeof(T))];
+	}
+#endif
+
+	while (i != 0) {
+		--i;
+		if (Str[i] == Ch)
+			return &Str[i];
+	}
+	return nullptr;
+}
+
+template <> const char *TFindChar<char>(const char *Str, uint Length, char Ch) { return FindCharImpl(Str, Length, Ch); }
+template <> const wchar_t *TFindChar<wchar_t>(const wchar_t *Str, uint Length, wchar_t Ch) { return FindCharImpl(Str, Length, Ch); }
+
+template <> const char *TFindLastChar<char>(const char *Str, uint Length, char Ch) { return FindLastCharImpl(Str, Length, Ch); }
+template <> const wchar_t *TFindLastChar<wchar_t>(const wchar_t *Str, uint Length, wchar_t Ch) { return FindLastCharImpl(Str, Length, Ch); }
+
+bool TMemEqual(const void *Left, const void *Right, size_t Size)
+{
+	auto l = (const uint8 *)Left;
+	auto r = (const uint8 *)Right;
+	size_t i = 0;
+
+#if defined(STL_STRING_AVX2)
+	if (gHasAvx2 && !MemEqualAvx2(l, r, Size, &i))
+		return false;
+#endif
+
+#if defined(STL_STRING_SSE2)
+	for (; (i + 16) <= Size; i += 16) {
+		auto eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&l[i]), _mm_loadu_si128((const __m128i *)&r[i]));
+		if (_mm_movemask_epi8(eq) != 0xFFFF)
+			return false;
+	}
+#endif
+
+	for (; i != Size; ++i) {
+		if (l[i] != r[i])
+			return false;
+	}
+	return true;
+}
+
+/* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
+void TWideToUtf8(const wchar_t *Str, uint Length, TString<char> *pOut)
+{
+	pOut->Reserve(Length * 3);
+
+	for (uint i = 0; i != Length; ++i) {
+		uint32_t c = (uint32_t)Str[i];
+		if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && (i + 1) != Length) {
+			uint32_t lo = (uint32_t)Str[i + 1];
+			if (lo >= 0xDC00 && lo <= 0xDFFF) {
+				c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+				++i;
+			}
+		}
+
+		char buf[4];
+		uint n;
+		if (c < 0x80) {
+			buf[0] = (char)c;
+			n = 1;
+		} else if (c < 0x800) {
+			buf[0] = (char)(0xC0 | (c >> 6));
+			buf[1] = (char)(0x80 | (c & 0x3F));
+			n = 2;
+		} else if (c < 0x10000) {
+			buf[0] = (char)(0xE0 | (c >> 12));
+			buf[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+			buf[2] = (char)(0x80 | (c & 0x3F));
+			n = 3;
+		} else {
+			buf[0] = (char)(0xF0 | (c >> 18));
+			buf[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+			buf[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+			buf[3] = (char)(0x80 | (c & 0x3F));
+			n = 4;
+		}
+		pOut->Append(buf, n);
+	}
+}
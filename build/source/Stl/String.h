@@ -3,41 +3,49 @@
 
 #include <pch.h>
 
+#include <utility>
+
 /* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
-/* Specializations present in Stl/Private/String.cpp */
+/* Specializations present in Stl/String.cpp */
 
 template <typename T> uint TStrlen(const T *Str);
 template <typename T> bool TStrcmp(const T *Left, const T *Right);
-template <typename T> const T *TEmptyString();
+
+// SSE2 kernels, with AVX2 in front when the CPU has it (checked once at start-up).
+// Both return nullptr if 'Ch' isn't in the first 'Length' characters.
+template <typename T> const T *TFindChar(const T *Str, uint Length, T Ch);
+template <typename T> const T *TFindLastChar(const T *Str, uint Length, T Ch);
+
+bool TMemEqual(const void *Left, const void *Right, size_t Size);
 
 /* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
-template <typename T> 
-class TString 
+// Strings that fit in TSTRING_INLINE_BYTES (terminator included) live inside the TString itself and never touch the heap.
+#define TSTRING_INLINE_BYTES 64
+
+template <typename T>
+class TString
 {
 public:
+	enum { InlineCap = TSTRING_INLINE_BYTES / sizeof(T) };
+
 	TString()
 	{
-		m_Ptr = (T *)TEmptyString<T>();
-		m_uCap = 0;
-		m_uLength = 0;
+		InitInline();
 	}
 
 	TString(const T *Ptr, uint Length)
 	{
-		m_uLength = Length;
-		m_uCap = ALIGN16(m_uLength + 1);
-		m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-		memset(m_Ptr, 0, m_uCap * sizeof(T));
-		memcpy(m_Ptr, Ptr, m_uLength * sizeof(T));
+		InitInline();
+		Set(Ptr, Length);
 	}
 	TString(const T *Ptr) : TString(Ptr, TStrlen(Ptr)) {}
 
-	TString(const TString &Other) {
-		m_uLength = Other.m_uLength;
-		m_uCap = ALIGN16(m_uLength + 1);
-		m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-		memset(m_Ptr, 0, m_uCap * sizeof(T));
-		memcpy(m_Ptr, Other.m_Ptr, m_uLength * sizeof(T));
+	TString(const TString &Other) : TString(Other.m_Ptr, Other.m_uLength) {}
+
+	TString(TString &&Other)
+	{
+		InitInline();
+		MoveFrom(Other);
 	}
 
 	~TString()
@@ -45,205 +53,210 @@ public:
 		Free();
 	}
 
+	TString &operator =(const TString &Other)
+	{
+		if (this != &Other)
+			Set(Other.m_Ptr, Other.m_uLength);
+		return *this;
+	}
+
+	TString &operator =(TString &&Other)
+	{
+		if (this != &Other) {
+			Free();
+			MoveFrom(Other);
+		}
+		return *this;
+	}
+
+	TString &operator =(const T *Ptr)
+	{
+		Set(Ptr);
+		return *this;
+	}
+
 	void Free()
 	{
-		if (m_Ptr != (T *)TEmptyString<T>()) {
+		if (!IsInline())
 			free(m_Ptr);
-			m_Ptr = (T *)TEmptyString<T>();
-			m_uCap = 0;
-			m_uLength = 0;
-		}
+		InitInline();
 	}
 
 	void Set(const T *Ptr, uint Length)
 	{
+		Ensure(Length + 1, &Ptr);
+		memmove(m_Ptr, Ptr, Length * sizeof(T));
 		m_uLength = Length;
-		m_uCap = ALIGN16(Length + 1);
-		if (m_Ptr != (T *)TEmptyString<T>())
-			m_Ptr = (T *)realloc(m_Ptr, m_uCap * Sizeof(T));
-		else
-			m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-		memset(m_Ptr, 0, m_uCap * sizeof(T));
-		memcpy(m_Ptr, Ptr, Length * sizeof(T));
+		m_Ptr[m_uLength] = 0;
 	}
 	inline void Set(const T *Ptr) { Set(Ptr, TStrlen(Ptr)); }
 
-	void Reserve(uint Addition) 
+	void Reserve(uint Addition)
 	{
-		if (m_Ptr != (T *)TEmptyString<T>()) {
-			auto t = m_uLength + Addition + 1;
-			if (t >= m_uCap) {
-				auto old = m_uCap;
-				m_uCap = ALIGN16(t);
-				m_Ptr = (T *)realloc(m_Ptr, m_uCap * sizeof(T));
-				memset(&m_Ptr[old], 0, m_uCap - old);
-			}
-		}
-		else {
-			m_uCap = ALIGN16(Addition + 1);
-			m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-			memset(m_Ptr, 0, m_uCap * sizeof(T));
-		}
+		Ensure(m_uLength + Addition + 1);
 	}
 
+	// New characters are zeroed.
 	void Resize(uint NewSize)
 	{
-		if (m_Ptr != (T *)TEmptyString<T>()) {
-			auto old = m_uCap;
-			m_uCap = ALIGN16(NewSize + 1);
-			m_Ptr = (T *)realloc(m_Ptr, m_uCap * sizeof(T));
-			if (NewSize > old) {
-				memset(&m_Ptr[old], 0, (m_uCap - old) * sizeof(T));
-			}
-			else {
-				m_Ptr[m_uCap] = 0;
-			}
-		}
+		Ensure(NewSize + 1);
+		if (NewSize > m_uLength)
+			memset(&m_Ptr[m_uLength], 0, (NewSize - m_uLength) * sizeof(T));
+		m_uLength = NewSize;
+		m_Ptr[m_uLength] = 0;
 	}
 
 	void Append(const T *Ptr, uint Length)
 	{
-		if (m_Ptr != (T *)TEmptyString<T>()) {
-			auto t = (m_uLength + Length + 1);
-			if (t >= m_uCap) {
-				auto old = m_uCap;
-				m_uCap = ALIGN16(t);
-				m_Ptr = (T *)realloc(m_Ptr, m_uCap * sizeof(T));
-				memset(&m_Ptr[old], 0, (m_uCap - old) * sizeof(T));
-			}
-			memcpy(&m_Ptr[m_uLength], Ptr, Length * sizeof(T));
-			m_uLength = t;
-		}
-		else {
-			m_uLength = Length;
-			m_uCap = ALIGN16(Length + 1);
-			m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-			memset(m_Ptr, 0, m_uCap * sizeof(T));
-			memcpy(m_Ptr, Ptr, Length * sizeof(T));
-		}
+		Ensure(m_uLength + Length + 1, &Ptr);
+		memmove(&m_Ptr[m_uLength], Ptr, Length * sizeof(T));
+		m_uLength += Length;
+		m_Ptr[m_uLength] = 0;
 	}
 	inline void Append(const T *Ptr) { Append(Ptr, TStrlen(Ptr)); }
 
-	void Prepend(const T *Ptr, uint Length)
-	{
-		if (m_Ptr != (T *)TEmptyString<T>()) {
-			auto t = (m_uLength + Length + 1);
-			if (t >= m_uCap) {
-				auto old = m_uCap;
-				m_uCap = ALIGN16(t);
-				m_Ptr = (T *)realloc(m_Ptr, m_uCap * sizeof(T));
-				memset(&m_Ptr[old], 0, (m_uCap - old) * sizeof(T));
-			}
-			memcpy(&m_Ptr[Length], m_Ptr, m_uLength * sizeof(T));
-			memcpy(m_Ptr, Ptr, Length * sizeof(T));
-			m_uLength = t;
-		}
-		else {
-			m_uLength = Length;
-			m_uCap = ALIGN16(Length + 1);
-			m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-			memset(m_Ptr, 0, m_uCap * sizeof(T));
-			memcpy(m_Ptr, Ptr, Length * sizeof(T));
-		}
-	}
+	inline void Prepend(const T *Ptr, uint Length) { Insert(Ptr, Length, 0); }
 	inline void Prepend(const T *Ptr) { Prepend(Ptr, TStrlen(Ptr)); }
 
 	void Insert(const T *Ptr, uint Length, uint Where)
 	{
-		if (m_Ptr != (T *)TEmptyString<T>()) {
-			auto t = (m_uLength + Length + 1);
-			if (t >= m_uCap) {
-				auto old = m_uCap;
-				m_uCap = ALIGN16(t);
-				m_Ptr = (T *)realloc(m_Ptr, m_uCap * sizeof(T));
-				memset(&m_Ptr[old], 0, (m_uCap - old) * sizeof(T));
-			}
-			memcpy(&m_Ptr[Where + Length], &m_Ptr[Where], (m_uLength - Where) * sizeof(T));
-			memcpy(&m_Ptr[Where], Ptr, Length * sizeof(T));
-			m_uLength = t;
-		}
-		else {
-			m_uLength = Length;
-			m_uCap = ALIGN16(Length + 1);
-			m_Ptr = (T *)malloc(m_uCap * sizeof(T));
-			memset(m_Ptr, 0, m_uCap * sizeof(T));
-			memcpy(m_Ptr, Ptr, Length * sizeof(T));
+		if (Where > m_uLength)
+			Where = m_uLength;
+
+		// Part of the source may be shifted by the memmove below; insert a copy instead.
+		if (Owns(Ptr)) {
+			TString copy(Ptr, Length);
+			Insert(copy.m_Ptr, Length, Where);
+			return;
 		}
+
+		Ensure(m_uLength + Length + 1);
+		memmove(&m_Ptr[Where + Length], &m_Ptr[Where], (m_uLength - Where + 1) * sizeof(T)); // Moves the terminator too.
+		memcpy(&m_Ptr[Where], Ptr, Length * sizeof(T));
+		m_uLength += Length;
 	}
 	inline void Insert(const T *Ptr, uint Where) { Insert(Ptr, TStrlen(Ptr), Where); }
 	inline void Insert(const T *Ptr, T *Where) { Insert(Ptr, TStrlen(Ptr), (uint)(Where - m_Ptr)); }
 
 	inline T *Find(const T Ch) {
-		for (auto i = 0; i != m_uLength; ++i) {
-			if (m_Ptr[i] == Ch)
-				return &m_Ptr[i];
-		}
-		return nullptr;
+		return (T *)TFindChar(m_Ptr, m_uLength, Ch);
 	}
 	inline T *FindLast(const T Ch) {
-		for (auto i = m_uLength; i >= 0; --i) {
-			if (m_Ptr[i] == Ch)
-				return &m_Ptr[i];
-		}
+		return (T *)TFindLastChar(m_Ptr, m_uLength, Ch);
 	}
 
 	// Returns (uint)-1 on failure.
 	inline uint GetIndexOf(const T Ch) {
-		for (auto i = 0; i != m_uLength; ++i) {
-			if (m_Ptr[i] == Ch)
-				return i;
-		}
-		return (uint)-1;
+		auto ptr = Find(Ch);
+		return (ptr) ? (uint)(ptr - m_Ptr) : (uint)-1;
 	}
 	// Returns (uint)-1 on failure.
 	inline uint GetLastIndexOf(const T Ch) {
-		for (auto i = m_uLength; i >= 0; --i) {
-			if (m_Ptr[i] == Ch)
-				return i;
-		}
-		return (uint)-1;
+		auto ptr = FindLast(Ch);
+		return (ptr) ? (uint)(ptr - m_Ptr) : (uint)-1;
 	}
 
 	inline void *Raw() { return m_Ptr; }
-	inline uint Length() { return m_uLength; }
-	inline uint Capacity() { return m_uCap; }
+	inline uint Length() const { return m_uLength; }
+	inline uint Capacity() const { return m_uCap; }
+	inline bool IsInline() const { return m_Ptr == m_Inline; }
 
 	// -----------------------------------
 	// FilePath/Name stuff.
 	// -----------------------------------
-	inline T *GetFileExtension() { 
-		return FindLast('.'); 
+	inline T *GetFileExtension() {
+		return FindLast('.');
 	}
-	
-	inline T *GetFileName() { 
-		auto ptr = FindLast('\\'); 
+
+	inline T *GetFileName() {
+		auto ptr = FindLast('\\');
 		if (!ptr)
 			ptr = FindLast('/');
-		return (ptr) ? (ptr + 1) : m_Ptr; 
+		return (ptr) ? (ptr + 1) : m_Ptr;
 	}
 
 	inline TString GetFilePath() {
-		TString dst = *this;
-		auto ptr = dst.GetFileName();
-		*ptr = 0;
-		return dst;
+		return TString(m_Ptr, (uint)(GetFileName() - m_Ptr));
 	}
 
 	// -----------------------------------
 	// Operators.
 	// -----------------------------------
 	inline operator T *() { return m_Ptr; }
-	inline operator const T *() { return (const T *)m_Ptr; }
+	inline operator const T *() const { return (const T *)m_Ptr; }
 	inline T &operator [](uint Index) { return m_Ptr[Index]; }
-	
-	inline bool operator ==(const T *Other) { return TStrcmp(m_Ptr, Other); }
-	inline bool operator ==(const TString &Other) { return TStrcmp(m_Ptr, Other.m_Ptr); }
+
+	inline bool operator ==(const T *Other) const {
+		auto length = TStrlen(Other);
+		return (length == m_uLength) && TMemEqual(m_Ptr, Other, length * sizeof(T));
+	}
+	inline bool operator ==(const TString &Other) const {
+		return (Other.m_uLength == m_uLength) && TMemEqual(m_Ptr, Other.m_Ptr, m_uLength * sizeof(T));
+	}
 	inline void operator +=(const T *Str) { Append(Str); }
 
 protected:
+	inline void InitInline()
+	{
+		m_Ptr = m_Inline;
+		m_Inline[0] = 0;
+		m_uCap = InlineCap;
+		m_uLength = 0;
+	}
+
+	void MoveFrom(TString &Other)
+	{
+		if (Other.IsInline()) {
+			memcpy(m_Inline, Other.m_Inline, (Other.m_uLength + 1) * sizeof(T));
+			m_uLength = Other.m_uLength;
+			m_Ptr[m_uLength] = 0;
+		} else {
+			m_Ptr = Other.m_Ptr;
+			m_uCap = Other.m_uCap;
+			m_uLength = Other.m_uLength;
+		}
+		Other.InitInline();
+	}
+
+	inline bool Owns(const T *Ptr) const
+	{
+		return (uintptr_t)Ptr >= (uintptr_t)m_Ptr && (uintptr_t)Ptr < (uintptr_t)(m_Ptr + m_uCap);
+	}
+
+	// Makes room for 'Required' characters (terminator included). A source pointer into this string's own
+	// buffer is moved along with it, since realloc may free the old one.
+	void Ensure(uint Required, const T **ppSource = nullptr)
+	{
+		if (Required <= m_uCap)
+			return;
+
+		size_t sourceOffset = (ppSource && Owns(*ppSource)) ? (size_t)(*ppSource - m_Ptr) : (size_t)-1;
+
+		uint newCap = m_uCap * 2;
+		if (newCap < Required)
+			newCap = ALIGN16(Required);
+
+		if (IsInline()) {
+			auto ptr = (T *)malloc(newCap * sizeof(T));
+			memcpy(ptr, m_Inline, (m_uLength + 1) * sizeof(T));
+			m_Ptr = ptr;
+		} else {
+			m_Ptr = (T *)realloc(m_Ptr, newCap * sizeof(T));
+		}
+		m_uCap = newCap;
+
+		if (sourceOffset != (size_t)-1)
+			*ppSource = m_Ptr + sourceOffset;
+	}
+
 	T *m_Ptr;
 	uint m_uCap;
 	uint m_uLength;
+	T m_Inline[InlineCap];
 };
 
-#endif // _STL_STRING_H_
\ No newline at end of file
+/* --------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
+// UTF-16 (Win32) or UTF-32 in, UTF-8 out. Appends to 'pOut'.
+void TWideToUtf8(const wchar_t *Str, uint Length, TString<char> *pOut);
+
+#endif // _STL_STRING_H_
@@ -0,0 +1,106 @@
+#include <pch.h>
+#include <Engine/Archive.h>
+#include <Engine/JobSystem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// PackTool <out.pak> [-c|-u] [-a align] [-r root] files...
+// Switches apply to the files after them, so one run can mix compressed assets with raw, page-aligned SPIR-V.
+// Entry names are the file paths with 'root' stripped, e.g. "-r data data/cso/Static.spv" -> "cso/Static.spv".
+
+static bool ReadWholeFile(const char *Path, TArray<uint8> *pOut)
+{
+	FILE *pFile = fopen(Path, "rb");
+	if (!pFile)
+		return false;
+
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	if (size < 0) {
+		fclose(pFile);
+		return false;
+	}
+
+	pOut->Clear();
+	pOut->Resize((uint)size);
+	bool bOk = fread(pOut->GetPtr(), 1, (size_t)size, pFile) == (size_t)size;
+	fclose(pFile);
+	return bOk;
+}
+
+static const char *StripRoot(const char *Path, const char *Root)
+{
+	size_t rootLength = strlen(Root);
+	if (rootLength && !strncmp(Path, Root, rootLength)) {
+		Path += rootLength;
+		while (*Path == '/' || *Path == '\\')
+			++Path;
+	}
+	return Path;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		printf(
+			"Usage: PackTool <out.pak> [switches] files...\n"
+			"\t-c | Compress the files that follow.\n"
+			"\t-u | Store the files that follow uncompressed (default).\n"
+			"\t-a * | Alignment for the files that follow (default 16).\n"
+			"\t-r * | Root to strip from entry names.\n"
+		);
+		return 1;
+	}
+
+	Jobs::Initialize();
+
+	archiveBuilder_t builder = {};
+	TArray<uint8> data;
+	bool bCompress = false;
+	uint align = 16;
+	const char *root = "";
+	int numFailed = 0;
+
+	for (int i = 2; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (!strcmp(arg, "-c")) {
+			bCompress = true;
+		} else if (!strcmp(arg, "-u")) {
+			bCompress = false;
+		} else if (!strcmp(arg, "-a") && (i + 1) < argc) {
+			align = (uint)atoi(argv[++i]);
+		} else if (!strcmp(arg, "-r") && (i + 1) < argc) {
+			root = argv[++i];
+		} else if (!ReadWholeFile(arg, &data)) {
+			printf("Couldn't read '%s'.\n", arg);
+			++numFailed;
+		} else {
+			const char *name = StripRoot(arg, root);
+			if (!builder.Add(name, data.GetPtr(), data.Getcount(), align, bCompress)) {
+				printf("Couldn't add '%s' (alignment %u).\n", name, align);
+				++numFailed;
+			} else {
+				auto &entry = builder.m_Pending[builder.m_Pending.Getcount() - 1].entry;
+				printf("%-48s %10llu -> %10llu\n", name, (unsigned long long)entry.rawSize, (unsigned long long)entry.storedSize);
+			}
+		}
+	}
+
+#if defined(MBCS)
+	TString<TCHAR> outPath(argv[1]);
+#else
+	TString<TCHAR> outPath;
+	outPath.Resize((uint)mbstowcs(nullptr, argv[1], 0));
+	mbstowcs(outPath, argv[1], outPath.Length() + 1);
+#endif
+
+	bool bWritten = !numFailed && builder.Write(outPath);
+	if (!numFailed && !bWritten)
+		printf("Couldn't write '%s' (duplicate entry names?).\n", argv[1]);
+
+	builder.Release();
+	Jobs::Release();
+	return bWritten ? 0 : 1;
+}
@@ -7,7 +7,11 @@
 #include <malloc.h>
 #include <memory.h>
 #include <string.h>
+#if defined(_MSC_VER)
 #include <new.h>
+#else
+#include <new>
+#endif
 
 #define ZeroThat(x) memset(x, 0, sizeof(*x))
 #define ZeroThis() memset(this, 0, sizeof(*this))